@@ -2,42 +2,112 @@
 #define STREAM_H
 
 #include "Print.h"
+#include "include/WString.h"
+#include "arduino-mock/RingBuffer.h"
 #include <gmock/gmock.h>
+#include <initializer_list>
+#include <string>
 
+// The parsing and reading methods are implemented in Stream.cpp on top of
+// available(), read() and peek(); find() and readBytes() stay virtual so
+// StreamMock can still take them over.
 class Stream : public Print {
   public:
     virtual int available() = 0;
     virtual int read() = 0;
     virtual int peek() = 0;
     virtual void flush() = 0;
-    // virtual void setTimeout(unsigned long timeout);
 
-    virtual bool find(char *target) = 0;
-    virtual bool find(uint8_t *target) = 0;
+    // sets the maximum number of milliseconds to wait, 1000 by default
+    void setTimeout(unsigned long timeout);
+    unsigned long getTimeout() const { return _timeout; }
 
-    virtual bool find(char *target, size_t length) = 0;
-    virtual bool find(uint8_t *target, size_t length) = 0;
+    virtual bool find(const char *target);
+    virtual bool find(uint8_t *target) { return find((char *)target); }
 
-    // virtual bool findUntil(char *target, char *terminator) = 0;
-    // virtual bool findUntil(uint8_t *target, char *terminator) { return findUntil((char *)target, terminator) = 0; }
-    //
-    // virtual bool findUntil(char *target, size_t targetLen, char *terminate, size_t termLen) = 0;
-    // virtual bool findUntil(uint8_t *target, size_t targetLen, char *terminate, size_t termLen) {return findUntil((char *)target, targetLen, terminate, termLen) = 0; }
-    //
-    // virtual long parseInt() = 0;
-    //
-    // virtual float parseFloat() = 0;
+    virtual bool find(const char *target, size_t length);
+    virtual bool find(uint8_t *target, size_t length) { return find((char *)target, length); }
 
-    virtual size_t readBytes( char *buffer, size_t length) = 0;
-    virtual size_t readBytes( uint8_t *buffer, size_t length) = 0;
+    // A needle for findMulti(); index is the search state, reset on entry
+    struct MultiTarget {
+      const char *str;  // string you're searching for
+      size_t len;       // length of string you're searching for
+      size_t index;     // index used by the search routine
+    };
+
+    // Reads until one of the targets is found, searching for all of them at
+    // once with one KMP automaton per target, so overlapping and repetitive
+    // needles cost constant work per byte.
+    // Returns the index of the target found, the lowest index if several
+    // end on the same byte, or -1 on timeout. Without targets it returns -1
+    // right away and reads nothing.
+    int findMulti(MultiTarget *targets, int tCount);
+    // e.g. switch(modem.findAny({ "OK", "ERROR", "+CME ERROR" })) ...
+    int findAny(std::initializer_list<const char *> targets);
+
+    bool findUntil(const char *target, const char *terminator);
+    bool findUntil(uint8_t *target, const char *terminator) { return findUntil((char *)target, terminator); }
+
+    bool findUntil(const char *target, size_t targetLen, const char *terminate, size_t termLen);
+    bool findUntil(uint8_t *target, size_t targetLen, const char *terminate, size_t termLen) { return findUntil((char *)target, targetLen, terminate, termLen); }
+
+    long parseInt();
+    long parseInt(char skipChar);
+
+    float parseFloat();
+    float parseFloat(char skipChar);
+
+    // true if the last parseInt(), parseFloat() or parseCsvRow() met a
+    // number out of range; the result is then LONG_MIN/LONG_MAX or +-inf
+    bool parseOverflowed() const { return _parseOverflow; }
+    // character parseFloat() and parseCsvRow() take as the decimal point,
+    // e.g. ',' for German locale data with ';' as the CSV delimiter
+    void setDecimalPoint(char decimalPoint) { _decimalPoint = decimalPoint; }
+
+    // Parses one line of delimiter separated numbers into values and
+    // consumes it, including the '\n'. Fields beyond count are skipped;
+    // empty or non-numeric fields give NAN (0 for long). Returns the number
+    // of fields stored, 0 for a blank line or a timeout.
+    size_t parseCsvRow(float *values, size_t count, char delimiter = ',');
+    size_t parseCsvRow(long *values, size_t count, char delimiter = ',');
+
+    virtual size_t readBytes( char *buffer, size_t length);
+    virtual size_t readBytes( uint8_t *buffer, size_t length) { return readBytes((char *)buffer, length); }
 
     virtual size_t write(const uint8_t *buffer, size_t size) = 0;
 
-    // virtual size_t readBytesUntil( char terminator, char *buffer, size_t length);
-    // virtual size_t readBytesUntil( char terminator, uint8_t *buffer, size_t length) { return readBytesUntil(terminator, (char *)buffer, length); }
-    //
-    // virtual String readString();
-    // virtual String readStringUntil(char terminator);
+    size_t readBytesUntil( char terminator, char *buffer, size_t length);
+    size_t readBytesUntil( char terminator, uint8_t *buffer, size_t length) { return readBytesUntil(terminator, (char *)buffer, length); }
+
+    virtual String readString();
+    String readStringUntil(char terminator);
+
+    // Optional direct access to the receive buffer, for streams that keep
+    // their data in contiguous memory. When hasPeekBufferAPI() is true,
+    // readBytes(), readBytesUntil(), readString() and readStringUntil() copy
+    // whole chunks through it instead of calling read() once per byte.
+    virtual bool hasPeekBufferAPI() const { return false; }
+    // number of bytes peekBuffer() points to, may be less than available()
+    virtual size_t peekAvailable() { return 0; }
+    virtual const char* peekBuffer() { return nullptr; }
+    // drop consume bytes, at most peekAvailable(), from the front
+    virtual void peekConsume(size_t consume) { (void)consume; }
+
+  protected:
+    int timedRead();    // read stream with timeout
+    int timedPeek();    // peek stream with timeout
+    size_t timedPeekAvailable();
+    int peekNextDigit(); // returns the next numeric digit in the stream or -1 if timeout
+
+    unsigned long _timeout = 1000;  // number of milliseconds to wait for the next char before aborting timed read
+    unsigned long _startMillis = 0; // used for timeout measurement
+
+    class NumberScanner;
+    void scanNumber(NumberScanner &scanner);
+    int skipCsvField(char delimiter);
+
+    bool _parseOverflow = false;
+    char _decimalPoint = '.';
 
 };
 
@@ -48,31 +118,47 @@ class StreamMock : public Stream {
     MOCK_METHOD0(peek, int ());
     MOCK_METHOD0(flush, void ());
 
-    MOCK_METHOD1(find, bool (char *target));
+    MOCK_METHOD1(find, bool (const char *target));
     MOCK_METHOD1(find, bool (uint8_t *target));
-    MOCK_METHOD2(find, bool (char *target, size_t length));
+    MOCK_METHOD2(find, bool (const char *target, size_t length));
     MOCK_METHOD2(find, bool (uint8_t *target, size_t length));
 
-    // virtual bool findUntil(char *target, char *terminator);
-    // virtual bool findUntil(uint8_t *target, char *terminator) { return findUntil((char *)target, terminator); }
-    //
-    // virtual bool findUntil(char *target, size_t targetLen, char *terminate, size_t termLen);
-    // virtual bool findUntil(uint8_t *target, size_t targetLen, char *terminate, size_t termLen) {return findUntil((char *)target, targetLen, terminate, termLen); }
-    //
-    // virtual long parseInt();
-    //
-    // virtual float parseFloat();
     MOCK_METHOD2(readBytes, size_t (char *buffer, size_t length));
     MOCK_METHOD2(readBytes, size_t (uint8_t *buffer, size_t length));
 
-    // virtual size_t readBytesUntil( char terminator, char *buffer, size_t length);
-    // virtual size_t readBytesUntil( char terminator, uint8_t *buffer, size_t length) { return readBytesUntil(terminator, (char *)buffer, length); }
-    //
-    // virtual String readString();
-    // virtual String readStringUntil(char terminator);
-
     //Print functions
     MOCK_METHOD2(write, size_t (const uint8_t*, size_t size));
 };
 
+// A Stream over a RingBuffer, for code that takes a Stream& without a
+// network client behind it. Bytes fed with feed() are read back, also
+// through the peek buffer, one contiguous run of the ring at a time;
+// written bytes are kept in getWritten().
+class StreamFake : public Stream {
+  public:
+    explicit StreamFake(size_t capacity = RingBuffer::default_capacity)
+      : rx(capacity) {}
+
+    // e.g. from an event scheduled on the virtual clock
+    void feed(const uint8_t *data, size_t length) { rx.feed(data, length); }
+    void feed(const char *text) { feed((const uint8_t *)text, strlen(text)); }
+    const std::string &getWritten() const { return written; }
+    void clearWritten() { written.clear(); }
+
+    int available();
+    int read();
+    int peek();
+    void flush() {}
+    size_t write(const uint8_t *buffer, size_t size);
+
+    bool hasPeekBufferAPI() const { return true; }
+    size_t peekAvailable() { return rx.contiguous(); }
+    const char* peekBuffer() { return (const char *)rx.front(); }
+    void peekConsume(size_t consume) { rx.consume(consume); }
+
+  private:
+    RingBuffer rx;
+    std::string written;
+};
+
 #endif
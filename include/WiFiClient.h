@@ -72,6 +72,10 @@ public:
   size_t peekBytes(char *buffer, size_t length) {
     return peekBytes((uint8_t *) buffer, length);
   }
+  virtual bool hasPeekBufferAPI() const override;
+  virtual size_t peekAvailable() override;
+  virtual const char* peekBuffer() override;
+  virtual void peekConsume(size_t consume) override;
   virtual void flush() override { (void)flush(0); }
   virtual void stop() override { (void)stop(0); }
   bool flush(unsigned int maxWaitMs);
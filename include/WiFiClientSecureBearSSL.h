@@ -58,6 +58,12 @@ class WiFiClientSecure_ : public WiFiClient {
 		int read() override;
 		int peek() override;
 		size_t peekBytes(uint8_t *buffer, size_t length) override;
+		// The peek buffer is the decrypted application data, not the
+		// TCP receive buffer of the underlying WiFiClient
+		bool hasPeekBufferAPI() const override { return true; }
+		size_t peekAvailable() override;
+		const char* peekBuffer() override;
+		void peekConsume(size_t consume) override;
 		bool flush(unsigned int maxWaitMs);
 		bool stop(unsigned int maxWaitMs);
 		void flush() override { (void)flush(0); }
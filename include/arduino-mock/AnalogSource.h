@@ -0,0 +1,166 @@
+/**
+ * Signal generators for analogRead()
+ */
+#ifndef ANALOG_SOURCE_H
+#define ANALOG_SOURCE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+  \class AnalogSource
+  \brief A signal analogRead() samples, as a function of virtual time
+
+  Attach one to a pin of the GPIO fake with ArduinoFake::setAnalogSource();
+  every analogRead() of the pin then returns sample() at the current
+  getMicros64() time. Sources are pure functions of time, so reading twice
+  at the same time gives the same value and the sketch may sample as often
+  or as rarely as it likes.
+
+  Example usage:
+
+  ArduinoFake* fake = arduinoFakeInstance();
+  // 50 Hz mains hum around mid scale
+  fake->setAnalogSource(0, new SineSource(512, 100, 50));
+  // hours of logged sensor readings, one per 10 ms
+  fake->setAnalogSource(1, new SampleFileSource("log.csv",
+                        SampleFileSource::CSV, 10000));
+*/
+class AnalogSource {
+
+  public:
+    virtual ~AnalogSource() {}
+    virtual int sample(uint64_t micros) = 0;
+};
+
+class ConstantSource : public AnalogSource {
+
+  public:
+    explicit ConstantSource(int value) : value(value) {}
+    int sample(uint64_t micros);
+
+  private:
+    int value;
+};
+
+/**
+  \brief offset + amplitude * sin(2 pi frequency t + phase), rounded
+*/
+class SineSource : public AnalogSource {
+
+  public:
+    SineSource(int offset, int amplitude, double frequency, double phase = 0);
+    int sample(uint64_t micros);
+
+  private:
+    int offset;
+    int amplitude;
+    double radiansPerMicro;
+    double phase;
+};
+
+/**
+  \brief high for the first duty fraction of every period, low for the rest
+*/
+class SquareSource : public AnalogSource {
+
+  public:
+    SquareSource(int low, int high, uint64_t periodMicros, double duty = 0.5);
+    int sample(uint64_t micros);
+
+  private:
+    int low;
+    int high;
+    uint64_t periodMicros;
+    uint64_t highMicros;
+};
+
+/**
+  \brief Uniform noise in [mean - amplitude, mean + amplitude]
+
+  The value is a hash of the seed and the time rather than the next number
+  of a generator, so runs are repeatable however often the sketch samples.
+*/
+class NoiseSource : public AnalogSource {
+
+  public:
+    NoiseSource(int mean, int amplitude, uint32_t seed = 0);
+    int sample(uint64_t micros);
+
+  private:
+    int mean;
+    int amplitude;
+    uint64_t seed;
+};
+
+/**
+  \brief Samples recorded at a fixed rate, streamed from a memory mapped file
+
+  Sample n covers the virtual time [start + n * interval, start + (n + 1) *
+  interval). Before the first sample the first value is returned; past the
+  last one the last value is held, or the recording starts over when
+  looping.
+
+  RAW_INT16 and RAW_UINT16 files are packed little-endian 16-bit samples and
+  are indexed directly. CSV files hold one sample per line, taken from the
+  given column (0 based, separated by commas; a fractional part is
+  dropped); a header line or any other line without a number in that column
+  is skipped. CSV samples are counted when the file is opened, then found
+  by scanning forward from the previous read, so reading in time order
+  costs nothing extra and only going back in time rescans from the start.
+
+  No samples are copied out of the file; the kernel pages it in as the
+  sketch reaches it.
+*/
+class SampleFileSource : public AnalogSource {
+
+  public:
+    enum Format {
+      CSV,
+      RAW_INT16,
+      RAW_UINT16
+    };
+
+    SampleFileSource(const char* path, Format format, uint64_t intervalMicros,
+                     uint64_t startMicros = 0, bool loop = false,
+                     int column = 0);
+    ~SampleFileSource();
+
+    /**
+      \brief false if the file could not be mapped or holds no samples; the
+             source then reads 0
+    */
+    bool isOpen() const {
+      return count > 0;
+    }
+    uint64_t getSampleCount() const {
+      return count;
+    }
+
+    int sample(uint64_t micros);
+
+  private:
+    SampleFileSource(const SampleFileSource&);
+    SampleFileSource& operator=(const SampleFileSource&);
+
+    int rawSample(uint64_t index) const;
+    int csvSample(uint64_t index);
+    bool nextCsvLine(int& value);
+
+    const char* data;
+    size_t length;
+    Format format;
+    uint64_t intervalMicros;
+    uint64_t startMicros;
+    bool loop;
+    int column;
+
+    uint64_t count;
+    // CSV read position: csvIndex samples end before csvOffset, the last
+    // of them being csvValue.
+    uint64_t csvIndex;
+    size_t csvOffset;
+    int csvValue;
+};
+
+#endif // ANALOG_SOURCE_H
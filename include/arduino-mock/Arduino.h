@@ -43,7 +43,8 @@ extern "C" {
 #define RISING 3
 
 #define NOT_AN_INTERRUPT -1
-#define digitalPinToInterrupt(p)  ((p) == 2 ? 0 : ((p) == 3 ? 1 : NOT_AN_INTERRUPT))
+#define EXTERNAL_NUM_INTERRUPTS 16
+#define digitalPinToInterrupt(p)  (((p) < EXTERNAL_NUM_INTERRUPTS) ? (p) : NOT_AN_INTERRUPT)
 
 #define A0
 #define A1
@@ -70,6 +71,8 @@ time_t millis(void);
 time_t micros(void);
 void delay(time_t);
 void delayMicroseconds(time_t us);
+void yield(void);
+bool delayUntilEvent(time_t ms);
 time_t pulseIn(uint8_t pin, uint8_t state, time_t timeout);
 
 void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val);
@@ -89,23 +92,51 @@ void loop(void);
 #endif
 
 #include <gmock/gmock.h>
+#include "Scheduler.h"
+#include "Interrupts.h"
+#include "AnalogSource.h"
 
 #define UNUSED(expr) do { (void)(expr); } while (0)
 #define F(x) (x)
 
 class ArduinoMock {
   private:
-    time_t currentMillis;
+    // Virtual clock, in microseconds since the mock was created. millis()
+    // and micros() are derived from it and wrap at 32 bits like on the
+    // target, while the counter itself never wraps.
+    uint64_t currentMicros;
+    time_t yieldMicros;
+    time_t shiftEdgeMicros;
+    time_t pinPollMicros;
+    VirtualScheduler scheduler;
 
   public:
     ArduinoMock();
 
     time_t getMillis() {
-      return currentMillis;
+      return (currentMicros / 1000) & UINT32_MAX;
+    };
+    time_t getMicros() {
+      return currentMicros & UINT32_MAX;
+    };
+    uint64_t getMicros64() {
+      return currentMicros;
+    };
+
+    /**
+      \brief Setting the clock never runs scheduled events, even when it moves
+             forward past them; adding time runs every event it passes.
+    */
+    void setMicrosRaw (uint64_t microseconds) {
+      currentMicros = microseconds;
+      scheduler.advance(currentMicros);
+    };
+    void addMicrosRaw (uint64_t microseconds) {
+      advanceTo(currentMicros + microseconds);
     };
 
     void setMillisRaw (time_t milliseconds) {
-      currentMillis = (milliseconds & UINT32_MAX);
+      setMicrosRaw((uint64_t)(milliseconds & UINT32_MAX) * 1000);
     };
     void setMillisSecs(time_t seconds) {
       setMillisRaw(seconds *      1000);
@@ -118,8 +149,7 @@ class ArduinoMock {
     };
 
     void addMillisRaw (time_t milliseconds) {
-      currentMillis += milliseconds;
-      currentMillis &= UINT32_MAX;
+      addMicrosRaw((uint64_t)milliseconds * 1000);
     };
     void addMillisSecs(time_t seconds) {
       addMillisRaw(seconds *      1000);
@@ -131,6 +161,74 @@ class ArduinoMock {
       addMillisRaw(hours  * 60 * 60 * 1000);
     };
 
+    /**
+      \brief Virtual time consumed by each yield() call. Polling loops such as
+             Stream::timedRead() yield while they wait, so a non-zero value
+             lets their timeouts expire without any wall-clock waiting.
+    */
+    void setYieldMicros(time_t microseconds) {
+      yieldMicros = microseconds;
+    };
+    time_t getYieldMicros() {
+      return yieldMicros;
+    };
+
+    /**
+      \brief Virtual time between the edges shiftOut() and shiftIn() put on
+             the data and clock pins, so one bit takes twice this long.
+    */
+    void setShiftEdgeMicros(time_t microseconds) {
+      shiftEdgeMicros = microseconds;
+    };
+    time_t getShiftEdgeMicros() {
+      return shiftEdgeMicros;
+    };
+
+    /**
+      \brief Step at which pulseIn() polls a mocked digitalRead(); defaults
+             to 10 us, so a 1 s timeout costs 100000 calls. Scheduled events
+             in between are still run at their own time, so pulses driven by
+             them are measured exactly. With ArduinoFake, pulseIn() only
+             moves from event to event and does not poll.
+    */
+    void setPinPollMicros(time_t microseconds) {
+      pinPollMicros = microseconds > 0 ? microseconds : 1;
+    };
+    time_t getPinPollMicros() {
+      return pinPollMicros;
+    };
+
+    /**
+      \brief Schedule a callback at an absolute virtual time, in microseconds
+             on the getMicros64() time base. Fakes use this to inject events
+             (RX data, pin edges, connection results) at exact times.
+    */
+    void scheduleAt(uint64_t microseconds, VirtualScheduler::Callback callback) {
+      scheduler.scheduleAt(microseconds, callback);
+    };
+    void scheduleIn(uint64_t microseconds, VirtualScheduler::Callback callback) {
+      scheduler.scheduleAt(currentMicros + microseconds, callback);
+    };
+    uint64_t nextEventMicros() {
+      return scheduler.nextEventTime();
+    };
+    VirtualScheduler& getScheduler() {
+      return scheduler;
+    };
+
+    /**
+      \brief Move the clock forward to microseconds, running every scheduled
+             event on the way at its own time.
+    */
+    void advanceTo(uint64_t microseconds);
+
+    /**
+      \brief Move the clock to the next scheduled event and run it, or by
+             maxMicroseconds if nothing is due before then.
+      \return true if an event ran
+    */
+    bool advanceToNextEvent(uint64_t maxMicroseconds);
+
     MOCK_METHOD2(pinMode, void (uint8_t, uint8_t));
     MOCK_METHOD2(analogWrite, void (uint8_t, int));
     MOCK_METHOD2(digitalWrite, void (uint8_t, uint8_t));
@@ -142,4 +240,110 @@ class ArduinoMock {
 ArduinoMock* arduinoMockInstance();
 void releaseArduinoMock();
 
+/**
+  \class ArduinoFake
+  \brief Plain pin state backend for pinMode, digitalWrite, digitalRead,
+         analogRead and analogWrite, without any gmock dispatch.
+
+  While an ArduinoFake instance exists in the current MockContext the GPIO
+  functions go to it instead of ArduinoMock, so a test selects the backend
+  by calling arduinoFakeInstance() and releaseArduinoFake(). The clock
+  functions keep using ArduinoMock.
+
+  analogRead() returns the value set with setAnalogInput(), or samples the
+  pin's AnalogSource at the current virtual time.
+
+  Reading a pin in OUTPUT mode returns the level last written to it. Other
+  pins read the level driven with setDigitalInput(), or HIGH for an
+  undriven INPUT_PULLUP pin and LOW otherwise.
+
+  Every change of a pin's level is reported to the fake's
+  InterruptController, which runs the ISRs set up with attachInterrupt().
+  Other threads drive inputs through injectDigitalInput(); those changes
+  are queued without locks and applied on the sketch thread whenever it
+  reads a pin, enables interrupts or lets virtual time pass.
+*/
+class ArduinoFake {
+
+  public:
+    static const int num_pins = 256;
+
+    ArduinoFake();
+    ~ArduinoFake();
+
+    void pinMode(uint8_t pin, uint8_t mode);
+    void digitalWrite(uint8_t pin, uint8_t level);
+    int digitalRead(uint8_t pin);
+    int analogRead(uint8_t pin);
+    void analogWrite(uint8_t pin, int value);
+
+    /**
+      \brief Test side: drive external signals onto the pins
+    */
+    void setDigitalInput(uint8_t pin, uint8_t level);
+    void releaseDigitalInput(uint8_t pin);
+    void setAnalogInput(uint8_t pin, int value);
+    /**
+      \brief Sample source for analogRead() of pin; the fake takes ownership.
+             NULL, or a later setAnalogInput(), removes it.
+    */
+    void setAnalogSource(uint8_t pin, AnalogSource* source);
+
+    /**
+      \brief Thread-safe setDigitalInput() for stimulus threads
+      \return false if the stimulus queue is full
+    */
+    bool injectDigitalInput(uint8_t pin, uint8_t level);
+
+    /**
+      \brief Script an input waveform on the virtual clock: drive pin to
+             level at the absolute time microseconds (getMicros64() time
+             base), or for widthMicroseconds starting there. Needs the
+             ArduinoMock clock.
+    */
+    void scheduleDigitalInput(uint8_t pin, uint8_t level, uint64_t microseconds);
+    void schedulePulse(uint8_t pin, uint8_t level, uint64_t microseconds,
+                       uint64_t widthMicroseconds);
+
+    /**
+      \brief Apply queued stimuli and deliver pending interrupts
+    */
+    void service();
+
+    InterruptController& getInterrupts() {
+      return interrupts;
+    }
+
+    /**
+      \brief Test side: inspect what the sketch did with the pins
+    */
+    uint8_t getPinMode(uint8_t pin);
+    uint8_t getDigitalOutput(uint8_t pin);
+    int getAnalogOutput(uint8_t pin);
+    uint32_t getWriteCount(uint8_t pin);
+
+  private:
+    ArduinoFake(const ArduinoFake&);
+    ArduinoFake& operator=(const ArduinoFake&);
+
+    int level(uint8_t pin);
+    void levelChanged(uint8_t pin, int before);
+
+    struct PinState {
+      uint8_t mode;
+      uint8_t level;     // output latch
+      uint8_t input;     // externally driven level
+      bool driven;
+      int duty;          // last analogWrite value
+      int analog;        // value returned by analogRead
+      uint32_t writes;
+    };
+    PinState pins[num_pins];
+    AnalogSource* analogSources[num_pins];
+    InterruptController interrupts;
+    PinEdgeQueue stimuli;
+};
+ArduinoFake* arduinoFakeInstance();
+void releaseArduinoFake();
+
 #endif // ARDUINO_H
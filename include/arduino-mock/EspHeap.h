@@ -0,0 +1,230 @@
+/**
+ * Bounded model of the ESP8266 heap
+ */
+#ifndef ESP_HEAP_H
+#define ESP_HEAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <deque>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "StringAllocator.h"
+
+class EspHeap;
+
+/**
+  \brief Routes String buffers to an EspHeap. Buffers from elsewhere, e.g.
+         a String that grew before the heap was set, stay where they are.
+*/
+class EspHeapStringAllocator : public StringAllocator {
+
+  public:
+    explicit EspHeapStringAllocator(EspHeap& heap);
+
+  protected:
+    void* doReallocate(void* ptr, size_t oldSize, size_t newSize);
+    void doRelease(void* ptr, size_t size);
+
+  private:
+    EspHeap& heap;
+};
+
+/**
+  \brief Heap state after a change, see EspHeap::keepHistory()
+*/
+struct EspHeapSample {
+  uint64_t micros;
+  size_t used;
+  size_t maxFreeBlock;
+  uint8_t fragmentation;
+};
+
+/**
+  \class EspHeap
+  \brief A heap of the size the sketch gets on the device, managed like
+         umm_malloc: 8 byte blocks, a 4 byte header per allocation, first
+         fit in address order, neighbouring free blocks merged on release.
+         Allocations fail once no free run is long enough, however much
+         memory the host has.
+
+  The figures match the ESP class: getFreeBytes() is ESP.getFreeHeap(),
+  getMaxFreeBlockSize() ESP.getMaxFreeBlockSize() and getFragmentation()
+  ESP.getHeapFragmentation(). They are kept up to date as blocks come and
+  go, so reading them costs O(1). keepHistory() also records them after
+  every change.
+
+  A block goes back to the heap it came from whichever heap is current, see
+  espHeapFree(). Destroy a heap only once nothing allocated from it is in
+  use, Strings included.
+
+  failAfterCalls() and failAfterBytes() make every allocation fail once
+  the given number of allocations or requested bytes is used up, until
+  clearFailure(), so a test can walk the OOM paths of a piece of code one
+  allocation at a time.
+
+  Example usage:
+
+  EspHeap heap;
+  setEspHeap(&heap);  // String, TLS buffers and lwIP memory
+  heap.failAfterCalls(3);
+  EXPECT_FALSE(publishReading(client, 21.5));
+  EXPECT_EQ(0U, heap.getLiveAllocations());
+  setEspHeap(NULL);
+*/
+class EspHeap {
+
+  public:
+    static const size_t default_size = 48 * 1024;
+    static const size_t block_size = 8;
+    static const size_t header_size = 4;
+
+    explicit EspHeap(size_t size = default_size);
+    ~EspHeap();
+
+    /**
+      \return NULL for size 0, out of memory or an injected failure
+    */
+    void* allocate(size_t size);
+    /**
+      \brief Like realloc(): grows in place when the next blocks are free,
+             shrinking always works
+    */
+    void* reallocate(void* ptr, size_t size);
+    void release(void* ptr);
+    /**
+      \brief true if ptr points into this heap
+    */
+    bool owns(const void* ptr) const;
+
+    size_t getSize() const {
+      return storage.size() * block_size;
+    }
+    size_t getUsedBytes() const {
+      return usedBlocks * block_size;
+    }
+    size_t getFreeBytes() const {
+      return getSize() - getUsedBytes();
+    }
+    size_t getPeakUsedBytes() const {
+      return peakUsedBlocks * block_size;
+    }
+    /**
+      \brief The largest allocation that would succeed now
+    */
+    size_t getMaxFreeBlockSize() const {
+      return runLengths.empty() ? 0 : *runLengths.rbegin() * block_size - header_size;
+    }
+    /**
+      \brief 0 when all free memory is one run, towards 100 the more it is
+             split up
+    */
+    uint8_t getFragmentation() const;
+    size_t getLiveAllocations() const {
+      return used.size();
+    }
+    size_t getFailedAllocations() const {
+      return failed;
+    }
+    /**
+      \brief Record the heap after every change, stamped with the virtual
+             time of the ArduinoMock clock (0 without one), one sample per
+             point in time
+      \param samples How many of the latest samples to keep; 0, the
+             default, records none
+    */
+    void keepHistory(size_t samples);
+    const std::deque<EspHeapSample>& getHistory() const {
+      return history;
+    }
+
+    void failAfterCalls(size_t calls);
+    void failAfterBytes(size_t bytes);
+    void clearFailure();
+
+    StringAllocator& getStringAllocator() {
+      return strings;
+    }
+
+  private:
+    EspHeap(const EspHeap&);
+    EspHeap& operator=(const EspHeap&);
+
+    struct Allocation {
+      size_t blocks;
+      size_t size;
+    };
+
+    typedef std::map<size_t, size_t> RunMap;
+
+    static size_t blocksFor(size_t size);
+    // Takes size bytes off the failure budgets, false if they are used up
+    bool charge(size_t size);
+    // First fit, NULL if no run is long enough
+    void* take(size_t size);
+    void giveBack(size_t start, size_t blocks);
+    size_t blockOf(const void* ptr) const;
+    // Every change to freeRuns goes through these two, which keep
+    // runLengths and runSquares in step
+    void addRun(size_t start, size_t blocks);
+    RunMap::iterator removeRun(RunMap::iterator run);
+    void record();
+
+    std::vector<uint64_t> storage;
+    std::map<size_t, Allocation> used;   // by first block
+    RunMap freeRuns;                     // first block -> length in blocks
+    std::multiset<size_t> runLengths;    // of freeRuns, for the largest
+    uint64_t runSquares;                 // sum of squared run lengths
+    size_t usedBlocks;
+    size_t peakUsedBlocks;
+    size_t failed;
+    size_t callBudget;
+    size_t byteBudget;
+    size_t historyLimit;
+    std::deque<EspHeapSample> history;
+    EspHeapStringAllocator strings;
+};
+
+/**
+  \brief The current MockContext's heap, NULL unless one was set
+*/
+EspHeap* espHeap();
+/**
+  \brief Make heap the current MockContext's heap. Its String allocator
+         becomes the current String allocator, unless an allocator other
+         than the previous heap's was set on purpose, which stays.
+  \param heap Heap to use, not owned; NULL to go back to the host heap
+  \return The previous heap
+*/
+EspHeap* setEspHeap(EspHeap* heap);
+/**
+  \brief The live heap, in any thread, that ptr points into; NULL for host
+         memory
+*/
+EspHeap* espHeapOwning(const void* ptr);
+
+/**
+  malloc() and friends on the current heap, or on the host heap while none
+  is set. realloc() and free() look up where a block lives, so a block can
+  be freed after its heap stopped being current, or from another context,
+  and host memory after a heap was set, e.g. buffers from before
+  setEspHeap(). The default String allocator does the same.
+
+  lwIP takes its memory, and so UdpContext and ClientContext their pbufs,
+  from here when lwipopts.h has:
+
+  #define MEM_LIBC_MALLOC 1
+  #define mem_clib_malloc espHeapMalloc
+  #define mem_clib_calloc espHeapCalloc
+  #define mem_clib_free espHeapFree
+*/
+extern "C" {
+void* espHeapMalloc(size_t size);
+void* espHeapCalloc(size_t count, size_t size);
+void* espHeapRealloc(void* ptr, size_t size);
+void espHeapFree(void* ptr);
+}
+
+#endif // ESP_HEAP_H
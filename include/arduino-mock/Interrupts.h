@@ -0,0 +1,123 @@
+/**
+ * Interrupt delivery for the GPIO fake
+ */
+#ifndef INTERRUPTS_H
+#define INTERRUPTS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+
+/**
+  \class PinEdgeQueue
+  \brief Bounded lock-free queue of (pin, level) stimuli
+
+  Any number of stimulus threads may push; one thread, the one running the
+  sketch, pops. Based on Dmitry Vyukov's bounded MPMC queue: every cell
+  carries a sequence number telling producers and the consumer whose turn
+  it is, so neither side ever takes a lock.
+*/
+class PinEdgeQueue {
+
+  public:
+    /**
+      \param capacity Number of cells, rounded up to a power of two
+    */
+    explicit PinEdgeQueue(size_t capacity);
+
+    /**
+      \return false if the queue is full; the stimulus is not queued
+    */
+    bool push(uint8_t pin, uint8_t level);
+    bool pop(uint8_t& pin, uint8_t& level);
+
+  private:
+    struct Cell {
+      std::atomic<size_t> sequence;
+      uint16_t data;
+    };
+
+    std::vector<Cell> cells;
+    size_t mask;
+    std::atomic<size_t> enqueuePos;
+    std::atomic<size_t> dequeuePos;
+};
+
+/**
+  \class InterruptController
+  \brief Per-interrupt ISR table with edge detection and pending delivery
+
+  The GPIO fake reports every change of a pin's level with pinChanged().
+  When the change matches the edge an ISR was attached for (RISING, FALLING
+  or CHANGE) the ISR runs right away, unless interrupts are disabled or an
+  ISR is already running. Then the interrupt becomes pending and runs once
+  interrupts() re-enables delivery or the running ISR returns.
+
+  Like the interrupt status flags of the hardware, an interrupt is pending
+  at most once: further edges on it before delivery are counted as lost.
+  Pending interrupts are delivered in the order they were raised.
+*/
+class InterruptController {
+
+  public:
+    typedef void (*Handler)(void);
+    static const int num_interrupts = 256;
+
+    InterruptController();
+
+    void attach(uint8_t interrupt, Handler isr, int mode);
+    void detach(uint8_t interrupt);
+    bool isAttached(uint8_t interrupt) const {
+      return handlers[interrupt] != NULL;
+    }
+    /**
+      \brief true if an ISR is attached to the interrupt of pin
+    */
+    bool watches(uint8_t pin) const {
+      return watched[pin];
+    }
+
+    void enable();
+    void disable();
+    bool isEnabled() const {
+      return enabled;
+    }
+
+    /**
+      \brief Report a level change on a pin, from the sketch thread
+    */
+    void pinChanged(uint8_t pin, uint8_t level);
+
+    /**
+      \brief Deliver pending interrupts, if delivery is enabled
+    */
+    void service();
+
+    uint32_t getDeliveredCount(uint8_t interrupt) const {
+      return delivered[interrupt];
+    }
+    uint32_t getLostCount(uint8_t interrupt) const {
+      return lost[interrupt];
+    }
+    size_t getPendingCount() const {
+      return pendingOrder.size() - pendingHead;
+    }
+
+  private:
+    void raise(uint8_t interrupt);
+    void run(uint8_t interrupt);
+
+    Handler handlers[num_interrupts];
+    int modes[num_interrupts];
+    bool pending[num_interrupts];
+    uint32_t delivered[num_interrupts];
+    uint32_t lost[num_interrupts];
+    bool watched[num_interrupts];
+    std::vector<uint8_t> pendingOrder;
+    size_t pendingHead;
+    bool enabled;
+    bool inIsr;
+};
+
+#endif // INTERRUPTS_H
@@ -0,0 +1,106 @@
+/**
+ * Per-thread registry of mock instances
+ */
+#ifndef MOCK_CONTEXT_H
+#define MOCK_CONTEXT_H
+
+#include <stddef.h>
+#include <memory>
+
+class ArduinoMock;
+class ArduinoFake;
+class EspHeap;
+class PinTrace;
+class SerialMock;
+class SerialCapture;
+class SerialPty;
+class SoftwareSerialRegistry;
+class StringAllocator;
+class WireMock;
+class SPIMock;
+class EEPROMMock;
+class OneWireMock;
+class SparkMock;
+class WiFiMock;
+class IRrecvMock;
+
+/**
+  \class MockContext
+  \brief Holds every mock instance the global facades (Serial, Wire, SPI, ...)
+         and the free Arduino functions forward to.
+
+  Each thread has its own current context, so tests running in parallel
+  threads of one process never see each other's mocks, clock or settings.
+  Unless another context is installed, a thread uses a default context that
+  lives as long as the thread.
+
+  The xxxMockInstance()/releaseXxxMock() functions create and delete the
+  mocks in the current context; a context deletes whatever is left in it
+  when it is destroyed.
+*/
+class MockContext {
+
+  public:
+    MockContext();
+    ~MockContext();
+
+    ArduinoMock* arduino;
+    ArduinoFake* arduinoFake;
+    PinTrace* pinTrace;
+    SerialMock* serial;
+    SerialCapture* serialCapture;
+    SerialPty* serialPty;
+    std::shared_ptr<SoftwareSerialRegistry> softwareSerials;  // shared with the fakes
+    WireMock* wire;
+    SPIMock* spi;
+    EEPROMMock* eeprom;
+    OneWireMock* oneWire;
+    SparkMock* spark;
+    WiFiMock* wifi;
+    IRrecvMock* irrecv;
+
+    bool serialPrintToCout;
+    StringAllocator* stringAllocator;  // not owned, see setStringAllocator()
+    EspHeap* espHeap;                  // not owned, see setEspHeap()
+
+  private:
+    MockContext(const MockContext&);
+    MockContext& operator=(const MockContext&);
+};
+
+/**
+  \brief The calling thread's current context
+*/
+MockContext& currentMockContext();
+
+/**
+  \brief Install context as the calling thread's current context
+  \param context Context to use, or NULL to go back to the thread's default
+  \return The previously installed context, NULL if it was the default
+*/
+MockContext* setCurrentMockContext(MockContext* context);
+
+/**
+  \class ScopedMockContext
+  \brief A fresh context installed for the calling thread for the lifetime of
+         the object. The previous context is restored on destruction.
+
+  Example usage, one shard of a parallel test runner:
+
+  std::thread shard([]() {
+    ScopedMockContext context;
+    ArduinoMock* arduinoMock = arduinoMockInstance();
+    ...
+  });
+*/
+class ScopedMockContext : public MockContext {
+
+  public:
+    ScopedMockContext();
+    ~ScopedMockContext();
+
+  private:
+    MockContext* previous;
+};
+
+#endif // MOCK_CONTEXT_H
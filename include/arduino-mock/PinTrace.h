@@ -0,0 +1,105 @@
+/**
+ * Pin transition trace recorder
+ */
+#ifndef PIN_TRACE_H
+#define PIN_TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <ostream>
+#include <vector>
+
+/**
+  \class PinTrace
+  \brief Records every pinMode, digitalWrite and analogWrite call with its
+         virtual timestamp, for export to VCD (GTKWave and friends).
+
+  Each call is packed into one 64-bit word: 40 bits of virtual time in
+  microseconds (wrapping after about 12.7 days), 2 bits of call kind, 8 bits
+  of pin and 14 bits of value. Records go into a preallocated power-of-two
+  ring buffer; once it is full the oldest records are overwritten and
+  counted as dropped, so recording never allocates.
+
+  While a PinTrace instance exists in the current MockContext, the GPIO
+  functions record into it, whichever backend (ArduinoMock or ArduinoFake)
+  serves them.
+
+  Example usage:
+
+  PinTrace* trace = pinTraceInstance();
+  ... run the bit-banging driver ...
+  trace->exportVcd("spi.vcd");
+  releasePinTrace();
+*/
+class PinTrace {
+
+  public:
+    enum Kind {
+      PIN_MODE = 0,
+      DIGITAL_WRITE = 1,
+      ANALOG_WRITE = 2
+    };
+
+    struct Record {
+      uint64_t micros;
+      Kind kind;
+      uint8_t pin;
+      uint16_t value;
+    };
+
+    static const size_t default_capacity = 1 << 20;
+    static const uint16_t max_value = (1 << 14) - 1;
+
+    /**
+      \param capacity Number of records kept, rounded up to a power of two
+    */
+    explicit PinTrace(size_t capacity = default_capacity);
+
+    void record(Kind kind, uint8_t pin, int value, uint64_t micros) {
+      const uint64_t clamped = value < 0 ? 0 : (value > max_value ? max_value : value);
+      records[head & mask] = (micros << 24) | ((uint64_t)kind << 22)
+                             | ((uint64_t)pin << 14) | clamped;
+      head++;
+    }
+
+    /**
+      \brief Number of records held, at most the capacity
+    */
+    size_t size() const {
+      return head < records.size() ? head : records.size();
+    }
+    size_t capacity() const {
+      return records.size();
+    }
+    uint64_t dropped() const {
+      return head - size();
+    }
+
+    /**
+      \brief The index-th oldest record still held
+    */
+    Record at(size_t index) const;
+
+    void clear() {
+      head = 0;
+    }
+
+    /**
+      \brief Write the trace as a Value Change Dump with a 1 us timescale.
+             Pins that saw digital calls become 1-bit wires, 'z' while not
+             in OUTPUT mode; pins that saw analogWrite become 16-bit
+             vectors named pwmN.
+    */
+    void exportVcd(std::ostream& out) const;
+    bool exportVcd(const char* path) const;
+
+  private:
+    std::vector<uint64_t> records;
+    size_t mask;
+    uint64_t head;
+};
+
+PinTrace* pinTraceInstance(size_t capacity = PinTrace::default_capacity);
+void releasePinTrace();
+
+#endif // PIN_TRACE_H
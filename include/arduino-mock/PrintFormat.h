@@ -0,0 +1,63 @@
+/**
+ * Number formatting for Serial print and println
+ */
+#ifndef PRINT_FORMAT_H
+#define PRINT_FORMAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <type_traits>
+
+/**
+  \brief Buffer size that fits any formatNumber() or formatInteger() result:
+         64 binary digits, a sign and the terminating NUL
+*/
+static const size_t print_number_size = 66;
+
+/**
+  \brief Buffer size that fits any formatDouble() result: sign, 10 integer
+         digits, point, up to 255 decimals and the terminating NUL
+*/
+static const size_t print_double_size = 268;
+
+/**
+  \brief Write value in base (2 to 36, anything else means 10) with upper
+         case letter digits, like Print::printNumber() of the Arduino core.
+         Does not allocate or touch any global state.
+  \param buffer At least print_number_size bytes; the result is NUL
+         terminated
+  \return Length of the result
+*/
+size_t formatNumber(char* buffer, unsigned long long value, int base);
+
+/**
+  \brief Write value as print(value, base) does: negative numbers get a
+         minus sign in base 10 only and print as their two's complement, at
+         the width of their type, in any other base. Base 0 writes the value
+         as a single raw byte.
+*/
+template<typename T> size_t formatInteger(char* buffer, T value, int base) {
+  typedef typename std::make_unsigned<T>::type Unsigned;
+  if (base == 0) {
+    buffer[0] = (char)value;
+    buffer[1] = '\0';
+    return 1;
+  }
+  if (base == 10 && std::is_signed<T>::value && value < 0) {
+    buffer[0] = '-';
+    return 1 + formatNumber(buffer + 1, (Unsigned)(0 - (Unsigned)value), 10);
+  }
+  return formatNumber(buffer, (Unsigned)value, base);
+}
+
+/**
+  \brief Write value with digits decimals, rounded half up, as
+         Print::printFloat() does: "nan", "inf" and, beyond the range of a
+         32-bit integer part, "ovf".
+  \param buffer At least print_double_size bytes; the result is NUL
+         terminated
+  \param digits Number of decimals, at most 255
+*/
+size_t formatDouble(char* buffer, double value, int digits);
+
+#endif // PRINT_FORMAT_H
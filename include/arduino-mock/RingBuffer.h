@@ -0,0 +1,94 @@
+/**
+ * Growable byte ring buffer for the serial fakes
+ */
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+/**
+  \class RingBuffer
+  \brief FIFO of bytes in a power-of-two ring that doubles when full
+
+  head and tail count every byte ever read and written, and are only masked
+  when indexing, so the ring never needs a reserved empty slot. Data is fed
+  and read in bulk with at most two memcpy calls, one on each side of the
+  wrap point.
+*/
+class RingBuffer {
+
+  public:
+    static const size_t default_capacity = 128;
+
+    /**
+      \param capacity Initial capacity, rounded up to a power of two
+    */
+    explicit RingBuffer(size_t capacity = default_capacity);
+
+    size_t size() const {
+      return tail - head;
+    }
+    bool empty() const {
+      return tail == head;
+    }
+    size_t capacity() const {
+      return data.size();
+    }
+    void clear() {
+      head = tail = 0;
+    }
+
+    /**
+      \brief Append bytes, growing the ring as needed
+    */
+    void feed(const uint8_t* bytes, size_t length);
+
+    /**
+      \brief Remove and return the oldest byte; the buffer must not be empty
+    */
+    uint8_t pop() {
+      return data[head++ & mask];
+    }
+    /**
+      \brief The index-th oldest byte, without removing it
+    */
+    uint8_t peek(size_t index) const {
+      return data[(head + index) & mask];
+    }
+
+    /**
+      \brief The oldest bytes in place: front() points to contiguous() of
+             them, which is fewer than size() when the data wraps around
+    */
+    const uint8_t* front() const {
+      return &data[head & mask];
+    }
+    size_t contiguous() const {
+      const size_t toEnd = capacity() - (head & mask);
+      return toEnd < size() ? toEnd : size();
+    }
+    /**
+      \brief Remove up to length of the oldest bytes without copying them
+    */
+    void consume(size_t length) {
+      head += length < size() ? length : size();
+    }
+
+    /**
+      \brief Remove up to length of the oldest bytes into buffer
+      \return Number of bytes copied
+    */
+    size_t read(uint8_t* buffer, size_t length);
+
+  private:
+    void grow(size_t needed);
+
+    std::vector<uint8_t> data;
+    size_t mask;
+    size_t head;
+    size_t tail;
+};
+
+#endif // RING_BUFFER_H
@@ -0,0 +1,86 @@
+/**
+ * Virtual time event scheduler
+ */
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include <functional>
+#include <map>
+#include <vector>
+
+/**
+  \class VirtualScheduler
+  \brief Hashed timer wheel holding callbacks due at absolute virtual times
+
+  Events are kept in a wheel of one-millisecond slots covering the next
+  wheel_slots milliseconds; events further away wait in an ordered overflow
+  list and are cascaded into the wheel as it turns. Callbacks due at the same
+  microsecond run in the order they were scheduled.
+
+  The scheduler does not own the clock: ArduinoMock pops due events while it
+  advances virtual time, so blocking calls such as delay() jump from one event
+  to the next instead of stepping through every millisecond.
+*/
+class VirtualScheduler {
+
+  public:
+    typedef std::function<void()> Callback;
+
+    VirtualScheduler();
+
+    /**
+      \brief Schedule a callback
+      \param when Absolute virtual time in microseconds. Times in the past
+             are due immediately.
+      \param callback Function to run once the clock reaches when
+    */
+    void scheduleAt(uint64_t when, Callback callback);
+
+    /**
+      \brief Time of the earliest pending event, or UINT64_MAX if none
+    */
+    uint64_t nextEventTime();
+
+    /**
+      \brief Remove the earliest pending event if it is due at or before limit
+      \param limit Latest virtual time the caller is advancing to
+      \param when Set to the time the event was scheduled for
+      \param callback Set to the event's callback
+      \return true if an event was removed
+    */
+    bool popDue(uint64_t limit, uint64_t& when, Callback& callback);
+
+    /**
+      \brief Turn the wheel forward to now, skipping empty slots. Called by
+             the clock after it moved without running events.
+    */
+    void advance(uint64_t now);
+
+    size_t size() const;
+    bool empty() const;
+    void clear();
+
+  private:
+    static const uint64_t tick_micros = 1000;
+    static const uint64_t wheel_slots = 256;
+
+    struct Event {
+      uint64_t when;
+      uint64_t seq;
+      Callback callback;
+    };
+
+    std::vector<Event>& slotFor(uint64_t tick);
+    void insert(Event& event);
+    void cascade();
+    bool earliest(uint64_t& tick, size_t& index);
+
+    std::vector<Event> wheel[wheel_slots];
+    std::multimap<uint64_t, Event> overflow;
+    uint64_t baseTick;
+    uint64_t nextSeq;
+    size_t wheelCount;
+};
+
+#endif // SCHEDULER_H
@@ -5,9 +5,12 @@
 #define SERIAL_H
 
 #include <stdint.h>
+#include <deque>
 #include <gmock/gmock.h>
+#include "RingBuffer.h"
 
 using ::testing::_;
+using ::testing::An;
 using ::testing::Invoke;
 using ::testing::DoDefault;
 
@@ -19,30 +22,116 @@ using ::testing::DoDefault;
 
 /**
   \see #SoftwareSerialFake
+
+  With pacing enabled and a baud rate set by begin(), the fake models UART
+  timing on the ArduinoMock clock (which must exist):
+
+  - Fed bytes travel over the line back to back, one frame (10 bits for
+    8N1) each, and only reach the RX FIFO when their stop bit is in.
+    available() and read() see them from then on. A byte that arrives while
+    the RX FIFO is full is dropped and counted as an overrun.
+  - write() blocks, by moving the clock, until all but the TX FIFO's worth
+    of bytes are on the line; flush() until the last stop bit is out.
+
+  Each pending RX byte is scheduled as an event, so delayUntilEvent() and
+  the Stream timeouts wake up when it arrives.
+
+  Example usage:
+
+  SerialMock* serial = serialMockInstance();
+  serial->getFake().setPaced(true, 64, 64);
+  Serial.begin(115200);
+  serial->mock_buffer_feed(frame, sizeof(frame));
+  // frame needs 87 us per byte to arrive
 */
 class SerialFake {
 
    public:
+    static const size_t default_fifo_size = 64;
 
+    SerialFake();
+
+    /**
+      \param paced Model the line timing from begin() on
+      \param rxFifo, txFifo FIFO sizes in bytes, 0 for unlimited; 64 is the
+             AVR core buffer, 128 the ESP8266 UART hardware FIFO
+    */
+    void setPaced(bool paced, size_t rxFifo = default_fifo_size,
+                  size_t txFifo = default_fifo_size);
     /**
-      \brief Load user specified data into SerialFake buffer
+      \brief Bits per frame including start and stop bits, 10 for 8N1
+    */
+    void setFrameBits(uint8_t bits);
+    uint32_t getBaud() const {
+      return baud;
+    }
+    /**
+      \brief RX bytes dropped because the RX FIFO was full
+    */
+    size_t getRxOverruns() const {
+      return rxOverruns;
+    }
+
+    /**
+      \brief Replace the contents of the SerialFake buffer with user specified data
       \param buffer User buffer to copy the data from
       \param len Length of the user buffer
     */
-    void buffer_load(uint8_t buffer_0[], const uint8_t len);
+    void buffer_load(const uint8_t buffer_0[], const size_t len);
+
+    /**
+      \brief Append user specified data to the SerialFake buffer, which grows
+             as needed, e.g. to stream a long capture in chunks
+    */
+    void feed(const uint8_t data[], const size_t len);
 
     /**
-      \brief Fake methods to operate with the RX buffer
+      \brief Fake methods to operate with the RX buffer. available() saturates
+             at 255 like its uint8_t return type; read(buffer, len) drains up
+             to len bytes at once and returns how many it copied.
     */
     uint8_t available();
     uint8_t read();
+    size_t read(uint8_t buffer_0[], const size_t len);
     uint8_t at(const uint8_t index);
 
+    /**
+      \brief Fake methods the mock delegates begin, write and flush to. They
+             only take virtual time while paced; write returns the number of
+             bytes either way.
+    */
+    uint8_t begin(uint32_t baud);
+    size_t write(uint8_t val);
+    size_t write(const char *str);
+    size_t write(const uint8_t *buffer, size_t size);
+    void flush();
+
   private:
-    static const uint8_t buffer_size = 128;
-    uint8_t buffer[buffer_size] = {0};
-    uint8_t buffer_head = 0;
-    uint8_t buffer_tail = 0;
+    // A run of fed bytes on the RX line, the first one starting at start
+    struct Segment {
+      uint64_t start;
+      size_t length;
+      size_t taken;
+    };
+
+    bool isPaced() const {
+      return paced && baud > 0;
+    }
+    uint64_t frameEnd(uint64_t start, uint64_t frames) const;
+    void receive();
+
+    RingBuffer rx;
+    bool paced;
+    uint32_t baud;
+    uint8_t frameBits;
+    size_t rxFifo;
+    size_t txFifo;
+    RingBuffer wire;
+    std::deque<Segment> segments;
+    uint64_t wakeMicros;
+    size_t rxOverruns;
+    uint64_t txStart;
+    uint64_t txBytes;
 };
 
 class SerialMock {
@@ -92,7 +181,7 @@ class SerialMock {
       \param ignore_calls Flag to set the mock to expect and ignore all calls on
              methods related to the buffer (available, read and operator [])
     */
-    void mock_buffer_load(uint8_t buffer[], const uint8_t len, bool ignore_calls = true) {
+    void mock_buffer_load(const uint8_t buffer[], const size_t len, bool ignore_calls = true) {
         fake_.buffer_load(buffer, len);
         if (ignore_calls) {
             EXPECT_CALL(*this, available())
@@ -103,23 +192,50 @@ class SerialMock {
                 .WillRepeatedly(DoDefault());
         }
     }
-    void mock_buffer_load(char buffer[], const uint8_t len, bool ignore_calls = true) {
-        mock_buffer_load((uint8_t*)buffer, len, ignore_calls);
+    void mock_buffer_load(const char buffer[], const size_t len, bool ignore_calls = true) {
+        mock_buffer_load((const uint8_t*)buffer, len, ignore_calls);
+    }
+
+    /**
+      \brief Append to the fake RX buffer without touching its contents
+    */
+    void mock_buffer_feed(const uint8_t buffer[], const size_t len) {
+        fake_.feed(buffer, len);
     }
 
     /**
-      \brief Constructor. Sets default mock actions for available, read and operator [],
-             to be redirected to SerialFake
+      \brief Constructor. Sets default mock actions for begin, write, flush,
+             available, read and operator [], to be redirected to SerialFake.
+             Without an action of its own, write therefore returns the
+             number of bytes written and begin returns 1, where plain gmock
+             defaults returned 0.
     */
     SerialMock() {
+        ON_CALL(*this, begin(_))
+            .WillByDefault(Invoke(&fake_, &SerialFake::begin));
+        ON_CALL(*this, write(An<uint8_t>()))
+            .WillByDefault(Invoke(&fake_, static_cast<size_t (SerialFake::*)(uint8_t)>(&SerialFake::write)));
+        ON_CALL(*this, write(An<const char *>()))
+            .WillByDefault(Invoke(&fake_, static_cast<size_t (SerialFake::*)(const char *)>(&SerialFake::write)));
+        ON_CALL(*this, write(_, _))
+            .WillByDefault(Invoke(&fake_, static_cast<size_t (SerialFake::*)(const uint8_t *, size_t)>(&SerialFake::write)));
+        ON_CALL(*this, flush())
+            .WillByDefault(Invoke(&fake_, &SerialFake::flush));
         ON_CALL(*this, available())
             .WillByDefault(Invoke(&fake_, &SerialFake::available));
         ON_CALL(*this, read())
-            .WillByDefault(Invoke(&fake_, &SerialFake::read));
+            .WillByDefault(Invoke(&fake_, static_cast<uint8_t (SerialFake::*)()>(&SerialFake::read)));
         ON_CALL(*this, at(_))
             .WillByDefault(Invoke(&fake_, &SerialFake::at));
     }
 
+    /**
+      \brief The fake behind the default actions, e.g. to enable pacing
+    */
+    SerialFake& getFake() {
+        return fake_;
+    }
+
    private:
     SerialFake fake_;  // Keeps an instance of the fake in the mock.
 };
@@ -127,10 +243,11 @@ class SerialMock {
 
 class Serial_ {
 
-  private:
-    static bool printToCout;
-
   public:
+    /**
+      \brief Print to std::cout instead of the mock. The setting belongs to the
+             calling thread's MockContext.
+    */
     static void setPrintToCout(bool flag);
 
   public:
@@ -0,0 +1,155 @@
+/**
+ * Serial TX capture sink
+ */
+#ifndef SERIAL_CAPTURE_H
+#define SERIAL_CAPTURE_H
+
+#include <stddef.h>
+#include <string.h>
+#include <deque>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+  \brief Non-owning view of captured bytes. Valid until the capture is
+         cleared or released; appending never moves bytes already
+         captured.
+*/
+struct CaptureView {
+  const char* data;
+  size_t length;
+
+  std::string str() const {
+    return std::string(data, length);
+  }
+};
+
+inline bool operator==(const CaptureView& view, const char* text) {
+  return strlen(text) == view.length && memcmp(view.data, text, view.length) == 0;
+}
+inline bool operator==(const char* text, const CaptureView& view) {
+  return view == text;
+}
+inline bool operator!=(const CaptureView& view, const char* text) {
+  return !(view == text);
+}
+inline bool operator!=(const char* text, const CaptureView& view) {
+  return !(view == text);
+}
+
+std::ostream& operator<<(std::ostream& out, const CaptureView& view);
+
+/**
+  \class SerialCapture
+  \brief Collects everything the sketch sends through Serial, without gmock
+
+  While a SerialCapture instance exists in the current MockContext, the
+  Serial write, print and println functions append their output to it
+  directly, bypassing SerialMock and setPrintToCout(). Together with a
+  SerialPty it records what is sent to the terminal.
+
+  Output is stored in chunks that are never reallocated or copied. The
+  first one is small and each further one twice the size of the one before,
+  up to chunk_size, so short captures stay small and long ones, with or
+  without newlines, cost amortized constant time per byte. Lines may span
+  chunks: lines() points into the chunks for the others and joins only
+  these into storage of the capture.
+
+  Example usage:
+
+  SerialCapture* capture = serialCaptureInstance();
+  ... run the sketch ...
+  std::vector<CaptureView> lines = capture->lines();
+  EXPECT_EQ("READY", lines[0]);
+  releaseSerialCapture();
+*/
+class SerialCapture {
+
+  public:
+    static const size_t first_chunk_size = 256;
+    static const size_t chunk_size = 1 << 20;
+
+    SerialCapture();
+
+    void append(const char* data, size_t length);
+    void append(char c) {
+      if (!chunks.empty() && chunks.back().used < chunks.back().capacity) {
+        Chunk& chunk = chunks.back();
+        chunk.data[chunk.used++] = c;
+        total++;
+        return;
+      }
+      append(&c, 1);
+    }
+    void append(const char* text) {
+      append(text, strlen(text));
+    }
+
+    /**
+      \brief Total number of bytes captured
+    */
+    size_t size() const {
+      return total;
+    }
+    bool empty() const {
+      return total == 0;
+    }
+
+    /**
+      \brief Forget the captured output, keeping the largest chunk allocated
+    */
+    void clear();
+
+    /**
+      \brief The capture split into contiguous pieces, in order
+    */
+    size_t chunkCount() const {
+      return chunks.size();
+    }
+    CaptureView chunk(size_t index) const {
+      CaptureView view = { chunks[index].data.get(), chunks[index].used };
+      return view;
+    }
+
+    /**
+      \brief Every line, without its "\n" or "\r\n". A last line without a
+             terminator is included. A line that spans chunks is copied
+             once into storage of the capture, which lives as long as the
+             chunks do.
+    */
+    std::vector<CaptureView> lines() const;
+
+    /**
+      \brief Copy of the whole capture, for short outputs and assertions
+    */
+    std::string str() const;
+
+  private:
+    SerialCapture(const SerialCapture&);
+    SerialCapture& operator=(const SerialCapture&);
+
+    void startChunk(size_t length);
+    CaptureView joinLine(const std::vector<size_t>& starts, size_t firstChunk,
+                         size_t firstOffset, size_t lastChunk,
+                         size_t lastOffset) const;
+
+    struct Chunk {
+      std::unique_ptr<char[]> data;
+      size_t used;
+      size_t capacity;
+    };
+    std::vector<Chunk> chunks;
+    size_t total;
+    // Lines that span chunks, joined by lines(); joinedAt maps the offset
+    // of such a line in the capture to its latest copy
+    mutable std::deque<std::string> joined;
+    mutable std::map<size_t, size_t> joinedAt;
+};
+
+SerialCapture* serialCaptureInstance();
+void releaseSerialCapture();
+
+#endif // SERIAL_CAPTURE_H
@@ -0,0 +1,108 @@
+/**
+ * Pseudo-terminal backend for Serial
+ */
+#ifndef SERIAL_PTY_H
+#define SERIAL_PTY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "RingBuffer.h"
+
+/**
+  \class SerialPty
+  \brief Connects Serial to a Linux pseudo-terminal, so host-compiled
+         firmware can be driven by minicom, pyserial or any other tool that
+         opens a serial port.
+
+  While a SerialPty instance exists in the current MockContext, Serial
+  output goes to the terminal and available(), read() and operator [] read
+  from it; SerialMock is not involved. operator [] returns 0 for an index
+  at or past the bytes available, so a 0xFF byte stays distinguishable.
+
+  The master side of the terminal is nonblocking. Input is taken in with
+  one read() of up to rx_batch bytes into a RingBuffer whenever the sketch
+  asks for data and none is buffered. Output is collected and written with
+  one write() once a line is complete, tx_batch bytes are pending, or the
+  sketch calls flush(), available() or read(). Output the tool does not
+  read yet stays pending up to tx_limit bytes; like a UART nobody drains,
+  the terminal drops what comes on top, see getTxDropped().
+
+  Example usage:
+
+  SerialPty* pty = serialPtyInstance("/tmp/ttyFIRMWARE");
+  // point the configuration tool at /tmp/ttyFIRMWARE, then
+  SketchRunner().runLoops(UINT64_MAX);
+*/
+class SerialPty {
+
+  public:
+    static const size_t rx_batch = 4096;
+    static const size_t tx_batch = 4096;
+    static const size_t tx_limit = 65536;
+
+    /**
+      \param linkPath If not NULL, a symlink to the terminal is created at
+             this path (replacing an existing one) and removed again on
+             destruction, for tools configured with a fixed port name.
+    */
+    explicit SerialPty(const char* linkPath = NULL);
+    ~SerialPty();
+
+    /**
+      \brief false if the terminal could not be set up
+    */
+    bool isOpen() const {
+      return master >= 0;
+    }
+    /**
+      \brief Device path of the terminal, e.g. /dev/pts/3
+    */
+    const std::string& getSlaveName() const {
+      return slaveName;
+    }
+
+    size_t available();
+    /**
+      \return the next byte, or -1 if there is none
+    */
+    int read();
+    size_t read(uint8_t* buffer, size_t length);
+    /**
+      \return the index-th pending byte, or -1 if there are not that many
+    */
+    int peek(size_t index);
+
+    void write(const char* data, size_t length);
+    /**
+      \brief Output bytes dropped because tx_limit bytes were pending
+    */
+    size_t getTxDropped() const {
+      return txDropped;
+    }
+    /**
+      \brief Hand all pending output to the terminal, as far as it takes it
+    */
+    void flush();
+
+  private:
+    SerialPty(const SerialPty&);
+    SerialPty& operator=(const SerialPty&);
+
+    void receive();
+
+    int master;
+    int slave;
+    std::string slaveName;
+    std::string linkPath;
+    RingBuffer rx;
+    std::vector<char> tx;
+    size_t txDropped;
+};
+
+SerialPty* serialPtyInstance(const char* linkPath = NULL);
+void releaseSerialPty();
+
+#endif // SERIAL_PTY_H
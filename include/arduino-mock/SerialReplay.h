@@ -0,0 +1,182 @@
+/**
+ * Timestamped serial traffic captures and their replay
+ */
+#ifndef SERIAL_REPLAY_H
+#define SERIAL_REPLAY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <functional>
+#include <memory>
+#include <string>
+
+class SerialMock;
+class SoftwareSerialFake;
+class SerialCapture;
+
+/**
+  Capture file format, all integers little-endian:
+
+  header:  "AMSR", uint8_t version (1), 3 reserved bytes
+  records: varint  microseconds since the previous record (the first
+                   record counts from 0)
+           uint8_t direction, 0 for RX (sent to the device) or 1 for TX
+                   (sent by the device)
+           varint  payload length
+           payload bytes
+
+  Varints are LEB128: 7 bits per byte, least significant group first, the
+  high bit set on every byte but the last.
+*/
+enum SerialDirection {
+  SERIAL_RX = 0,
+  SERIAL_TX = 1
+};
+
+struct SerialRecord {
+  uint64_t micros;
+  SerialDirection direction;
+  const uint8_t* data;
+  size_t length;
+};
+
+/**
+  \class SerialReplayWriter
+  \brief Writes a capture file, e.g. from a logging proxy on a field unit
+*/
+class SerialReplayWriter {
+
+  public:
+    explicit SerialReplayWriter(const char* path);
+    ~SerialReplayWriter();
+
+    bool isOpen() const {
+      return file != NULL;
+    }
+
+    /**
+      \param micros Time of the record; earlier than the previous record is
+             taken as the same time
+    */
+    void record(uint64_t micros, SerialDirection direction,
+                const uint8_t* data, size_t length);
+    /**
+      \return false if any write failed
+    */
+    bool close();
+
+  private:
+    SerialReplayWriter(const SerialReplayWriter&);
+    SerialReplayWriter& operator=(const SerialReplayWriter&);
+
+    void writeVarint(uint64_t value);
+
+    FILE* file;
+    uint64_t lastMicros;
+    bool failed;
+};
+
+/**
+  \class SerialReplay
+  \brief Plays a capture file back into a serial fake on the virtual clock
+         and compares what the sketch sends with the recorded TX traffic.
+
+  The file is memory mapped and walked record by record; only the next RX
+  record is ever scheduled, so captures of any size replay in constant
+  memory.
+
+  start() feeds every RX payload to the receiver at its recorded time,
+  shifted so that the first record plays at the virtual time of the start()
+  call. The ArduinoMock clock must exist.
+
+  TX bytes the sketch sends are passed to transmitted(), or compared in one
+  go with diffTx(capture) afterwards. diffTx() describes the first
+  difference from the recorded TX stream, or returns an empty string.
+
+  Example usage:
+
+  SerialReplay replay("field-unit-17.amsr");
+  SerialCapture* capture = serialCaptureInstance();
+  replay.start(*serialMockInstance());
+  SketchRunner().runFor(replay.getDurationMicros() / 1000 + 100);
+  EXPECT_EQ("", replay.diffTx(*capture));
+*/
+class SerialReplay {
+
+  public:
+    typedef std::function<void(const uint8_t*, size_t)> Receiver;
+
+    explicit SerialReplay(const char* path);
+    ~SerialReplay();
+
+    /**
+      \brief false if the file could not be mapped or is not a capture
+    */
+    bool isOpen() const;
+
+    /**
+      \brief Time from the first to the last record. Walks the whole file.
+    */
+    uint64_t getDurationMicros() const;
+
+    void start(Receiver receiver);
+    void start(SerialMock& mock);
+    void start(SoftwareSerialFake& fake);
+    /**
+      \brief true once every RX record has been fed
+    */
+    bool isDone() const;
+
+    /**
+      \brief Compare bytes the sketch sent with the recorded TX stream
+    */
+    void transmitted(const uint8_t* data, size_t length);
+    /**
+      \return Description of the first difference between everything passed
+              to transmitted() and the recorded TX stream, including missing
+              or extra bytes at the end; empty if they match
+    */
+    std::string diffTx() const;
+    /**
+      \brief Compare the whole of capture, from the start, instead
+    */
+    std::string diffTx(const SerialCapture& capture) const;
+
+  private:
+    SerialReplay(const SerialReplay&);
+    SerialReplay& operator=(const SerialReplay&);
+
+    // The mapping and the playback position; scheduled callbacks only hold
+    // a weak reference, so destroying the replay cancels them.
+    struct State;
+    struct Cursor {
+      size_t offset;
+      uint64_t micros;
+    };
+    struct TxCheck {
+      Cursor cursor;
+      SerialRecord record;
+      size_t position;   // within record
+      uint64_t compared;
+      bool mismatch;
+      uint64_t mismatchOffset;
+      uint64_t mismatchMicros;
+      uint8_t expected;
+      uint8_t actual;
+      uint64_t extra;
+    };
+
+    static bool next(const State& state, Cursor& cursor, SerialRecord& record);
+    static void scheduleRx(const std::shared_ptr<State>& state);
+    static void play(const std::weak_ptr<State>& weak);
+    bool nextTx(TxCheck& check) const;
+    void resetTx(TxCheck& check) const;
+    void compare(TxCheck& check, const uint8_t* data, size_t length) const;
+    std::string describe(const TxCheck& check) const;
+
+    std::shared_ptr<State> state;
+    TxCheck tx;
+};
+
+#endif // SERIAL_REPLAY_H
@@ -0,0 +1,115 @@
+/**
+ * setup()/loop() runner for host soak tests
+ */
+#ifndef SKETCH_RUNNER_H
+#define SKETCH_RUNNER_H
+
+#include <stdint.h>
+#include <functional>
+#include <ostream>
+#include <vector>
+
+#include "Arduino.h"
+
+/**
+  \brief One loop() iteration, as reported in SketchStats::slowest
+*/
+struct SketchIteration {
+  uint64_t index;          // 0 for the first loop() call
+  uint64_t wallNanos;      // wall time spent in loop()
+  uint64_t startMicros;    // virtual time when loop() was called
+};
+
+/**
+  \brief Throughput report of a SketchRunner run
+*/
+struct SketchStats {
+  uint64_t loops;
+  double wallSeconds;
+  uint64_t virtualMicros;
+  double loopsPerSecond;      // loop() calls per wall-clock second
+  double virtualPerWall;      // virtual seconds simulated per wall second
+  std::vector<SketchIteration> slowest;  // slowest first
+
+  void print(std::ostream& out) const;
+};
+
+std::ostream& operator<<(std::ostream& out, const SketchStats& stats);
+
+/**
+  \class SketchRunner
+  \brief Drives a sketch the way the Arduino core does: setup() once, then
+         loop() over and over, while measuring loop throughput.
+
+  setup() runs on the first call to any of the run methods. Each run method
+  returns the statistics of that run only. Virtual time is read from the
+  current ArduinoMock; runFor() needs one to exist.
+
+  Example usage:
+
+  ArduinoMock* arduinoMock = arduinoMockInstance();
+  SketchRunner runner;                 // the sketch's ::setup and ::loop
+  SketchStats stats = runner.runFor(60 * 60 * 1000);
+  std::cout << stats;
+*/
+class SketchRunner {
+
+  public:
+    typedef void (*Function)(void);
+    typedef std::function<bool()> Predicate;
+
+    SketchRunner()
+      : setupFunction(&::setup), loopFunction(&::loop), setupDone(false),
+        slowestCount(10), idleMicros(0) {
+    }
+    SketchRunner(Function setup_, Function loop_)
+      : setupFunction(setup_), loopFunction(loop_), setupDone(false),
+        slowestCount(10), idleMicros(0) {
+    }
+
+    /**
+      \brief Call loop() iterations times
+    */
+    SketchStats runLoops(uint64_t iterations);
+
+    /**
+      \brief Call loop() until milliseconds of virtual time have passed.
+             When an iteration leaves the clock where it was and no idle
+             time is set, the clock skips to the next scheduled event (or
+             the deadline), so idle sketches cannot stall the run.
+    */
+    SketchStats runFor(time_t milliseconds);
+
+    /**
+      \brief Call loop() until predicate returns true, checked before every
+             iteration, or until maxIterations calls
+    */
+    SketchStats runUntil(Predicate predicate, uint64_t maxIterations = UINT64_MAX);
+
+    /**
+      \brief Number of slowest iterations kept in the report, default 10
+    */
+    void setSlowestCount(size_t count) {
+      slowestCount = count;
+    }
+
+    /**
+      \brief Virtual time added after every loop() call, default 0. Models
+             the time the core spends between iterations.
+    */
+    void setIdleMicros(uint64_t microseconds) {
+      idleMicros = microseconds;
+    }
+
+  private:
+    SketchStats run(const Predicate& done, uint64_t maxIterations,
+                    bool skipIdle, uint64_t deadline);
+
+    Function setupFunction;
+    Function loopFunction;
+    bool setupDone;
+    size_t slowestCount;
+    uint64_t idleMicros;
+};
+
+#endif // SKETCH_RUNNER_H
@@ -7,6 +7,8 @@
 #ifndef SOFTWARE_SERIAL_H
 #define SOFTWARE_SERIAL_H
 
+#include <memory>
+#include <vector>
 #include <gmock/gmock.h>
 using ::testing::_;
 using ::testing::Invoke;
@@ -44,6 +46,23 @@ class SoftwareSerial : public Serial_ {
 
 };
 
+class SoftwareSerialFake;
+
+/**
+  \brief The SoftwareSerialFake instances of a MockContext and which of them
+         is listening. Owned jointly by the context and its fakes, so a fake
+         may outlive the context it was created in.
+*/
+class SoftwareSerialRegistry {
+
+  public:
+    SoftwareSerialRegistry() : listener(NULL), previous(NULL) {}
+
+    std::vector<SoftwareSerialFake*> instances;
+    SoftwareSerialFake* listener;
+    SoftwareSerialFake* previous;  // for restore_listener()
+};
+
 /**
   \class SoftwareSerialFake
   \brief Fake implementation of the serial interface, capable of simulating RX
@@ -51,33 +70,105 @@ class SoftwareSerial : public Serial_ {
   The class implements an internal buffer, where the user can pre-load the data that the fake will
   serve on subsequent calls to related methods: available, read and operator [].
 
-  Limitations:
-  - Buffer size is fixed, see private const buffer_size
-  - It is not a ringbuffer: subsequent calls to buffer_load will override contents of the buffer.
+  The buffer is a RingBuffer that grows as needed: buffer_load replaces its contents, feed appends
+  to them. available() saturates at 255 like its uint8_t return type.
+
+  Like the real library, only one instance receives at a time. Every fake registers itself in the
+  current MockContext and, like an instance before begin(), does not listen yet; begin() or listen()
+  takes over reception, and bytes fed to an instance that is not listening are lost and counted by
+  getDropped().
+  With setRxBufferSize(ss_max_rx_buff), bytes that find the RX buffer full are lost as well, set the
+  flag overflow() returns and are counted by getOverflowed(). buffer_load bypasses both checks.
+
+  Unlike the AVR library, which shares one RX buffer between all instances, each fake keeps its own,
+  so bytes received before another instance took over stay readable.
+
+  Example usage:
+
+  SoftwareSerialFake gps, co2, pm;
+  gps.begin(9600);
+  co2.feed(reading, sizeof(reading));  // lost, gps is listening
+  EXPECT_EQ(sizeof(reading), co2.getDropped());
 */
 class SoftwareSerialFake : public SoftwareSerial {
 
   public:
+    /**
+      \brief _SS_MAX_RX_BUFF of the AVR library
+    */
+    static const size_t ss_max_rx_buff = 64;
+
+    SoftwareSerialFake();
+    ~SoftwareSerialFake();
 
     /**
       \brief Load user specified data into SoftwareSerialFake buffer
       \param buffer User buffer to copy the data from
       \param len Length of the user buffer
     */
-    void buffer_load(const uint8_t buffer_0[], const uint8_t len);
+    void buffer_load(const uint8_t buffer_0[], const size_t len);
+
+    /**
+      \brief Append user specified data to the SoftwareSerialFake buffer, as if it arrived on the
+             RX pin
+    */
+    void feed(const uint8_t data[], const size_t len);
 
     /**
       \brief Fake methods to operate with the RX buffer
     */
     uint8_t available();
     uint8_t read();
+    size_t read(uint8_t buffer_0[], const size_t len);
     uint8_t at(const uint8_t index);
 
+    /**
+      \brief Fake methods for listen arbitration. listen() returns true if it
+             took over from another instance; begin() listens, end() stops;
+             overflow() returns and clears the overflow flag;
+             restore_listener() hands back to the instance this one took over
+             from.
+    */
+    uint8_t begin(uint32_t baud);
+    void end();
+    bool listen();
+    bool isListening();
+    bool stopListening();
+    bool overflow();
+    void restore_listener();
+
+    /**
+      \brief Capacity of the RX buffer for fed bytes, 0 (the default) for unlimited
+    */
+    void setRxBufferSize(size_t size);
+    /**
+      \brief Bytes fed while another instance was listening
+    */
+    size_t getDropped() const {
+      return dropped;
+    }
+    /**
+      \brief Bytes fed while the RX buffer was full
+    */
+    size_t getOverflowed() const {
+      return overflowed;
+    }
+
+    /**
+      \brief The listening instance of the current MockContext, or NULL
+    */
+    static SoftwareSerialFake* getListener();
+
   private:
-    static const uint8_t buffer_size = 128;
-    uint8_t buffer[buffer_size] = {0};
-    uint8_t buffer_head = 0;
-    uint8_t buffer_tail = 0;
+    SoftwareSerialFake(const SoftwareSerialFake&);
+    SoftwareSerialFake& operator=(const SoftwareSerialFake&);
+
+    std::shared_ptr<SoftwareSerialRegistry> registry;
+    RingBuffer rx;
+    size_t rxLimit;
+    bool overflowFlag;
+    size_t dropped;
+    size_t overflowed;
 };
 
 /**
@@ -127,7 +218,7 @@ class SoftwareSerialMock : public SoftwareSerial {
       \param ignore_calls Flag to set the mock to expect and ignore all calls on
              methods related to the buffer (available, read and operator [])
     */
-    void mock_buffer_load(const uint8_t buffer[], const uint8_t len, bool ignore_calls = true) {
+    void mock_buffer_load(const uint8_t buffer[], const size_t len, bool ignore_calls = true) {
         fake_.buffer_load(buffer, len);
         if (ignore_calls) {
             EXPECT_CALL(*this, available())
@@ -138,23 +229,51 @@ class SoftwareSerialMock : public SoftwareSerial {
                 .WillRepeatedly(DoDefault());
         }
     }
-    void mock_buffer_load(const char buffer[], const uint8_t len, bool ignore_calls = true) {
+    void mock_buffer_load(const char buffer[], const size_t len, bool ignore_calls = true) {
         mock_buffer_load((const uint8_t*)buffer, len, ignore_calls);
     }
 
+    /**
+      \brief Append to the fake RX buffer without touching its contents
+    */
+    void mock_buffer_feed(const uint8_t buffer[], const size_t len) {
+        fake_.feed(buffer, len);
+    }
+
     /**
       \brief Constructor. Sets default mock actions for available, read and operator [],
-             to be redirected to SoftwareSerialFake
+             and for begin, end and the listen methods, to be redirected to SoftwareSerialFake
     */
     SoftwareSerialMock() {
+        ON_CALL(*this, begin(_))
+            .WillByDefault(Invoke(&fake_, &SoftwareSerialFake::begin));
+        ON_CALL(*this, end())
+            .WillByDefault(Invoke(&fake_, &SoftwareSerialFake::end));
+        ON_CALL(*this, listen())
+            .WillByDefault(Invoke(&fake_, &SoftwareSerialFake::listen));
+        ON_CALL(*this, isListening())
+            .WillByDefault(Invoke(&fake_, &SoftwareSerialFake::isListening));
+        ON_CALL(*this, stopListening())
+            .WillByDefault(Invoke(&fake_, &SoftwareSerialFake::stopListening));
+        ON_CALL(*this, overflow())
+            .WillByDefault(Invoke(&fake_, &SoftwareSerialFake::overflow));
+        ON_CALL(*this, restore_listener())
+            .WillByDefault(Invoke(&fake_, &SoftwareSerialFake::restore_listener));
         ON_CALL(*this, available())
             .WillByDefault(Invoke(&fake_, &SoftwareSerialFake::available));
         ON_CALL(*this, read())
-            .WillByDefault(Invoke(&fake_, &SoftwareSerialFake::read));
+            .WillByDefault(Invoke(&fake_, static_cast<uint8_t (SoftwareSerialFake::*)()>(&SoftwareSerialFake::read)));
         ON_CALL(*this, at(_))
             .WillByDefault(Invoke(&fake_, &SoftwareSerialFake::at));
     }
 
+    /**
+      \brief The fake behind the default actions, e.g. for its loss counters
+    */
+    SoftwareSerialFake& getFake() {
+        return fake_;
+    }
+
   private:
     SoftwareSerialFake fake_;  // Keeps an instance of the fake in the mock.
 };
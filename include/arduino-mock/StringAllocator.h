@@ -0,0 +1,183 @@
+/**
+ * Pluggable allocators for the heap buffers of String
+ */
+#ifndef STRING_ALLOCATOR_H
+#define STRING_ALLOCATOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+/**
+  \class StringAllocator
+  \brief Where String takes its buffers from once a string outgrows SSO
+
+  String passes the size of every buffer it gives back, so allocators need
+  no per-block header. The counters cover every call, whatever the
+  allocator does, so tests can assert how often a piece of code allocates.
+
+  The allocator is a setting of the current MockContext, see
+  setStringAllocator(). A buffer must go back to the allocator it came
+  from: only switch allocators while no String holds a heap buffer.
+
+  String does not remember the allocator of its buffer, it always asks the
+  current context. The default allocator is per thread like the default
+  context, so a String that grew on one thread and is destroyed on another
+  frees its malloc() buffer correctly, but counts the allocation on the
+  first thread and the release on the second. To hand Strings between
+  threads, set the same allocator in the contexts of both; it is not
+  synchronized, so the threads must not use it at the same time.
+*/
+class StringAllocator {
+
+  public:
+    StringAllocator();
+    virtual ~StringAllocator() {}
+
+    /**
+      \brief Like realloc(): ptr is NULL or a buffer of oldSize bytes from
+             this allocator, whose first min(oldSize, newSize) bytes move
+             to the result
+      \return NULL if out of memory; ptr then stays valid
+    */
+    void* reallocate(void* ptr, size_t oldSize, size_t newSize);
+    void release(void* ptr, size_t size);
+
+    /**
+      \brief reallocate() calls that returned a buffer
+    */
+    size_t getAllocations() const {
+      return allocations;
+    }
+    size_t getReleases() const {
+      return releases;
+    }
+    size_t getBytesInUse() const {
+      return bytesInUse;
+    }
+    void resetCounters();
+
+  protected:
+    virtual void* doReallocate(void* ptr, size_t oldSize, size_t newSize) = 0;
+    virtual void doRelease(void* ptr, size_t size) = 0;
+
+  private:
+    size_t allocations;
+    size_t releases;
+    size_t bytesInUse;
+};
+
+/**
+  \brief realloc() and free(), what String uses unless told otherwise.
+         A buffer that came from an EspHeap, e.g. a String that outlived
+         setEspHeap(NULL), goes back to that heap, see espHeapFree().
+*/
+class MallocStringAllocator : public StringAllocator {
+
+  protected:
+    void* doReallocate(void* ptr, size_t oldSize, size_t newSize);
+    void doRelease(void* ptr, size_t size);
+};
+
+/**
+  \class PoolStringAllocator
+  \brief Free lists of power-of-two size classes from 16 to max_class
+         bytes, carved out of page_size pages. Growing within a class keeps
+         the buffer; bigger buffers come from malloc(). Pages are only
+         returned on destruction.
+*/
+class PoolStringAllocator : public StringAllocator {
+
+  public:
+    static const size_t min_class = 16;
+    static const size_t max_class = 1024;
+    static const size_t page_size = 16384;
+
+    PoolStringAllocator();
+    ~PoolStringAllocator();
+
+  protected:
+    void* doReallocate(void* ptr, size_t oldSize, size_t newSize);
+    void doRelease(void* ptr, size_t size);
+
+  private:
+    PoolStringAllocator(const PoolStringAllocator&);
+    PoolStringAllocator& operator=(const PoolStringAllocator&);
+
+    static const size_t class_count = 7;  // 16 .. 1024
+
+    struct FreeBlock {
+      FreeBlock* next;
+    };
+
+    // class_count for sizes beyond max_class
+    static size_t classOf(size_t size);
+    void* allocate(size_t size);
+    void deallocate(void* ptr, size_t size);
+
+    FreeBlock* freeLists[class_count];
+    std::vector<char*> pages;
+    size_t pageUsed;
+};
+
+/**
+  \class ArenaStringAllocator
+  \brief Bump allocator over chunk_size chunks. release() only gives
+         memory back when it is the most recent buffer, which also lets the
+         most recent buffer grow in place. reset() makes all chunks free
+         again in O(1), e.g. between test cases, and invalidates every
+         buffer handed out before.
+
+  Example usage:
+
+  ArenaStringAllocator arena;
+  StringAllocator* previous = setStringAllocator(&arena);
+  runJsonBuilderCase();   // no String may outlive the case
+  EXPECT_EQ(3U, arena.getAllocations());
+  arena.reset();
+  setStringAllocator(previous);
+*/
+class ArenaStringAllocator : public StringAllocator {
+
+  public:
+    static const size_t default_chunk_size = 65536;
+
+    explicit ArenaStringAllocator(size_t chunkSize = default_chunk_size);
+    ~ArenaStringAllocator();
+
+    void reset();
+
+  protected:
+    void* doReallocate(void* ptr, size_t oldSize, size_t newSize);
+    void doRelease(void* ptr, size_t size);
+
+  private:
+    ArenaStringAllocator(const ArenaStringAllocator&);
+    ArenaStringAllocator& operator=(const ArenaStringAllocator&);
+
+    struct Chunk {
+      char* data;
+      size_t size;
+    };
+
+    void* allocate(size_t size);
+
+    const size_t chunkSize;
+    std::vector<Chunk> chunks;
+    size_t current;  // index into chunks
+    size_t used;     // bytes used in chunks[current]
+    char* last;      // most recent buffer, NULL if released
+};
+
+/**
+  \brief The current MockContext's allocator, MallocStringAllocator unless
+         one was set
+*/
+StringAllocator& stringAllocator();
+/**
+  \param allocator Allocator to use, not owned; NULL for malloc()
+  \return The previous allocator, NULL if it was the default
+*/
+StringAllocator* setStringAllocator(StringAllocator* allocator);
+
+#endif // STRING_ALLOCATOR_H
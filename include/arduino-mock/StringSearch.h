@@ -0,0 +1,50 @@
+/**
+ * Length-bounded search and ASCII case folding kernels for String
+ */
+#ifndef STRING_SEARCH_H
+#define STRING_SEARCH_H
+
+#include <stddef.h>
+
+/**
+  All functions take explicit lengths and never look for a terminating
+  NUL, so they also work on buffers with embedded NULs. They use SSE2, or
+  AVX2 when the build enables it (e.g. -mavx2), and plain C++ elsewhere.
+
+  Case folding only maps the ASCII letters, like tolower() and toupper()
+  in the "C" locale.
+*/
+
+/**
+  \return The first occurrence of c in s[0, length), NULL if none
+*/
+const char* stringFindChar(const char* s, size_t length, char c);
+/**
+  \return The last occurrence of c in s[0, length), NULL if none
+*/
+const char* stringFindLastChar(const char* s, size_t length, char c);
+/**
+  \brief Substring search in linear time: candidates are filtered on the
+         first and last byte of the needle a block at a time; if that keeps
+         producing false candidates, the rest of the haystack is searched
+         with the Two-Way algorithm.
+  \return The first occurrence of needle, fully inside haystack[0, length);
+          haystack for an empty needle; NULL if none
+*/
+const char* stringFind(const char* haystack, size_t length,
+                       const char* needle, size_t needleLength);
+/**
+  \brief The reverse of stringFind: the same block filter runs from the end
+         of the haystack, and the Two-Way algorithm on the reversed needle
+         and haystack takes over from it.
+  \return The last occurrence of needle, fully inside haystack[0, length);
+          haystack + length for an empty needle; NULL if none
+*/
+const char* stringFindLast(const char* haystack, size_t length,
+                           const char* needle, size_t needleLength);
+
+bool stringEqualsIgnoreCase(const char* a, const char* b, size_t length);
+void stringToLower(char* s, size_t length);
+void stringToUpper(char* s, size_t length);
+
+#endif // STRING_SEARCH_H
@@ -7,7 +7,8 @@
 
 #include <stdint.h>
 #include <string>
-#include <sstream>
+
+#include "SerialCapture.h"
 
 /*
  * stringCapture
@@ -21,6 +22,8 @@
  *       .Times(AtLeast(1))
  *       .WillRepeatedly(Invoke(&c, &stringCapture::captureCStr));
  *
+ * To capture Serial output without setting up expectations at all, use
+ * serialCaptureInstance() from SerialCapture.h.
  */
 class stringCapture {
   public:
@@ -30,9 +33,13 @@ class stringCapture {
     bool captureCStr(const uint8_t *buffer, size_t size);
     void clear();
     std::string get();
+    /**
+     * The captured data in place, split into lines
+     */
+    std::vector<CaptureView> lines() const;
 
   private:
-    std::stringstream d;
+    SerialCapture d;
 };
 
 
@@ -141,9 +141,9 @@ public:
         }
         _connect_pending = true;
         _op_start_time = millis();
-        for (decltype(_timeout_ms) i = 0; _connect_pending && i < _timeout_ms; i++) {
-               // Give scheduled functions a chance to run (e.g. Ethernet uses recurrent)
-               delay(1);
+        while (_connect_pending && millis() - _op_start_time < _timeout_ms) {
+               // Skip ahead to the next scheduled event rather than stepping 1ms at a time
+               delayUntilEvent(_timeout_ms - (millis() - _op_start_time));
                // will resume on timeout or when _connected or _notify_error fires
         }
         _connect_pending = false;
@@ -300,6 +300,36 @@ public:
         return copy_size;
     }
 
+    // bytes left in the current pbuf, the part of the receive buffer that
+    // peekBuffer() can hand out without copying
+    size_t peekAvailable() const
+    {
+        if(!_rx_buf) {
+            return 0;
+        }
+
+        return _rx_buf->len - _rx_buf_offset;
+    }
+
+    const char* peekBuffer() const
+    {
+        if(!_rx_buf) {
+            return nullptr;
+        }
+
+        return reinterpret_cast<const char*>(_rx_buf->payload) + _rx_buf_offset;
+    }
+
+    void peekConsume(size_t consume)
+    {
+        if(!_rx_buf || !consume) {
+            return;
+        }
+
+        size_t max_size = _rx_buf->len - _rx_buf_offset;
+        _consume((consume < max_size) ? consume : max_size);
+    }
+
     void discard_received()
     {
         DEBUGV(":dsrcv %d\n", _rx_buf? _rx_buf->tot_len: 0);
@@ -474,11 +504,11 @@ protected:
             }
 
             _send_waiting = true;
-            for (decltype(_timeout_ms) i = 0; _send_waiting && i < _timeout_ms; i++) {
-               // Give scheduled functions a chance to run (e.g. Ethernet uses recurrent)
-               delay(1);
+            const uint32_t send_start_time = millis();
+            while (_send_waiting && millis() - send_start_time < _timeout_ms) {
+               // Skip ahead to the next scheduled event rather than stepping 1ms at a time
+               delayUntilEvent(_timeout_ms - (millis() - send_start_time));
                // will resume on timeout or when _write_some_from_cb or _notify_error fires
-
             }
             _send_waiting = false;
         } while(true);
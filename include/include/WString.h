@@ -26,7 +26,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
-//#include <pgmspace.h>
+#include <initializer_list>
+#include "pgmspace.h"
 
 // An inherited class for holding the result of a concatenation.  These
 // result objects are assumed to be writable by subsequent concatenations.
@@ -36,7 +37,16 @@ class StringSumHelper;
 // but really has no body
 class __FlashStringHelper;
 #define FPSTR(pstr_pointer) (reinterpret_cast<const __FlashStringHelper *>(pstr_pointer))
+// the mock Arduino.h has its own F(), for Serial.print() and friends
+#ifndef F
 #define F(string_literal) (FPSTR(PSTR(string_literal)))
+#endif
+
+// One find/replace pair for String::replaceAll()
+struct StringReplacement {
+        const char *find;
+        const char *replace;
+};
 
 // The string class
 class String {
@@ -118,6 +128,20 @@ class String {
         unsigned char concat(const __FlashStringHelper * str);
         unsigned char concat(const char *cstr, unsigned int length);
 
+        // concatenates all arguments with a single allocation: the lengths
+        // are added up first, then numbers are formatted straight into the
+        // reserved space, e.g. s.concatAll(topic, '/', id, F("/state"));
+        // fails like concat() if any argument cannot be appended
+        template <typename... Args>
+        unsigned char concatAll(const Args &... args) {
+            if (!reserve(len() + sumLengths(args...)))
+                return 0;
+            char *end = sumWrites(wbuffer() + len(), args...);
+            *end = 0;
+            setLen(end - buffer());
+            return 1;
+        }
+
         // if there's not enough memory for the concatenated value, the string
         // will be left unchanged (but this isn't signalled in any way)
         String & operator +=(const String &rhs) {
@@ -266,6 +290,13 @@ class String {
         void replace(const __FlashStringHelper * find, const __FlashStringHelper * replace) {
             this->replace(String(find), String(replace));
         }
+        // replaces every occurrence of any of the find strings in one pass,
+        // e.g. s.replaceAll({{"%NAME%", name}, {"%IP%", ip}}); where several
+        // match at the same position, the first one listed wins
+        void replaceAll(const StringReplacement *replacements, size_t count);
+        void replaceAll(std::initializer_list<StringReplacement> replacements) {
+            replaceAll(replacements.begin(), replacements.size());
+        }
         void remove(unsigned int index);
         void remove(unsigned int index, unsigned int count);
         void toLowerCase(void);
@@ -313,6 +344,45 @@ class String {
         void invalidate(void);
         unsigned char changeBuffer(unsigned int maxStrLen);
 
+        // concatAll() helpers. sumLength() is exact except for floating
+        // point numbers, where it is an upper bound; an argument that cannot
+        // be appended counts as longer than any String, so reserve() fails.
+        // sumWrite() returns the end of what it wrote.
+        static size_t sumLength(const String &s);
+        static size_t sumLength(const char *cstr);
+        static size_t sumLength(char c) { (void)c; return 1; }
+        static size_t sumLength(unsigned char num) { return sumDigits(num); }
+        static size_t sumLength(int num);
+        static size_t sumLength(unsigned int num) { return sumDigits(num); }
+        static size_t sumLength(long num);
+        static size_t sumLength(unsigned long num) { return sumDigits(num); }
+        static size_t sumLength(float num) { return sumLength((double)num); }
+        static size_t sumLength(double num);
+        static size_t sumLength(const __FlashStringHelper *str);
+        static size_t sumDigits(unsigned long num);
+        static char *sumWrite(char *out, const String &s);
+        static char *sumWrite(char *out, const char *cstr);
+        static char *sumWrite(char *out, char c) { *out = c; return out + 1; }
+        static char *sumWrite(char *out, unsigned char num) { return sumWriteDigits(out, num); }
+        static char *sumWrite(char *out, int num) { return sumWrite(out, (long)num); }
+        static char *sumWrite(char *out, unsigned int num) { return sumWriteDigits(out, num); }
+        static char *sumWrite(char *out, long num);
+        static char *sumWrite(char *out, unsigned long num) { return sumWriteDigits(out, num); }
+        static char *sumWrite(char *out, float num) { return sumWrite(out, (double)num); }
+        static char *sumWrite(char *out, double num);
+        static char *sumWrite(char *out, const __FlashStringHelper *str);
+        static char *sumWriteDigits(char *out, unsigned long num);
+        static size_t sumLengths() { return 0; }
+        template <typename T, typename... Rest>
+        static size_t sumLengths(const T &first, const Rest &... rest) {
+            return sumLength(first) + sumLengths(rest...);
+        }
+        static char *sumWrites(char *out) { return out; }
+        template <typename T, typename... Rest>
+        static char *sumWrites(char *out, const T &first, const Rest &... rest) {
+            return sumWrites(sumWrite(out, first), rest...);
+        }
+
         // copy and move
         String & copy(const char *cstr, unsigned int length);
         String & copy(const __FlashStringHelper *pstr, unsigned int length);
@@ -321,6 +391,10 @@ class String {
 #endif
 };
 
+// The result of a + b + ... . It is a String and is read as one between
+// the operators, e.g. when bound to a const String&, so every operand is
+// appended when its operator+ runs; a sum cannot know its total length in
+// advance. Use String::concatAll() to build a string with one allocation.
 class StringSumHelper: public String {
     public:
         StringSumHelper(const String &s) :
@@ -353,6 +427,17 @@ class StringSumHelper: public String {
         StringSumHelper(double num) :
                 String(num) {
         }
+
+        // appends one operand of a sum without a temporary String. Like
+        // concat() on the ESP core, the buffer grows to fit the result
+        // (rounded to 16 bytes) and no further, so a sum needs no more heap
+        // than on the device.
+        template <typename T>
+        StringSumHelper & append(const T &operand) {
+            if (!concatAll(operand))
+                invalidate();
+            return *this;
+        }
 };
 
 extern const String emptyString;
@@ -0,0 +1,32 @@
+/**
+ * Host stand-in for the ESP8266 pgmspace.h. Flash and RAM are one address
+ * space here, so PROGMEM is empty and the _P functions are their RAM
+ * counterparts.
+ */
+#ifndef PGMSPACE_H
+#define PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P const char *
+#define PGM_VOID_P const void *
+#define PSTR(s) (s)
+
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+
+#define memcpy_P memcpy
+#define memmove_P memmove
+#define memcmp_P memcmp
+#define strlen_P strlen
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define strcasecmp_P strcasecmp
+#define strstr_P strstr
+
+#endif // PGMSPACE_H
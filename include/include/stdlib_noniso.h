@@ -0,0 +1,30 @@
+/**
+ * The non-ISO conversions of the ESP8266 core's stdlib_noniso.h, see
+ * src/stdlib_noniso.cc
+ */
+#ifndef STDLIB_NONISO_H
+#define STDLIB_NONISO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+char* itoa(int val, char *s, int radix);
+char* ltoa(long val, char *s, int radix);
+char* utoa(unsigned int val, char *s, int radix);
+char* ultoa(unsigned long val, char *s, int radix);
+
+/**
+  \brief val with prec decimals, right aligned to width characters (left
+         aligned for a negative width), like "%*.*f". s must hold the whole
+         integer part: up to 309 digits, plus sign, point, decimals and NUL.
+*/
+char* dtostrf(double val, signed char width, unsigned char prec, char *s);
+
+void reverse(char* begin, char* end);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // STDLIB_NONISO_H
@@ -0,0 +1,161 @@
+#include "arduino-mock/AnalogSource.h"
+
+#include <math.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int ConstantSource::sample(uint64_t micros) {
+  (void)micros;
+  return value;
+}
+
+SineSource::SineSource(int offset, int amplitude, double frequency,
+                       double phase)
+  : offset(offset), amplitude(amplitude),
+    radiansPerMicro(2 * 3.14159265358979323846 * frequency / 1e6),
+    phase(phase) {
+}
+
+int SineSource::sample(uint64_t micros) {
+  return offset + (int)lround(amplitude * sin(radiansPerMicro * micros + phase));
+}
+
+SquareSource::SquareSource(int low, int high, uint64_t periodMicros,
+                           double duty)
+  : low(low), high(high), periodMicros(periodMicros ? periodMicros : 1),
+    highMicros((uint64_t)(this->periodMicros * duty)) {
+}
+
+int SquareSource::sample(uint64_t micros) {
+  return micros % periodMicros < highMicros ? high : low;
+}
+
+NoiseSource::NoiseSource(int mean, int amplitude, uint32_t seed)
+  : mean(mean), amplitude(amplitude < 0 ? 0 : amplitude), seed(seed) {
+}
+
+int NoiseSource::sample(uint64_t micros) {
+  // splitmix64 finalizer
+  uint64_t x = micros + seed * 0x9e3779b97f4a7c15ull;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  x ^= x >> 31;
+  const uint64_t span = 2 * (uint64_t)amplitude + 1;
+  return mean - amplitude + (int)(x % span);
+}
+
+SampleFileSource::SampleFileSource(const char* path, Format format,
+                                   uint64_t intervalMicros,
+                                   uint64_t startMicros, bool loop,
+                                   int column)
+  : data(NULL), length(0), format(format),
+    intervalMicros(intervalMicros ? intervalMicros : 1),
+    startMicros(startMicros), loop(loop), column(column),
+    count(0), csvIndex(0), csvOffset(0), csvValue(0) {
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    void* mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped != MAP_FAILED) {
+      data = (const char*)mapped;
+      length = st.st_size;
+      madvise(mapped, length, MADV_SEQUENTIAL);
+    }
+  }
+  close(fd);
+  if (!data) {
+    return;
+  }
+
+  if (format == CSV) {
+    int value;
+    while (nextCsvLine(value)) {
+      count++;
+    }
+    csvOffset = 0;
+  } else {
+    count = length / 2;
+  }
+}
+
+SampleFileSource::~SampleFileSource() {
+  if (data) {
+    munmap((void*)data, length);
+  }
+}
+
+int SampleFileSource::sample(uint64_t micros) {
+  if (count == 0) {
+    return 0;
+  }
+  uint64_t index = micros < startMicros ? 0 : (micros - startMicros) / intervalMicros;
+  if (index >= count) {
+    index = loop ? index % count : count - 1;
+  }
+  return format == CSV ? csvSample(index) : rawSample(index);
+}
+
+int SampleFileSource::rawSample(uint64_t index) const {
+  const unsigned char* bytes = (const unsigned char*)data + 2 * index;
+  const uint16_t raw = bytes[0] | (bytes[1] << 8);
+  return format == RAW_INT16 ? (int)(int16_t)raw : (int)raw;
+}
+
+int SampleFileSource::csvSample(uint64_t index) {
+  if (csvIndex > 0 && index == csvIndex - 1) {
+    return csvValue;
+  }
+  if (index < csvIndex) {
+    csvIndex = 0;
+    csvOffset = 0;
+  }
+  int value = csvValue;
+  while (csvIndex <= index && nextCsvLine(value)) {
+    csvIndex++;
+  }
+  csvValue = value;
+  return value;
+}
+
+// Reads the line at csvOffset and moves past it. The mapping is not NUL
+// terminated, so the line is parsed by hand within its bounds.
+bool SampleFileSource::nextCsvLine(int& value) {
+  while (csvOffset < length) {
+    const char* line = data + csvOffset;
+    const char* newline = (const char*)memchr(line, '\n', length - csvOffset);
+    const char* end = newline ? newline : data + length;
+    csvOffset = end - data + (newline ? 1 : 0);
+
+    const char* p = line;
+    for (int skip = column; skip > 0 && p < end; p++) {
+      if (*p == ',') {
+        skip--;
+      }
+    }
+    while (p < end && (*p == ' ' || *p == '\t')) {
+      p++;
+    }
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+      negative = *p == '-';
+      p++;
+    }
+    if (p == end || *p < '0' || *p > '9') {
+      continue;
+    }
+    int parsed = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+      parsed = parsed * 10 + (*p - '0');
+      p++;
+    }
+    value = negative ? -parsed : parsed;
+    return true;
+  }
+  return false;
+}
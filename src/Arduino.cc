@@ -1,45 +1,263 @@
 #include "arduino-mock/Arduino.h"
-#include <ctime>
- #define SECS_YR_2000  ((time_t)(946684800UL)) // the time at the start of y2k
+#include "arduino-mock/MockContext.h"
+#include "arduino-mock/PinTrace.h"
 
-static ArduinoMock* arduinoMock = NULL;
+// The mock lives in the calling thread's context, see MockContext.h
+static inline ArduinoMock*& arduinoMock() {
+  return currentMockContext().arduino;
+}
 ArduinoMock* arduinoMockInstance() {
-  if(!arduinoMock) {
-    arduinoMock = new ArduinoMock();
+  if(!arduinoMock()) {
+    arduinoMock() = new ArduinoMock();
   }
-  return arduinoMock;
+  return arduinoMock();
 }
 
 void releaseArduinoMock() {
-  if(arduinoMock) {
-    delete arduinoMock;
-    arduinoMock = NULL;
+  if(arduinoMock()) {
+    delete arduinoMock();
+    arduinoMock() = NULL;
   }
 }
 
+// The virtual clock starts at zero so that every run of a test sees the
+// same timestamps, independent of the wall clock.
 ArduinoMock::ArduinoMock() {
-  currentMillis = 0;
-  const time_t sysTime = time(0) - SECS_YR_2000;
-  setMillisRaw(sysTime*1000);
+  currentMicros = 0;
+  yieldMicros = 1000;
+  shiftEdgeMicros = 1;
+  pinPollMicros = 10;
+}
+
+void ArduinoMock::advanceTo(uint64_t microseconds) {
+  uint64_t when;
+  VirtualScheduler::Callback callback;
+  while (scheduler.popDue(microseconds, when, callback)) {
+    // A callback may itself have advanced the clock; never move it back.
+    if (when > currentMicros) {
+      currentMicros = when;
+    }
+    callback();
+  }
+  if (microseconds > currentMicros) {
+    currentMicros = microseconds;
+  }
+  scheduler.advance(currentMicros);
+}
+
+bool ArduinoMock::advanceToNextEvent(uint64_t maxMicroseconds) {
+  const uint64_t deadline = currentMicros + maxMicroseconds;
+  const uint64_t next = scheduler.nextEventTime();
+  if (next > deadline) {
+    advanceTo(deadline);
+    return false;
+  }
+  advanceTo(next > currentMicros ? next : currentMicros);
+  return true;
+}
+
+static inline ArduinoFake*& arduinoFake() {
+  return currentMockContext().arduinoFake;
+}
+ArduinoFake* arduinoFakeInstance() {
+  if(!arduinoFake()) {
+    arduinoFake() = new ArduinoFake();
+  }
+  return arduinoFake();
+}
+
+void releaseArduinoFake() {
+  if(arduinoFake()) {
+    delete arduinoFake();
+    arduinoFake() = NULL;
+  }
+}
+
+ArduinoFake::ArduinoFake()
+  : stimuli(65536) {
+  memset(pins, 0, sizeof(pins));
+  memset(analogSources, 0, sizeof(analogSources));
+}
+
+ArduinoFake::~ArduinoFake() {
+  for (int pin = 0; pin < num_pins; pin++) {
+    delete analogSources[pin];
+  }
+}
+
+int ArduinoFake::level(uint8_t pin) {
+  const PinState& state = pins[pin];
+  if (state.mode == OUTPUT) {
+    return state.level;
+  }
+  if (state.driven) {
+    return state.input;
+  }
+  return state.mode == INPUT_PULLUP ? HIGH : LOW;
+}
+
+void ArduinoFake::levelChanged(uint8_t pin, int before) {
+  const int after = level(pin);
+  if (after != before) {
+    interrupts.pinChanged(pin, after);
+  }
+}
+
+void ArduinoFake::pinMode(uint8_t pin, uint8_t mode) {
+  const int before = level(pin);
+  pins[pin].mode = mode;
+  if (interrupts.watches(pin)) {
+    levelChanged(pin, before);
+  }
+}
+
+void ArduinoFake::digitalWrite(uint8_t pin, uint8_t level) {
+  const int before = this->level(pin);
+  pins[pin].level = level ? HIGH : LOW;
+  pins[pin].writes++;
+  if (interrupts.watches(pin)) {
+    levelChanged(pin, before);
+  }
+}
+
+int ArduinoFake::digitalRead(uint8_t pin) {
+  service();
+  return level(pin);
+}
+
+int ArduinoFake::analogRead(uint8_t pin) {
+  AnalogSource* source = analogSources[pin];
+  if (source) {
+    ArduinoMock* mock = arduinoMock();
+    return source->sample(mock ? mock->getMicros64() : 0);
+  }
+  return pins[pin].analog;
+}
+
+void ArduinoFake::analogWrite(uint8_t pin, int value) {
+  pins[pin].mode = OUTPUT;
+  pins[pin].duty = value;
+  pins[pin].writes++;
+}
+
+void ArduinoFake::setDigitalInput(uint8_t pin, uint8_t level) {
+  const int before = this->level(pin);
+  pins[pin].input = level ? HIGH : LOW;
+  pins[pin].driven = true;
+  levelChanged(pin, before);
+}
+
+void ArduinoFake::releaseDigitalInput(uint8_t pin) {
+  const int before = level(pin);
+  pins[pin].driven = false;
+  levelChanged(pin, before);
+}
+
+bool ArduinoFake::injectDigitalInput(uint8_t pin, uint8_t level) {
+  return stimuli.push(pin, level);
+}
+
+void ArduinoFake::scheduleDigitalInput(uint8_t pin, uint8_t level,
+                                       uint64_t microseconds) {
+  assert (arduinoMock() != NULL);
+  ArduinoFake* fake = this;
+  arduinoMock()->scheduleAt(microseconds, [fake, pin, level]() {
+    fake->setDigitalInput(pin, level);
+  });
+}
+
+void ArduinoFake::schedulePulse(uint8_t pin, uint8_t level,
+                                uint64_t microseconds,
+                                uint64_t widthMicroseconds) {
+  scheduleDigitalInput(pin, level, microseconds);
+  scheduleDigitalInput(pin, !level, microseconds + widthMicroseconds);
+}
+
+void ArduinoFake::service() {
+  uint8_t pin;
+  uint8_t level;
+  while (stimuli.pop(pin, level)) {
+    setDigitalInput(pin, level);
+  }
+  interrupts.service();
+}
+
+void ArduinoFake::setAnalogInput(uint8_t pin, int value) {
+  setAnalogSource(pin, NULL);
+  pins[pin].analog = value;
+}
+
+void ArduinoFake::setAnalogSource(uint8_t pin, AnalogSource* source) {
+  if (source != analogSources[pin]) {
+    delete analogSources[pin];
+    analogSources[pin] = source;
+  }
+}
+
+uint8_t ArduinoFake::getPinMode(uint8_t pin) {
+  return pins[pin].mode;
+}
+
+uint8_t ArduinoFake::getDigitalOutput(uint8_t pin) {
+  return pins[pin].level;
+}
+
+int ArduinoFake::getAnalogOutput(uint8_t pin) {
+  return pins[pin].duty;
+}
+
+uint32_t ArduinoFake::getWriteCount(uint8_t pin) {
+  return pins[pin].writes;
+}
+
+static void traceCall(MockContext& context, PinTrace::Kind kind,
+                      uint8_t pin, int value) {
+  const uint64_t now = context.arduino ? context.arduino->getMicros64() : 0;
+  context.pinTrace->record(kind, pin, value, now);
 }
 
 void pinMode(uint8_t a, uint8_t b) {
-  assert (arduinoMock != NULL);
-  arduinoMock->pinMode(a, b);
+  MockContext& context = currentMockContext();
+  if (context.pinTrace) {
+    traceCall(context, PinTrace::PIN_MODE, a, b);
+  }
+  if (context.arduinoFake) {
+    context.arduinoFake->pinMode(a, b);
+    return;
+  }
+  assert (context.arduino != NULL);
+  context.arduino->pinMode(a, b);
 }
+
 void digitalWrite(uint8_t a, uint8_t b) {
-  assert (arduinoMock != NULL);
-  arduinoMock->digitalWrite(a, b);
+  MockContext& context = currentMockContext();
+  if (context.pinTrace) {
+    traceCall(context, PinTrace::DIGITAL_WRITE, a, b);
+  }
+  if (context.arduinoFake) {
+    context.arduinoFake->digitalWrite(a, b);
+    return;
+  }
+  assert (context.arduino != NULL);
+  context.arduino->digitalWrite(a, b);
 }
 
 int digitalRead(uint8_t a) {
-  assert (arduinoMock != NULL);
-  return arduinoMock->digitalRead(a);
+  MockContext& context = currentMockContext();
+  if (context.arduinoFake) {
+    return context.arduinoFake->digitalRead(a);
+  }
+  assert (context.arduino != NULL);
+  return context.arduino->digitalRead(a);
 }
 
 int analogRead(uint8_t a) {
-  assert (arduinoMock != NULL);
-  return arduinoMock->analogRead(a);
+  MockContext& context = currentMockContext();
+  if (context.arduinoFake) {
+    return context.arduinoFake->analogRead(a);
+  }
+  assert (context.arduino != NULL);
+  return context.arduino->analogRead(a);
 }
 
 void analogReference(uint8_t mode) {
@@ -47,57 +265,169 @@ void analogReference(uint8_t mode) {
 }
 
 void analogWrite(uint8_t a, int b) {
-  assert (arduinoMock != NULL);
-  arduinoMock->analogWrite(a, b);
+  MockContext& context = currentMockContext();
+  if (context.pinTrace) {
+    traceCall(context, PinTrace::ANALOG_WRITE, a, b);
+  }
+  if (context.arduinoFake) {
+    context.arduinoFake->analogWrite(a, b);
+    return;
+  }
+  assert (context.arduino != NULL);
+  context.arduino->analogWrite(a, b);
 }
 
 time_t millis(void) {
-  assert (arduinoMock != NULL);
-  const time_t sysTime = time(0) - SECS_YR_2000;
-  arduinoMock->setMillisRaw(sysTime*1000);
-  arduinoMock->millis();
-  return arduinoMock->getMillis();
+  assert (arduinoMock() != NULL);
+  arduinoMock()->millis();
+  return arduinoMock()->getMillis();
 }
 
 time_t micros(void) {
-  return 0;
+  assert (arduinoMock() != NULL);
+  return arduinoMock()->getMicros();
+}
+
+// Stimuli queued by other threads are applied whenever the sketch lets
+// virtual time pass.
+static inline void serviceArduinoFake() {
+  ArduinoFake* fake = arduinoFake();
+  if (fake) {
+    fake->service();
+  }
 }
+
 void delay(time_t a) {
-  assert (arduinoMock != NULL);
-  arduinoMock->delay(a);
+  assert (arduinoMock() != NULL);
+  arduinoMock()->delay(a);
+  arduinoMock()->addMillisRaw(a);
+  serviceArduinoFake();
 }
-void delayMicroseconds(unsigned int us) {
-  UNUSED(us);
+
+void delayMicroseconds(time_t us) {
+  assert (arduinoMock() != NULL);
+  arduinoMock()->addMicrosRaw(us);
+  serviceArduinoFake();
+}
+
+// Like delay(), but returns as soon as a scheduled event has run. Lets
+// polling loops wait for data without stepping through every millisecond.
+bool delayUntilEvent(time_t ms) {
+  assert (arduinoMock() != NULL);
+  const bool ran = arduinoMock()->advanceToNextEvent((uint64_t)ms * 1000);
+  serviceArduinoFake();
+  return ran;
+}
+
+void yield(void) {
+  assert (arduinoMock() != NULL);
+  arduinoMock()->addMicrosRaw(arduinoMock()->getYieldMicros());
+  serviceArduinoFake();
+}
+
+// Waits for pin to read level, up to the virtual time deadline. The fake's
+// pins only change when a scheduled event runs (or a stimulus thread
+// injects an edge), so with ArduinoFake the clock jumps from event to event.
+// A mocked digitalRead() may change on any call, so it is polled every
+// getPinPollMicros(), or at the next scheduled event if that comes first.
+static bool waitForLevel(uint8_t pin, uint8_t level, uint64_t deadline) {
+  ArduinoMock* mock = arduinoMock();
+  while ((uint8_t)digitalRead(pin) != level) {
+    const uint64_t now = mock->getMicros64();
+    if (now >= deadline) {
+      return false;
+    }
+    uint64_t step = deadline - now;
+    if (!arduinoFake() && step > (uint64_t)mock->getPinPollMicros()) {
+      step = mock->getPinPollMicros();
+    }
+    mock->advanceToNextEvent(step);
+    serviceArduinoFake();
+  }
+  return true;
 }
 
 time_t pulseIn(uint8_t pin, uint8_t state, time_t timeout) {
-  UNUSED(pin);
-  UNUSED(state);
-  UNUSED(timeout);
-  return 0;
+  assert (arduinoMock() != NULL);
+  const uint8_t level = state ? HIGH : LOW;
+  const uint64_t deadline = arduinoMock()->getMicros64() + timeout;
+  // Like the target: let a pulse already in progress end, then time the
+  // next one. The timeout covers the whole call.
+  if (!waitForLevel(pin, !level, deadline)
+      || !waitForLevel(pin, level, deadline)) {
+    return 0;
+  }
+  const uint64_t start = arduinoMock()->getMicros64();
+  if (!waitForLevel(pin, !level, deadline)) {
+    return 0;
+  }
+  return arduinoMock()->getMicros64() - start;
 }
 
+static void shiftEdgeDelay() {
+  ArduinoMock* mock = arduinoMock();
+  if (mock) {
+    mock->addMicrosRaw(mock->getShiftEdgeMicros());
+    serviceArduinoFake();
+  }
+}
+
+// Same pin sequence as the AVR core: data is set up one edge time before
+// the rising clock edge, and shiftIn() samples one edge time after it.
 void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder,
               uint8_t val) {
-  UNUSED(dataPin);
-  UNUSED(clockPin);
-  UNUSED(bitOrder);
-  UNUSED(val);
+  for (int i = 0; i < 8; i++) {
+    const int bit = bitOrder == LSBFIRST ? i : 7 - i;
+    digitalWrite(dataPin, (val >> bit) & 1 ? HIGH : LOW);
+    shiftEdgeDelay();
+    digitalWrite(clockPin, HIGH);
+    shiftEdgeDelay();
+    digitalWrite(clockPin, LOW);
+  }
 }
 
 uint8_t shiftIn(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder) {
-  UNUSED(dataPin);
-  UNUSED(clockPin);
-  UNUSED(bitOrder);
-  return 0;
+  uint8_t value = 0;
+  for (int i = 0; i < 8; i++) {
+    const int bit = bitOrder == LSBFIRST ? i : 7 - i;
+    digitalWrite(clockPin, HIGH);
+    shiftEdgeDelay();
+    if (digitalRead(dataPin)) {
+      value |= 1 << bit;
+    }
+    digitalWrite(clockPin, LOW);
+    shiftEdgeDelay();
+  }
+  return value;
 }
 
-void attachInterrupt(uint8_t, void (*)(void), int mode) {
-  UNUSED(mode);
+// Interrupts need the GPIO fake to raise them; with only the mock they stay
+// no-ops.
+void attachInterrupt(uint8_t interrupt, void (*isr)(void), int mode) {
+  ArduinoFake* fake = arduinoFake();
+  if (fake) {
+    fake->getInterrupts().attach(interrupt, isr, mode);
+  }
 }
 
-void detachInterrupt(uint8_t) {}
+void detachInterrupt(uint8_t interrupt) {
+  ArduinoFake* fake = arduinoFake();
+  if (fake) {
+    fake->getInterrupts().detach(interrupt);
+  }
+}
 
-void interrupts(void) {}
+void interrupts(void) {
+  ArduinoFake* fake = arduinoFake();
+  if (fake) {
+    fake->getInterrupts().enable();
+    fake->service();
+  }
+}
 
-void noInterrupts(void) {}
+void noInterrupts(void) {
+  ArduinoFake* fake = arduinoFake();
+  if (fake) {
+    fake->getInterrupts().disable();
+  }
+}
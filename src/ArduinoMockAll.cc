@@ -1,6 +1,23 @@
 // Copyright 2015 http://switchdevice.com
 
 #include "Arduino.cc"
+#include "Scheduler.cc"
+#include "MockContext.cc"
+#include "SketchRunner.cc"
+#include "Interrupts.cc"
+#include "PinTrace.cc"
+#include "AnalogSource.cc"
+#include "RingBuffer.cc"
+#include "SerialCapture.cc"
+#include "PrintFormat.cc"
+#include "SerialPty.cc"
+#include "SerialReplay.cc"
+#include "StringAllocator.cc"
+#include "StringSearch.cc"
+#include "EspHeap.cc"
+#include "stdlib_noniso.cc"
+#include "WString.cpp"
+#include "Stream.cpp"
 #include "Serial.cc"
 #include "serialHelper.cc"
 #include "OneWire.cc"
@@ -1,31 +1,35 @@
 /** Implementation of EEPROM mock **/
 
 #include "arduino-mock/EEPROM.h"
+#include "arduino-mock/MockContext.h"
 
-static EEPROMMock* p_EEPROMMock = NULL;
+// The mock lives in the calling thread's context, see MockContext.h
+static inline EEPROMMock*& p_EEPROMMock() {
+  return currentMockContext().eeprom;
+}
 EEPROMMock* EEPROMMockInstance() {
-  if (!p_EEPROMMock) {
-    p_EEPROMMock = new EEPROMMock();
+  if (!p_EEPROMMock()) {
+    p_EEPROMMock() = new EEPROMMock();
   }
-  return p_EEPROMMock;
+  return p_EEPROMMock();
 }
 
 void releaseEEPROMMock() {
-  assert (p_EEPROMMock != NULL);
-  if (p_EEPROMMock) {
-    delete p_EEPROMMock;
-    p_EEPROMMock = NULL;
+  assert (p_EEPROMMock() != NULL);
+  if (p_EEPROMMock()) {
+    delete p_EEPROMMock();
+    p_EEPROMMock() = NULL;
   }
 }
 
 uint8_t EEPROM_::read(int a) {
-  assert (p_EEPROMMock != NULL);
-  return p_EEPROMMock->read(a);
+  assert (p_EEPROMMock() != NULL);
+  return p_EEPROMMock()->read(a);
 }
 
 void EEPROM_::write(int a, uint8_t b) {
-  assert (p_EEPROMMock != NULL);
-  p_EEPROMMock->write(a, b);
+  assert (p_EEPROMMock() != NULL);
+  p_EEPROMMock()->write(a, b);
 }
 
 // Preinstantiate Objects
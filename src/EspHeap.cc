@@ -0,0 +1,332 @@
+#include "arduino-mock/EspHeap.h"
+#include "arduino-mock/Arduino.h"
+#include "arduino-mock/MockContext.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <mutex>
+
+const size_t EspHeap::default_size;
+const size_t EspHeap::block_size;
+const size_t EspHeap::header_size;
+
+EspHeapStringAllocator::EspHeapStringAllocator(EspHeap& heap)
+  : heap(heap) {
+}
+
+void* EspHeapStringAllocator::doReallocate(void* ptr, size_t oldSize, size_t newSize) {
+  (void)oldSize;
+  return ptr ? espHeapRealloc(ptr, newSize) : heap.allocate(newSize);
+}
+
+void EspHeapStringAllocator::doRelease(void* ptr, size_t size) {
+  (void)size;
+  espHeapFree(ptr);
+}
+
+// Every live heap, so that a block finds its way back to its heap whichever
+// heap is current. liveEspHeapCount spares host memory the lock while no
+// heap exists.
+static std::mutex liveEspHeapMutex;
+static std::vector<EspHeap*> liveEspHeaps;
+static std::atomic<size_t> liveEspHeapCount(0);
+
+EspHeap::EspHeap(size_t size)
+  : storage(size / block_size), runSquares(0), usedBlocks(0), peakUsedBlocks(0),
+    failed(0), callBudget(SIZE_MAX), byteBudget(SIZE_MAX), historyLimit(0),
+    strings(*this) {
+  if (!storage.empty()) {
+    addRun(0, storage.size());
+  }
+  std::lock_guard<std::mutex> lock(liveEspHeapMutex);
+  liveEspHeaps.push_back(this);
+  liveEspHeapCount++;
+}
+
+EspHeap::~EspHeap() {
+  std::lock_guard<std::mutex> lock(liveEspHeapMutex);
+  liveEspHeaps.erase(std::find(liveEspHeaps.begin(), liveEspHeaps.end(), this));
+  liveEspHeapCount--;
+}
+
+size_t EspHeap::blocksFor(size_t size) {
+  return (size + header_size + block_size - 1) / block_size;
+}
+
+bool EspHeap::charge(size_t size) {
+  if (callBudget == 0 || size > byteBudget) {
+    return false;
+  }
+  if (callBudget != SIZE_MAX) {
+    callBudget--;
+  }
+  if (byteBudget != SIZE_MAX) {
+    byteBudget -= size;
+  }
+  return true;
+}
+
+void* EspHeap::take(size_t size) {
+  const size_t blocks = blocksFor(size);
+  for (std::map<size_t, size_t>::iterator run = freeRuns.begin();
+       run != freeRuns.end(); ++run) {
+    if (run->second >= blocks) {
+      const size_t start = run->first;
+      const size_t rest = run->second - blocks;
+      removeRun(run);
+      if (rest > 0) {
+        addRun(start + blocks, rest);
+      }
+      Allocation allocation = { blocks, size };
+      used[start] = allocation;
+      usedBlocks += blocks;
+      if (usedBlocks > peakUsedBlocks) {
+        peakUsedBlocks = usedBlocks;
+      }
+      return &storage[start];
+    }
+  }
+  return NULL;
+}
+
+void EspHeap::giveBack(size_t start, size_t blocks) {
+  std::map<size_t, size_t>::iterator next = freeRuns.lower_bound(start);
+  if (next != freeRuns.end() && next->first == start + blocks) {
+    blocks += next->second;
+    next = removeRun(next);
+  }
+  if (next != freeRuns.begin()) {
+    std::map<size_t, size_t>::iterator previous = std::prev(next);
+    if (previous->first + previous->second == start) {
+      start = previous->first;
+      blocks += previous->second;
+      removeRun(previous);
+    }
+  }
+  addRun(start, blocks);
+}
+
+void EspHeap::addRun(size_t start, size_t blocks) {
+  freeRuns[start] = blocks;
+  runLengths.insert(blocks);
+  runSquares += (uint64_t)blocks * blocks;
+}
+
+EspHeap::RunMap::iterator EspHeap::removeRun(RunMap::iterator run) {
+  runLengths.erase(runLengths.find(run->second));
+  runSquares -= (uint64_t)run->second * run->second;
+  return freeRuns.erase(run);
+}
+
+size_t EspHeap::blockOf(const void* ptr) const {
+  return (const uint64_t*)ptr - storage.data();
+}
+
+bool EspHeap::owns(const void* ptr) const {
+  const uint64_t* p = (const uint64_t*)ptr;
+  return p >= storage.data() && p < storage.data() + storage.size();
+}
+
+void* EspHeap::allocate(size_t size) {
+  void* ptr = NULL;
+  if (size > 0 && (!charge(size) || !(ptr = take(size)))) {
+    failed++;
+  }
+  record();
+  return ptr;
+}
+
+void* EspHeap::reallocate(void* ptr, size_t size) {
+  if (!ptr) {
+    return allocate(size);
+  }
+  if (size == 0) {
+    release(ptr);
+    return NULL;
+  }
+  const size_t start = blockOf(ptr);
+  std::map<size_t, Allocation>::iterator it = used.find(start);
+  assert (it != used.end());
+  Allocation& allocation = it->second;
+  if (size > allocation.size && !charge(size - allocation.size)) {
+    failed++;
+    record();
+    return NULL;
+  }
+
+  const size_t blocks = blocksFor(size);
+  if (blocks <= allocation.blocks) {
+    if (blocks < allocation.blocks) {
+      giveBack(start + blocks, allocation.blocks - blocks);
+      usedBlocks -= allocation.blocks - blocks;
+    }
+    allocation.blocks = blocks;
+    allocation.size = size;
+    record();
+    return ptr;
+  }
+
+  const size_t extra = blocks - allocation.blocks;
+  std::map<size_t, size_t>::iterator next = freeRuns.find(start + allocation.blocks);
+  if (next != freeRuns.end() && next->second >= extra) {
+    const size_t rest = next->second - extra;
+    removeRun(next);
+    if (rest > 0) {
+      addRun(start + blocks, rest);
+    }
+    usedBlocks += extra;
+    if (usedBlocks > peakUsedBlocks) {
+      peakUsedBlocks = usedBlocks;
+    }
+    allocation.blocks = blocks;
+    allocation.size = size;
+    record();
+    return ptr;
+  }
+
+  // Both buffers are held while the data moves, as on the device
+  const size_t oldSize = allocation.size;
+  void* moved = take(size);
+  if (!moved) {
+    failed++;
+    record();
+    return NULL;
+  }
+  memcpy(moved, ptr, oldSize);
+  release(ptr);
+  return moved;
+}
+
+void EspHeap::release(void* ptr) {
+  if (!ptr) {
+    return;
+  }
+  std::map<size_t, Allocation>::iterator it = used.find(blockOf(ptr));
+  assert (it != used.end());
+  giveBack(it->first, it->second.blocks);
+  usedBlocks -= it->second.blocks;
+  used.erase(it);
+  record();
+}
+
+// umm_malloc's metric: 100 - 100 * sqrt(sum of squared run lengths) /
+// total free length
+uint8_t EspHeap::getFragmentation() const {
+  const size_t blocks = storage.size() - usedBlocks;
+  if (blocks == 0) {
+    return 0;
+  }
+  return 100 - (uint8_t)(sqrt((double)runSquares) * 100 / blocks);
+}
+
+void EspHeap::keepHistory(size_t samples) {
+  historyLimit = samples;
+  while (history.size() > historyLimit) {
+    history.pop_front();
+  }
+  record();
+}
+
+void EspHeap::failAfterCalls(size_t calls) {
+  callBudget = calls;
+}
+
+void EspHeap::failAfterBytes(size_t bytes) {
+  byteBudget = bytes;
+}
+
+void EspHeap::clearFailure() {
+  callBudget = SIZE_MAX;
+  byteBudget = SIZE_MAX;
+}
+
+void EspHeap::record() {
+  if (historyLimit == 0) {
+    return;
+  }
+  ArduinoMock* arduinoMock = currentMockContext().arduino;
+  EspHeapSample sample;
+  sample.micros = arduinoMock ? arduinoMock->getMicros64() : 0;
+  sample.used = getUsedBytes();
+  sample.maxFreeBlock = getMaxFreeBlockSize();
+  sample.fragmentation = getFragmentation();
+  if (!history.empty() && history.back().micros == sample.micros) {
+    history.back() = sample;
+  } else {
+    if (history.size() == historyLimit) {
+      history.pop_front();
+    }
+    history.push_back(sample);
+  }
+}
+
+EspHeap* espHeap() {
+  return currentMockContext().espHeap;
+}
+
+EspHeap* setEspHeap(EspHeap* heap) {
+  MockContext& context = currentMockContext();
+  EspHeap* previous = context.espHeap;
+  context.espHeap = heap;
+  // Leave an allocator alone that was set on purpose
+  if (!context.stringAllocator
+      || (previous && context.stringAllocator == &previous->getStringAllocator())) {
+    context.stringAllocator = heap ? &heap->getStringAllocator() : NULL;
+  }
+  return previous;
+}
+
+EspHeap* espHeapOwning(const void* ptr) {
+  if (!ptr || liveEspHeapCount == 0) {
+    return NULL;
+  }
+  std::lock_guard<std::mutex> lock(liveEspHeapMutex);
+  for (size_t i = 0; i < liveEspHeaps.size(); i++) {
+    if (liveEspHeaps[i]->owns(ptr)) {
+      return liveEspHeaps[i];
+    }
+  }
+  return NULL;
+}
+
+extern "C" {
+
+void* espHeapMalloc(size_t size) {
+  EspHeap* heap = espHeap();
+  return heap ? heap->allocate(size) : malloc(size);
+}
+
+void* espHeapCalloc(size_t count, size_t size) {
+  if (size != 0 && count > SIZE_MAX / size) {
+    return NULL;
+  }
+  void* ptr = espHeapMalloc(count * size);
+  if (ptr) {
+    memset(ptr, 0, count * size);
+  }
+  return ptr;
+}
+
+void* espHeapRealloc(void* ptr, size_t size) {
+  if (!ptr) {
+    return espHeapMalloc(size);
+  }
+  EspHeap* heap = espHeapOwning(ptr);
+  return heap ? heap->reallocate(ptr, size) : realloc(ptr, size);
+}
+
+void espHeapFree(void* ptr) {
+  EspHeap* heap = espHeapOwning(ptr);
+  if (heap) {
+    heap->release(ptr);
+  } else {
+    free(ptr);
+  }
+}
+
+}
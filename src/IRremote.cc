@@ -1,21 +1,25 @@
 #include "arduino-mock/IRremote.h"
+#include "arduino-mock/MockContext.h"
 
 // Taken from IRremoteInt.h
 #define ERR 0
 #define DECODED 1
 
-static IRrecvMock* gIRrecvMock = NULL;
+// The mock lives in the calling thread's context, see MockContext.h
+static inline IRrecvMock*& gIRrecvMock() {
+  return currentMockContext().irrecv;
+}
 IRrecvMock* irrecvMockInstance() {
-  if(!gIRrecvMock) {
-    gIRrecvMock = new IRrecvMock();
+  if(!gIRrecvMock()) {
+    gIRrecvMock() = new IRrecvMock();
   }
-  return gIRrecvMock;
+  return gIRrecvMock();
 }
 
 void releaseIRrecvMock() {
-  if(gIRrecvMock) {
-    delete gIRrecvMock;
-    gIRrecvMock = NULL;
+  if(gIRrecvMock()) {
+    delete gIRrecvMock();
+    gIRrecvMock() = NULL;
   }
 }
 
@@ -37,21 +41,21 @@ IRrecv_::IRrecv_(int16_t recvpin) {
 }
 
 int16_t IRrecv_::decode(decode_results *results) {
-  assert (gIRrecvMock != NULL);
-  gIRrecvMock->decode(results);
+  assert (gIRrecvMock() != NULL);
+  gIRrecvMock()->decode(results);
   assert (results != NULL);
-  results->value = gIRrecvMock->getIRValue();
+  results->value = gIRrecvMock()->getIRValue();
   return DECODED;
 }
 
 void IRrecv_::enableIRIn() {
-  assert (gIRrecvMock != NULL);
-  gIRrecvMock->enableIRIn();
+  assert (gIRrecvMock() != NULL);
+  gIRrecvMock()->enableIRIn();
 }
 
 void IRrecv_::resume() {
-  assert (gIRrecvMock != NULL);
-  gIRrecvMock->resume();
+  assert (gIRrecvMock() != NULL);
+  gIRrecvMock()->resume();
 }
 
 //// Preinstantiate Objects
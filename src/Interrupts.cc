@@ -0,0 +1,154 @@
+#include "arduino-mock/Interrupts.h"
+#include "arduino-mock/Arduino.h"
+
+#include <algorithm>
+
+static size_t roundUpToPowerOfTwo(size_t value) {
+  size_t size = 2;
+  while (size < value) {
+    size <<= 1;
+  }
+  return size;
+}
+
+PinEdgeQueue::PinEdgeQueue(size_t capacity)
+  : cells(roundUpToPowerOfTwo(capacity)), mask(cells.size() - 1),
+    enqueuePos(0), dequeuePos(0) {
+  for (size_t i = 0; i < cells.size(); i++) {
+    cells[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+bool PinEdgeQueue::push(uint8_t pin, uint8_t level) {
+  size_t pos = enqueuePos.load(std::memory_order_relaxed);
+  Cell* cell;
+  for (;;) {
+    cell = &cells[pos & mask];
+    const size_t seq = cell->sequence.load(std::memory_order_acquire);
+    const intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+    if (diff == 0) {
+      // Our turn for this cell, unless another producer claims it first.
+      if (enqueuePos.compare_exchange_weak(pos, pos + 1,
+                                           std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // The consumer has not freed this cell yet: full.
+      return false;
+    } else {
+      pos = enqueuePos.load(std::memory_order_relaxed);
+    }
+  }
+  cell->data = (uint16_t)((pin << 8) | (level ? 1 : 0));
+  cell->sequence.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+bool PinEdgeQueue::pop(uint8_t& pin, uint8_t& level) {
+  const size_t pos = dequeuePos.load(std::memory_order_relaxed);
+  Cell& cell = cells[pos & mask];
+  const size_t seq = cell.sequence.load(std::memory_order_acquire);
+  if ((intptr_t)seq - (intptr_t)(pos + 1) < 0) {
+    return false;
+  }
+  pin = cell.data >> 8;
+  level = cell.data & 1;
+  // Hand the cell back to the producers for the next lap.
+  cell.sequence.store(pos + mask + 1, std::memory_order_release);
+  dequeuePos.store(pos + 1, std::memory_order_relaxed);
+  return true;
+}
+
+InterruptController::InterruptController()
+  : pendingHead(0), enabled(true), inIsr(false) {
+  for (int i = 0; i < num_interrupts; i++) {
+    handlers[i] = NULL;
+    modes[i] = 0;
+    pending[i] = false;
+    delivered[i] = 0;
+    lost[i] = 0;
+    watched[i] = false;
+  }
+}
+
+void InterruptController::attach(uint8_t interrupt, Handler isr, int mode) {
+  handlers[interrupt] = isr;
+  modes[interrupt] = mode;
+  for (int pin = 0; pin < num_interrupts; pin++) {
+    if (digitalPinToInterrupt(pin) == interrupt) {
+      watched[pin] = isr != NULL;
+    }
+  }
+}
+
+void InterruptController::detach(uint8_t interrupt) {
+  attach(interrupt, NULL, 0);
+  if (pending[interrupt]) {
+    // Otherwise the entry would deliver a later edge after a re-attach
+    // ahead of edges raised on other interrupts in between
+    pending[interrupt] = false;
+    pendingOrder.erase(std::remove(pendingOrder.begin() + pendingHead,
+                                   pendingOrder.end(), interrupt),
+                       pendingOrder.end());
+  }
+}
+
+void InterruptController::enable() {
+  enabled = true;
+  service();
+}
+
+void InterruptController::disable() {
+  enabled = false;
+}
+
+void InterruptController::pinChanged(uint8_t pin, uint8_t level) {
+  if (!watched[pin]) {
+    return;
+  }
+  const uint8_t interrupt = digitalPinToInterrupt(pin);
+  const int mode = modes[interrupt];
+  if (mode == CHANGE
+      || (mode == RISING && level == HIGH)
+      || (mode == FALLING && level == LOW)) {
+    raise(interrupt);
+  }
+}
+
+void InterruptController::raise(uint8_t interrupt) {
+  if (enabled && !inIsr) {
+    run(interrupt);
+    service();
+    return;
+  }
+  if (pending[interrupt]) {
+    lost[interrupt]++;
+    return;
+  }
+  pending[interrupt] = true;
+  pendingOrder.push_back(interrupt);
+}
+
+void InterruptController::run(uint8_t interrupt) {
+  inIsr = true;
+  handlers[interrupt]();
+  delivered[interrupt]++;
+  inIsr = false;
+}
+
+void InterruptController::service() {
+  if (inIsr) {
+    return;
+  }
+  while (enabled && pendingHead < pendingOrder.size()) {
+    const uint8_t interrupt = pendingOrder[pendingHead++];
+    pending[interrupt] = false;
+    if (handlers[interrupt]) {
+      run(interrupt);
+    }
+  }
+  if (pendingHead == pendingOrder.size()) {
+    pendingOrder.clear();
+    pendingHead = 0;
+  }
+}
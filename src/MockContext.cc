@@ -0,0 +1,60 @@
+#include "arduino-mock/MockContext.h"
+#include "arduino-mock/Arduino.h"
+#include "arduino-mock/Serial.h"
+#include "arduino-mock/Wire.h"
+#include "arduino-mock/SPI.h"
+#include "arduino-mock/EEPROM.h"
+#include "arduino-mock/OneWire.h"
+#include "arduino-mock/Spark.h"
+#include "arduino-mock/WiFi.h"
+#include "arduino-mock/IRremote.h"
+#include "arduino-mock/PinTrace.h"
+#include "arduino-mock/SerialCapture.h"
+#include "arduino-mock/SerialPty.h"
+#include "arduino-mock/SoftwareSerial.h"
+
+static thread_local MockContext threadContext;
+static thread_local MockContext* threadCurrent = NULL;
+
+MockContext::MockContext()
+  : arduino(NULL), arduinoFake(NULL), pinTrace(NULL), serial(NULL), serialCapture(NULL), serialPty(NULL),
+    wire(NULL), spi(NULL), eeprom(NULL), oneWire(NULL), spark(NULL), wifi(NULL), irrecv(NULL),
+    serialPrintToCout(false), stringAllocator(NULL), espHeap(NULL) {
+}
+
+MockContext::~MockContext() {
+  delete arduino;
+  delete arduinoFake;
+  delete pinTrace;
+  delete serial;
+  delete serialCapture;
+  delete serialPty;
+  delete wire;
+  delete spi;
+  delete eeprom;
+  delete oneWire;
+  delete spark;
+  delete wifi;
+  delete irrecv;
+}
+
+MockContext& currentMockContext() {
+  if (threadCurrent) {
+    return *threadCurrent;
+  }
+  return threadContext;
+}
+
+MockContext* setCurrentMockContext(MockContext* context) {
+  MockContext* previous = threadCurrent;
+  threadCurrent = context;
+  return previous;
+}
+
+ScopedMockContext::ScopedMockContext()
+  : previous(setCurrentMockContext(this)) {
+}
+
+ScopedMockContext::~ScopedMockContext() {
+  setCurrentMockContext(previous);
+}
@@ -1,30 +1,34 @@
 #include "arduino-mock/OneWire.h"
+#include "arduino-mock/MockContext.h"
 
-static OneWireMock* gOneWireMock = NULL;
+// The mock lives in the calling thread's context, see MockContext.h
+static inline OneWireMock*& gOneWireMock() {
+  return currentMockContext().oneWire;
+}
 
 OneWireMock* oneWireMockInstance() {
-    if( !gOneWireMock ) {
-        gOneWireMock = new OneWireMock();
+    if( !gOneWireMock() ) {
+        gOneWireMock() = new OneWireMock();
     }
 
-    return gOneWireMock;
+    return gOneWireMock();
 }
 
 
 void releaseOneWireMock() {
-    if( gOneWireMock ) {
-        delete gOneWireMock;
-        gOneWireMock = NULL;
+    if( gOneWireMock() ) {
+        delete gOneWireMock();
+        gOneWireMock() = NULL;
     }
 }
 
 
 bool OneWire::search( uint8_t* buf ) {
-    assert( gOneWireMock != NULL );
-    return gOneWireMock->search( buf );
+    assert( gOneWireMock() != NULL );
+    return gOneWireMock()->search( buf );
 }
 
 void OneWire::reset_search( void ) {
-    assert( gOneWireMock != NULL );
-    gOneWireMock->reset_search( );
+    assert( gOneWireMock() != NULL );
+    gOneWireMock()->reset_search( );
 }
\ No newline at end of file
@@ -0,0 +1,158 @@
+#include "arduino-mock/PinTrace.h"
+#include "arduino-mock/Arduino.h"
+#include "arduino-mock/MockContext.h"
+
+#include <fstream>
+#include <string>
+
+const size_t PinTrace::default_capacity;
+const uint16_t PinTrace::max_value;
+
+static inline PinTrace*& gPinTrace() {
+  return currentMockContext().pinTrace;
+}
+PinTrace* pinTraceInstance(size_t capacity) {
+  if (!gPinTrace()) {
+    gPinTrace() = new PinTrace(capacity);
+  }
+  return gPinTrace();
+}
+
+void releasePinTrace() {
+  if (gPinTrace()) {
+    delete gPinTrace();
+    gPinTrace() = NULL;
+  }
+}
+
+static size_t traceCapacity(size_t value) {
+  size_t size = 1;
+  while (size < value) {
+    size <<= 1;
+  }
+  return size;
+}
+
+PinTrace::PinTrace(size_t capacity)
+  : records(traceCapacity(capacity)), mask(records.size() - 1), head(0) {
+}
+
+PinTrace::Record PinTrace::at(size_t index) const {
+  const uint64_t first = head - size();
+  const uint64_t packed = records[(first + index) & mask];
+  Record record;
+  record.micros = packed >> 24;
+  record.kind = (Kind)((packed >> 22) & 0x3);
+  record.pin = (packed >> 14) & 0xff;
+  record.value = packed & max_value;
+  return record;
+}
+
+// VCD identifiers are strings of printable ASCII characters '!' to '~'.
+static std::string vcdIdentifier(int index) {
+  std::string id;
+  do {
+    id += (char)('!' + index % 94);
+    index /= 94;
+  } while (index > 0);
+  return id;
+}
+
+static void writeBinary(std::ostream& out, unsigned int value) {
+  out << 'b';
+  bool started = false;
+  for (int bit = 15; bit >= 0; bit--) {
+    if (value & (1u << bit)) {
+      started = true;
+    }
+    if (started || bit == 0) {
+      out << ((value >> bit) & 1 ? '1' : '0');
+    }
+  }
+}
+
+void PinTrace::exportVcd(std::ostream& out) const {
+  static const int num_pins = 256;
+  static const uint8_t mode_unknown = 0xff;
+  const size_t count = size();
+
+  bool digital[num_pins] = {false};
+  bool analog[num_pins] = {false};
+  for (size_t i = 0; i < count; i++) {
+    const Record record = at(i);
+    if (record.kind == ANALOG_WRITE) {
+      analog[record.pin] = true;
+    } else {
+      digital[record.pin] = true;
+    }
+  }
+
+  std::string digitalId[num_pins];
+  std::string analogId[num_pins];
+  int ids = 0;
+  out << "$version arduino-mock pin trace $end\n"
+      << "$timescale 1us $end\n"
+      << "$scope module arduino $end\n";
+  for (int pin = 0; pin < num_pins; pin++) {
+    if (digital[pin]) {
+      digitalId[pin] = vcdIdentifier(ids++);
+      out << "$var wire 1 " << digitalId[pin] << " pin" << pin << " $end\n";
+    }
+    if (analog[pin]) {
+      analogId[pin] = vcdIdentifier(ids++);
+      out << "$var wire 16 " << analogId[pin] << " pwm" << pin << " $end\n";
+    }
+  }
+  out << "$upscope $end\n"
+      << "$enddefinitions $end\n";
+
+  uint64_t now = count ? at(0).micros : 0;
+  out << "#" << now << "\n$dumpvars\n";
+  for (int pin = 0; pin < num_pins; pin++) {
+    if (digital[pin]) {
+      out << "x" << digitalId[pin] << "\n";
+    }
+    if (analog[pin]) {
+      out << "bx " << analogId[pin] << "\n";
+    }
+  }
+  out << "$end\n";
+
+  uint8_t mode[num_pins];
+  uint8_t level[num_pins] = {0};
+  for (int pin = 0; pin < num_pins; pin++) {
+    mode[pin] = mode_unknown;
+  }
+  for (size_t i = 0; i < count; i++) {
+    const Record record = at(i);
+    // VCD time must not go backwards; clamp if the clock was set back.
+    if (record.micros > now) {
+      now = record.micros;
+      out << "#" << now << "\n";
+    }
+    const uint8_t pin = record.pin;
+    switch (record.kind) {
+    case PIN_MODE:
+      mode[pin] = record.value;
+      break;
+    case DIGITAL_WRITE:
+      level[pin] = record.value ? 1 : 0;
+      break;
+    case ANALOG_WRITE:
+      writeBinary(out, record.value);
+      out << " " << analogId[pin] << "\n";
+      continue;
+    }
+    const bool driven = mode[pin] == OUTPUT || mode[pin] == mode_unknown;
+    out << (driven ? (level[pin] ? '1' : '0') : 'z') << digitalId[pin] << "\n";
+  }
+}
+
+bool PinTrace::exportVcd(const char* path) const {
+  std::ofstream out(path);
+  if (!out) {
+    return false;
+  }
+  exportVcd(out);
+  return out.good();
+}
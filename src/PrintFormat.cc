@@ -0,0 +1,79 @@
+#include "arduino-mock/PrintFormat.h"
+
+#include <math.h>
+#include <string.h>
+
+static const char digitChars[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+size_t formatNumber(char* buffer, unsigned long long value, int base) {
+  if (base < 2 || base > 36) {
+    base = 10;
+  }
+  // Digits come out least significant first; write them from the end of a
+  // scratch area, then move them to the front.
+  char digits[print_number_size];
+  char* p = digits + sizeof(digits);
+  if ((base & (base - 1)) == 0) {
+    const int shift = __builtin_ctz(base);
+    const unsigned long long mask = base - 1;
+    do {
+      *--p = digitChars[value & mask];
+      value >>= shift;
+    } while (value);
+  } else {
+    do {
+      *--p = digitChars[value % base];
+      value /= base;
+    } while (value);
+  }
+  const size_t length = digits + sizeof(digits) - p;
+  memcpy(buffer, p, length);
+  buffer[length] = '\0';
+  return length;
+}
+
+size_t formatDouble(char* buffer, double value, int digits) {
+  if (isnan(value)) {
+    strcpy(buffer, "nan");
+    return 3;
+  }
+  if (isinf(value)) {
+    strcpy(buffer, "inf");
+    return 3;
+  }
+  if (value > 4294967040.0 || value < -4294967040.0) {
+    strcpy(buffer, "ovf");
+    return 3;
+  }
+  if (digits < 0) {
+    digits = 0;
+  } else if (digits > 255) {
+    digits = 255;
+  }
+
+  char* p = buffer;
+  if (value < 0.0) {
+    *p++ = '-';
+    value = -value;
+  }
+  double rounding = 0.5;
+  for (int i = 0; i < digits; i++) {
+    rounding /= 10.0;
+  }
+  value += rounding;
+
+  const unsigned long integer = (unsigned long)value;
+  p += formatNumber(p, integer, 10);
+  double remainder = value - (double)integer;
+  if (digits > 0) {
+    *p++ = '.';
+  }
+  while (digits-- > 0) {
+    remainder *= 10.0;
+    const int digit = (int)remainder;
+    *p++ = (char)('0' + digit);
+    remainder -= digit;
+  }
+  *p = '\0';
+  return p - buffer;
+}
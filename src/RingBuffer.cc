@@ -0,0 +1,49 @@
+#include "arduino-mock/RingBuffer.h"
+
+#include <string.h>
+
+const size_t RingBuffer::default_capacity;
+
+static size_t ringCapacity(size_t value) {
+  size_t size = 1;
+  while (size < value) {
+    size <<= 1;
+  }
+  return size;
+}
+
+RingBuffer::RingBuffer(size_t capacity)
+  : data(ringCapacity(capacity)), mask(data.size() - 1), head(0), tail(0) {
+}
+
+void RingBuffer::feed(const uint8_t* bytes, size_t length) {
+  if (size() + length > capacity()) {
+    grow(size() + length);
+  }
+  const size_t start = tail & mask;
+  const size_t first = length < capacity() - start ? length : capacity() - start;
+  memcpy(&data[start], bytes, first);
+  memcpy(&data[0], bytes + first, length - first);
+  tail += length;
+}
+
+size_t RingBuffer::read(uint8_t* buffer, size_t length) {
+  if (length > size()) {
+    length = size();
+  }
+  const size_t start = head & mask;
+  const size_t first = length < capacity() - start ? length : capacity() - start;
+  memcpy(buffer, &data[start], first);
+  memcpy(buffer + first, &data[0], length - first);
+  head += length;
+  return length;
+}
+
+void RingBuffer::grow(size_t needed) {
+  std::vector<uint8_t> larger(ringCapacity(needed));
+  const size_t count = read(&larger[0], size());
+  data.swap(larger);
+  mask = data.size() - 1;
+  head = 0;
+  tail = count;
+}
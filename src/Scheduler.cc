@@ -0,0 +1,142 @@
+#include "arduino-mock/Scheduler.h"
+
+VirtualScheduler::VirtualScheduler()
+  : baseTick(0), nextSeq(0), wheelCount(0) {
+}
+
+std::vector<VirtualScheduler::Event>& VirtualScheduler::slotFor(uint64_t tick) {
+  return wheel[tick % wheel_slots];
+}
+
+void VirtualScheduler::insert(Event& event) {
+  uint64_t tick = event.when / tick_micros;
+  if (tick < baseTick) {
+    // Already due; park it in the current slot, it sorts first by time.
+    tick = baseTick;
+  }
+  if (tick - baseTick >= wheel_slots) {
+    overflow.insert(std::make_pair(event.when, std::move(event)));
+    return;
+  }
+  slotFor(tick).push_back(std::move(event));
+  wheelCount++;
+}
+
+// Moves overflow events that now fall inside the wheel's horizon into their
+// slots. The overflow list is ordered, so only its head needs looking at.
+void VirtualScheduler::cascade() {
+  while (!overflow.empty()) {
+    std::multimap<uint64_t, Event>::iterator it = overflow.begin();
+    const uint64_t tick = it->first / tick_micros;
+    if (tick >= baseTick && tick - baseTick >= wheel_slots) {
+      break;
+    }
+    Event event = std::move(it->second);
+    overflow.erase(it);
+    insert(event);
+  }
+}
+
+// Finds the earliest event in the wheel: the first non-empty slot from the
+// current tick on, and within it the lowest (when, seq).
+bool VirtualScheduler::earliest(uint64_t& tick, size_t& index) {
+  if (wheelCount == 0) {
+    return false;
+  }
+  for (uint64_t i = 0; i < wheel_slots; i++) {
+    std::vector<Event>& slot = slotFor(baseTick + i);
+    if (slot.empty()) {
+      continue;
+    }
+    index = 0;
+    for (size_t j = 1; j < slot.size(); j++) {
+      if (slot[j].when < slot[index].when
+          || (slot[j].when == slot[index].when && slot[j].seq < slot[index].seq)) {
+        index = j;
+      }
+    }
+    tick = baseTick + i;
+    return true;
+  }
+  return false;
+}
+
+void VirtualScheduler::scheduleAt(uint64_t when, Callback callback) {
+  Event event;
+  event.when = when;
+  event.seq = nextSeq++;
+  event.callback = std::move(callback);
+  insert(event);
+}
+
+uint64_t VirtualScheduler::nextEventTime() {
+  uint64_t tick;
+  size_t index;
+  if (earliest(tick, index)) {
+    return slotFor(tick)[index].when;
+  }
+  if (!overflow.empty()) {
+    return overflow.begin()->first;
+  }
+  return UINT64_MAX;
+}
+
+bool VirtualScheduler::popDue(uint64_t limit, uint64_t& when,
+                              Callback& callback) {
+  if (wheelCount == 0 && !overflow.empty()) {
+    // Nothing close by: turn the wheel straight to the next far event.
+    baseTick = overflow.begin()->first / tick_micros;
+    cascade();
+  }
+  uint64_t tick;
+  size_t index;
+  if (!earliest(tick, index)) {
+    return false;
+  }
+  std::vector<Event>& slot = slotFor(tick);
+  if (slot[index].when > limit) {
+    return false;
+  }
+  when = slot[index].when;
+  callback = std::move(slot[index].callback);
+  if (index != slot.size() - 1) {
+    slot[index] = std::move(slot.back());
+  }
+  slot.pop_back();
+  wheelCount--;
+  if (tick > baseTick) {
+    baseTick = tick;
+    cascade();
+  }
+  return true;
+}
+
+void VirtualScheduler::advance(uint64_t now) {
+  const uint64_t tick = now / tick_micros;
+  if (wheelCount == 0) {
+    if (tick > baseTick) {
+      baseTick = tick;
+    }
+  } else {
+    while (baseTick < tick && slotFor(baseTick).empty()) {
+      baseTick++;
+    }
+  }
+  cascade();
+}
+
+size_t VirtualScheduler::size() const {
+  return wheelCount + overflow.size();
+}
+
+bool VirtualScheduler::empty() const {
+  return size() == 0;
+}
+
+void VirtualScheduler::clear() {
+  for (uint64_t i = 0; i < wheel_slots; i++) {
+    wheel[i].clear();
+  }
+  overflow.clear();
+  wheelCount = 0;
+}
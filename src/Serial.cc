@@ -1,19 +1,29 @@
 // Copyright 2014 http://switchdevice.com
 
 #include "arduino-mock/Serial.h"
+#include "arduino-mock/Arduino.h"
+#include "arduino-mock/MockContext.h"
+#include "arduino-mock/SerialCapture.h"
+#include "arduino-mock/SerialPty.h"
+#include "arduino-mock/PrintFormat.h"
 
-static SerialMock* gSerialMock = NULL;
+#include <algorithm>
+
+// The mock lives in the calling thread's context, see MockContext.h
+static inline SerialMock*& gSerialMock() {
+  return currentMockContext().serial;
+}
 SerialMock* serialMockInstance() {
-  if(!gSerialMock) {
-    gSerialMock = new SerialMock();
+  if(!gSerialMock()) {
+    gSerialMock() = new SerialMock();
   }
-  return gSerialMock;
+  return gSerialMock();
 }
 
 void releaseSerialMock() {
-  if(gSerialMock) {
-    delete gSerialMock;
-    gSerialMock = NULL;
+  if(gSerialMock()) {
+    delete gSerialMock();
+    gSerialMock() = NULL;
   }
 }
 
@@ -25,230 +35,568 @@ void releaseSerialMock() {
 // Serial.println(1.23456, 2) gives "1.23"
 // Serial.println(1.23456, 4) gives "1.2346"
 
+// Numbers are formatted into a stack buffer, see PrintFormat.h, so neither
+// output path allocates or changes the flags of std::cout.
+template<typename T> void printBase(T num, int base) {
+  char text[print_number_size];
+  std::cout.write(text, formatInteger(text, num, base));
+}
+
 void printDouble(double num, int digits) {
-  std::streamsize ss = std::cout.precision();
-  std::cout << std::setprecision(digits) << std::fixed << num;
-  std::cout.unsetf(std::ios::fixed);
-  std::cout.precision (ss);
+  char text[print_double_size];
+  std::cout.write(text, formatDouble(text, num, digits));
 }
 
-template<typename T> void printBase(T num, int base) {
-  switch (base) {
-  case BIN:
-    assert (! "Need to implement this");
-    break;
-  case OCT:
-    std::cout << std::oct;
-    break;
-  case DEC:
-    std::cout << std::dec;
-    break;
-  case HEX:
-    std::cout << std::hex;
-    break;
+static inline bool printToCout() {
+  return currentMockContext().serialPrintToCout;
+}
+
+static inline SerialPty* serialPty() {
+  return currentMockContext().serialPty;
+}
+
+// Output goes to the context's SerialCapture and/or SerialPty, when there
+// is one, instead of the mock.
+struct SerialSink {
+  SerialCapture* capture;
+  SerialPty* pty;
+
+  explicit operator bool() const {
+    return capture || pty;
+  }
+  void append(const char* data, size_t length) {
+    if (capture) {
+      capture->append(data, length);
+    }
+    if (pty) {
+      pty->write(data, length);
+    }
+  }
+  void append(const char* text) {
+    append(text, strlen(text));
   }
-  std::cout << num << std::dec;
+  void append(char c) {
+    append(&c, 1);
+  }
+};
+
+static inline SerialSink serialSink() {
+  const MockContext& context = currentMockContext();
+  SerialSink sink = { context.serialCapture, context.serialPty };
+  return sink;
 }
 
-bool Serial_::printToCout = false;
+// Appends num the way print(num, base) sends it; returns the byte count.
+template<typename T> size_t sinkBase(SerialSink& sink, T num, int base) {
+  char text[print_number_size];
+  const size_t length = formatInteger(text, num, base);
+  sink.append(text, length);
+  return length;
+}
+
+static size_t sinkDouble(SerialSink& sink, double num, int digits) {
+  char text[print_double_size];
+  const size_t length = formatDouble(text, num, digits);
+  sink.append(text, length);
+  return length;
+}
+
+static inline size_t sinkNewline(SerialSink& sink) {
+  sink.append("\r\n", 2);
+  return 2;
+}
 
 void Serial_::setPrintToCout(bool flag) {
-  printToCout = flag;
+  currentMockContext().serialPrintToCout = flag;
 }
 
 size_t Serial_::print(const char *s) {
-  if (printToCout) {
+  SerialSink sink = serialSink();
+  if (sink) {
+    sink.append(s);
+    return strlen(s);
+  }
+  if (printToCout()) {
     std::cout << s;
     return 0;
   }
-  assert (gSerialMock != NULL);
-  return gSerialMock->print(s);
+  assert (gSerialMock() != NULL);
+  return gSerialMock()->print(s);
 }
 
 size_t Serial_::print(char c) {
-  if (printToCout) {
+  SerialSink sink = serialSink();
+  if (sink) {
+    sink.append(c);
+    return 1;
+  }
+  if (printToCout()) {
     std::cout << c;
     return 0;
   }
-  assert (gSerialMock != NULL);
-  return gSerialMock->print(c);
+  assert (gSerialMock() != NULL);
+  return gSerialMock()->print(c);
 }
 
 size_t Serial_::print(unsigned char c, int base) {
-  if (printToCout) {
+  SerialSink sink = serialSink();
+  if (sink) {
+    return sinkBase(sink, c, base);
+  }
+  if (printToCout()) {
     printBase(c, base);
     return 0;
   }
-  assert (gSerialMock != NULL);
-  return gSerialMock->print(c, base);
+  assert (gSerialMock() != NULL);
+  return gSerialMock()->print(c, base);
 }
 
 size_t Serial_::print(int num, int base) {
-  if (printToCout) {
+  SerialSink sink = serialSink();
+  if (sink) {
+    return sinkBase(sink, num, base);
+  }
+  if (printToCout()) {
     printBase(num, base);
     return 0;
   }
-  assert (gSerialMock != NULL);
-  return gSerialMock->print(num, base);
+  assert (gSerialMock() != NULL);
+  return gSerialMock()->print(num, base);
 }
 
 size_t Serial_::print(unsigned int num, int base) {
-  if (printToCout) {
+  SerialSink sink = serialSink();
+  if (sink) {
+    return sinkBase(sink, num, base);
+  }
+  if (printToCout()) {
     printBase(num, base);
     return 0;
   }
-  assert (gSerialMock != NULL);
-  return gSerialMock->print(num, base);
+  assert (gSerialMock() != NULL);
+  return gSerialMock()->print(num, base);
 }
 
 size_t Serial_::print(long num, int base) {
-  if (printToCout) {
+  SerialSink sink = serialSink();
+  if (sink) {
+    return sinkBase(sink, num, base);
+  }
+  if (printToCout()) {
     printBase(num, base);
     return 0;
   }
-  assert (gSerialMock != NULL);
-  return gSerialMock->print(num, base);
+  assert (gSerialMock() != NULL);
+  return gSerialMock()->print(num, base);
 }
 
 size_t Serial_::print(unsigned long num, int base) {
-  if (printToCout) {
+  SerialSink sink = serialSink();
+  if (sink) {
+    return sinkBase(sink, num, base);
+  }
+  if (printToCout()) {
     printBase(num, base);
     return 0;
   }
-  assert (gSerialMock != NULL);
-  return gSerialMock->print(num, base);
+  assert (gSerialMock() != NULL);
+  return gSerialMock()->print(num, base);
 }
 
 size_t Serial_::print(double num, int digits) {
-  if (printToCout) {
+  SerialSink sink = serialSink();
+  if (sink) {
+    return sinkDouble(sink, num, digits);
+  }
+  if (printToCout()) {
     printDouble(num, digits);
     return 0;
   }
-  assert (gSerialMock != NULL);
-  return gSerialMock->print(num, digits);
+  assert (gSerialMock() != NULL);
+  return gSerialMock()->print(num, digits);
 }
 
 size_t Serial_::println(const char *s) {
-  if (printToCout) {
+  SerialSink sink = serialSink();
+  if (sink) {
+    sink.append(s);
+    return strlen(s) + sinkNewline(sink);
+  }
+  if (printToCout()) {
     std::cout << s << std::endl;
     return 0;
   }
-  assert (gSerialMock != NULL);
-  return gSerialMock->println(s);
+  assert (gSerialMock() != NULL);
+  return gSerialMock()->println(s);
 }
 
 size_t Serial_::println(char c) {
-  if (printToCout) {
+  SerialSink sink = serialSink();
+  if (sink) {
+    sink.append(c);
+    return 1 + sinkNewline(sink);
+  }
+  if (printToCout()) {
     std::cout << c << std::endl;
     return 0;
   }
-  assert (gSerialMock != NULL);
-  return gSerialMock->println(c);
+  assert (gSerialMock() != NULL);
+  return gSerialMock()->println(c);
 }
 
 size_t Serial_::println(unsigned char c, int base) {
-  assert (gSerialMock != NULL);
-  return gSerialMock->println(c, base);
+  SerialSink sink = serialSink();
+  if (sink) {
+    const size_t n = sinkBase(sink, c, base);
+    return n + sinkNewline(sink);
+  }
+  if (printToCout()) {
+    printBase(c, base);
+    std::cout << std::endl;
+    return 0;
+  }
+  assert (gSerialMock() != NULL);
+  return gSerialMock()->println(c, base);
 }
 
 size_t Serial_::println(int num, int base) {
-  assert (gSerialMock != NULL);
-  return gSerialMock->println(num, base);
+  SerialSink sink = serialSink();
+  if (sink) {
+    const size_t n = sinkBase(sink, num, base);
+    return n + sinkNewline(sink);
+  }
+  if (printToCout()) {
+    printBase(num, base);
+    std::cout << std::endl;
+    return 0;
+  }
+  assert (gSerialMock() != NULL);
+  return gSerialMock()->println(num, base);
 }
 
 size_t Serial_::println(unsigned int num, int base) {
-  assert (gSerialMock != NULL);
-  return gSerialMock->println(num, base);
+  SerialSink sink = serialSink();
+  if (sink) {
+    const size_t n = sinkBase(sink, num, base);
+    return n + sinkNewline(sink);
+  }
+  if (printToCout()) {
+    printBase(num, base);
+    std::cout << std::endl;
+    return 0;
+  }
+  assert (gSerialMock() != NULL);
+  return gSerialMock()->println(num, base);
 }
 
 size_t Serial_::println(long num, int base) {
-  assert (gSerialMock != NULL);
-  return gSerialMock->println(num, base);
+  SerialSink sink = serialSink();
+  if (sink) {
+    const size_t n = sinkBase(sink, num, base);
+    return n + sinkNewline(sink);
+  }
+  if (printToCout()) {
+    printBase(num, base);
+    std::cout << std::endl;
+    return 0;
+  }
+  assert (gSerialMock() != NULL);
+  return gSerialMock()->println(num, base);
 }
 
 size_t Serial_::println(unsigned long num, int base) {
-  assert (gSerialMock != NULL);
-  return gSerialMock->println(num, base);
+  SerialSink sink = serialSink();
+  if (sink) {
+    const size_t n = sinkBase(sink, num, base);
+    return n + sinkNewline(sink);
+  }
+  if (printToCout()) {
+    printBase(num, base);
+    std::cout << std::endl;
+    return 0;
+  }
+  assert (gSerialMock() != NULL);
+  return gSerialMock()->println(num, base);
 }
 
 size_t Serial_::println(double num, int digits) {
-  assert (gSerialMock != NULL);
-  return gSerialMock->println(num, digits);
+  SerialSink sink = serialSink();
+  if (sink) {
+    const size_t n = sinkDouble(sink, num, digits);
+    return n + sinkNewline(sink);
+  }
+  if (printToCout()) {
+    printDouble(num, digits);
+    std::cout << std::endl;
+    return 0;
+  }
+  assert (gSerialMock() != NULL);
+  return gSerialMock()->println(num, digits);
 }
 
 size_t Serial_::println(void) {
-  if (printToCout) {
+  SerialSink sink = serialSink();
+  if (sink) {
+    return sinkNewline(sink);
+  }
+  if (printToCout()) {
     std::cout << std::endl;
     return 0;
   }
-  assert (gSerialMock != NULL);
-  return gSerialMock->println();
+  assert (gSerialMock() != NULL);
+  return gSerialMock()->println();
 }
 
 size_t Serial_::write(uint8_t val) {
-  assert (gSerialMock != NULL);
-  return gSerialMock->write(val);
+  SerialSink sink = serialSink();
+  if (sink) {
+    sink.append((char)val);
+    return 1;
+  }
+  assert (gSerialMock() != NULL);
+  return gSerialMock()->write(val);
 }
 
 size_t Serial_::write(const char *str) {
-  assert (gSerialMock != NULL);
-  return gSerialMock->write(str);
+  SerialSink sink = serialSink();
+  if (sink) {
+    sink.append(str);
+    return strlen(str);
+  }
+  assert (gSerialMock() != NULL);
+  return gSerialMock()->write(str);
 }
 
 size_t Serial_::write(const uint8_t *buffer, size_t size) {
-  assert (gSerialMock != NULL);
-  return gSerialMock->write(buffer, size);
+  SerialSink sink = serialSink();
+  if (sink) {
+    sink.append((const char*)buffer, size);
+    return size;
+  }
+  assert (gSerialMock() != NULL);
+  return gSerialMock()->write(buffer, size);
 }
 
 uint8_t Serial_::begin(uint32_t port) {
-  assert (gSerialMock != NULL);
-  return gSerialMock->begin(port);
+  if (serialPty()) {
+    return 1;
+  }
+  assert (gSerialMock() != NULL);
+  return gSerialMock()->begin(port);
 }
 
 void Serial_::flush() {
-  assert (gSerialMock != NULL);
-  gSerialMock->flush();
+  SerialPty* pty = serialPty();
+  if (pty) {
+    pty->flush();
+    return;
+  }
+  assert (gSerialMock() != NULL);
+  gSerialMock()->flush();
 }
 
 uint8_t Serial_::available() {
-  assert (gSerialMock != NULL);
-  return gSerialMock->available();
+  SerialPty* pty = serialPty();
+  if (pty) {
+    const size_t n = pty->available();
+    return n > UINT8_MAX ? UINT8_MAX : n;
+  }
+  assert (gSerialMock() != NULL);
+  return gSerialMock()->available();
 }
 
+// SerialPty::read() returns -1 when there is no data, which the uint8_t
+// result cannot carry; check available() first.
 uint8_t Serial_::read() {
-  assert (gSerialMock != NULL);
-  return gSerialMock->read();
+  SerialPty* pty = serialPty();
+  if (pty) {
+    const int c = pty->read();
+    assert (c >= 0);
+    return c;
+  }
+  assert (gSerialMock() != NULL);
+  return gSerialMock()->read();
 }
 
 uint8_t Serial_::operator [] (const uint8_t index) {
-  assert (gSerialMock != NULL);
-  return (*gSerialMock)[index];
+  SerialPty* pty = serialPty();
+  if (pty) {
+    // An index at or past available() reads as 0, not as peek()'s -1
+    const int c = pty->peek(index);
+    return c < 0 ? 0 : c;
+  }
+  assert (gSerialMock() != NULL);
+  return (*gSerialMock())[index];
 }
 
 // Preinstantiate Objects
 Serial_ Serial;
 
-void SerialFake::buffer_load(uint8_t buffer_0[], const uint8_t len) {
-    assert (len <= buffer_size);
-
-    memcpy(buffer, buffer_0, len);
-    buffer_head = 0;
-    buffer_tail = len;
+const size_t SerialFake::default_fifo_size;
+
+SerialFake::SerialFake()
+  : paced(false), baud(0), frameBits(10), rxFifo(0), txFifo(0),
+    wakeMicros(UINT64_MAX), rxOverruns(0), txStart(0), txBytes(0) {
+}
+
+void SerialFake::setPaced(bool paced, size_t rxFifo, size_t txFifo) {
+    this->paced = paced;
+    this->rxFifo = rxFifo;
+    this->txFifo = txFifo;
+}
+
+void SerialFake::setFrameBits(uint8_t bits) {
+    frameBits = bits;
+}
+
+static inline ArduinoMock* serialClock() {
+    ArduinoMock* arduinoMock = currentMockContext().arduino;
+    assert (arduinoMock != NULL);
+    return arduinoMock;
+}
+
+// Time the frames-th frame from start has its stop bit in, rounded up to
+// the next microsecond; exact over any number of frames.
+uint64_t SerialFake::frameEnd(uint64_t start, uint64_t frames) const {
+    const uint64_t bits = frames * frameBits * 1000000ULL;
+    return start + (bits + baud - 1) / baud;
+}
+
+// Moves the bytes whose stop bit is in from the line to the RX FIFO, and
+// schedules a wake-up for the next one.
+void SerialFake::receive() {
+    if (!isPaced()) {
+        return;
+    }
+    ArduinoMock* clock = serialClock();
+    const uint64_t now = clock->getMicros64();
+    while (!segments.empty()) {
+        Segment& segment = segments.front();
+        const uint64_t arrived = now < segment.start ? 0 :
+            std::min<uint64_t>(segment.length,
+                               (now - segment.start) * baud / (frameBits * 1000000ULL));
+        for (; segment.taken < arrived; segment.taken++) {
+            const uint8_t byte = wire.pop();
+            if (rxFifo && rx.size() >= rxFifo) {
+                rxOverruns++;
+            } else {
+                rx.feed(&byte, 1);
+            }
+        }
+        if (segment.taken < segment.length) {
+            const uint64_t next = frameEnd(segment.start, segment.taken + 1);
+            if (next != wakeMicros) {
+                wakeMicros = next;
+                clock->scheduleAt(next, []() {});
+            }
+            return;
+        }
+        segments.pop_front();
+    }
+}
+
+void SerialFake::buffer_load(const uint8_t buffer_0[], const size_t len) {
+    rx.clear();
+    wire.clear();
+    segments.clear();
+    feed(buffer_0, len);
+}
+
+void SerialFake::feed(const uint8_t data[], const size_t len) {
+    if (!isPaced()) {
+        rx.feed(data, len);
+        return;
+    }
+    if (len == 0) {
+        return;
+    }
+    receive();
+    uint64_t start = serialClock()->getMicros64();
+    if (!segments.empty()) {
+        Segment& last = segments.back();
+        const uint64_t end = frameEnd(last.start, last.length);
+        if (end >= start) {
+            // still sending, the new bytes follow without a gap
+            wire.feed(data, len);
+            last.length += len;
+            receive();
+            return;
+        }
+    }
+    wire.feed(data, len);
+    Segment segment = { start, len, 0 };
+    segments.push_back(segment);
+    receive();
 }
 
 uint8_t SerialFake::available() {
-    return (buffer_tail - buffer_head);
+    receive();
+    return rx.size() > UINT8_MAX ? UINT8_MAX : rx.size();
 }
 
 uint8_t SerialFake::read()
 {
-    assert(buffer_tail - buffer_head > 0);
+    receive();
+    assert(!rx.empty());
 
-    return buffer[buffer_head++];
+    return rx.pop();
 }
 
-uint8_t SerialFake::at(const uint8_t index) {
-    assert(buffer_head + index < buffer_tail);
+size_t SerialFake::read(uint8_t buffer_0[], const size_t len) {
+    receive();
+    return rx.read(buffer_0, len);
+}
 
-    return buffer[buffer_head + index];
+uint8_t SerialFake::at(const uint8_t index) {
+    receive();
+    assert(index < rx.size());
+
+    return rx.peek(index);
+}
+
+uint8_t SerialFake::begin(uint32_t baud) {
+    this->baud = baud;
+    txBytes = 0;
+    return 1;
+}
+
+size_t SerialFake::write(uint8_t val) {
+    return write(&val, 1);
+}
+
+size_t SerialFake::write(const char *str) {
+    return write((const uint8_t*)str, strlen(str));
+}
+
+size_t SerialFake::write(const uint8_t *buffer, size_t size) {
+    (void)buffer;
+    if (!isPaced() || size == 0) {
+        return size;
+    }
+    ArduinoMock* clock = serialClock();
+    const uint64_t now = clock->getMicros64();
+    if (txBytes == 0 || frameEnd(txStart, txBytes) <= now) {
+        txStart = now;  // the line was idle
+        txBytes = 0;
+    }
+    txBytes += size;
+    if (txFifo && txBytes > txFifo) {
+        // returns once the last byte fits into the FIFO
+        const uint64_t until = frameEnd(txStart, txBytes - txFifo);
+        if (until > now) {
+            clock->advanceTo(until);
+        }
+    }
+    return size;
+}
+
+void SerialFake::flush() {
+    if (!isPaced() || txBytes == 0) {
+        return;
+    }
+    ArduinoMock* clock = serialClock();
+    const uint64_t until = frameEnd(txStart, txBytes);
+    if (until > clock->getMicros64()) {
+        clock->advanceTo(until);
+    }
 }
@@ -0,0 +1,168 @@
+#include "arduino-mock/SerialCapture.h"
+#include "arduino-mock/MockContext.h"
+
+const size_t SerialCapture::first_chunk_size;
+const size_t SerialCapture::chunk_size;
+
+static inline SerialCapture*& gSerialCapture() {
+  return currentMockContext().serialCapture;
+}
+SerialCapture* serialCaptureInstance() {
+  if (!gSerialCapture()) {
+    gSerialCapture() = new SerialCapture();
+  }
+  return gSerialCapture();
+}
+
+void releaseSerialCapture() {
+  if (gSerialCapture()) {
+    delete gSerialCapture();
+    gSerialCapture() = NULL;
+  }
+}
+
+std::ostream& operator<<(std::ostream& out, const CaptureView& view) {
+  return out.write(view.data, view.length);
+}
+
+SerialCapture::SerialCapture()
+  : total(0) {
+}
+
+void SerialCapture::append(const char* data, size_t length) {
+  total += length;
+  if (!chunks.empty()) {
+    Chunk& chunk = chunks.back();
+    const size_t room = chunk.capacity - chunk.used;
+    const size_t taken = length < room ? length : room;
+    memcpy(chunk.data.get() + chunk.used, data, taken);
+    chunk.used += taken;
+    data += taken;
+    length -= taken;
+  }
+  if (length) {
+    startChunk(length);
+    Chunk& chunk = chunks.back();
+    memcpy(chunk.data.get(), data, length);
+    chunk.used = length;
+  }
+}
+
+// Adds a chunk for at least length bytes, twice the size of the last one
+// up to chunk_size
+void SerialCapture::startChunk(size_t length) {
+  size_t capacity = first_chunk_size;
+  if (!chunks.empty()) {
+    capacity = 2 * chunks.back().capacity;
+    if (capacity > chunk_size) {
+      capacity = chunks.back().capacity > chunk_size ? chunks.back().capacity
+                                                     : chunk_size;
+    }
+  }
+  Chunk next;
+  next.capacity = length > capacity ? length : capacity;
+  next.data.reset(new char[next.capacity]);
+  next.used = 0;
+  chunks.push_back(std::move(next));
+}
+
+void SerialCapture::clear() {
+  if (chunks.size() > 1) {
+    chunks.front() = std::move(chunks.back());
+    chunks.resize(1);
+  }
+  if (!chunks.empty()) {
+    chunks[0].used = 0;
+  }
+  total = 0;
+  joined.clear();
+  joinedAt.clear();
+}
+
+// Copies the bytes from firstOffset in chunk firstChunk up to lastOffset in
+// chunk lastChunk, unless the same line was joined before
+CaptureView SerialCapture::joinLine(const std::vector<size_t>& starts,
+                                    size_t firstChunk, size_t firstOffset,
+                                    size_t lastChunk, size_t lastOffset) const {
+  const size_t start = starts[firstChunk] + firstOffset;
+  const size_t length = starts[lastChunk] + lastOffset - start;
+  std::map<size_t, size_t>::const_iterator found = joinedAt.find(start);
+  if (found == joinedAt.end() || joined[found->second].size() != length) {
+    std::string line;
+    line.reserve(length);
+    for (size_t i = firstChunk; i <= lastChunk; i++) {
+      const size_t from = i == firstChunk ? firstOffset : 0;
+      const size_t to = i == lastChunk ? lastOffset : chunks[i].used;
+      line.append(chunks[i].data.get() + from, to - from);
+    }
+    // A deque never moves its elements, so earlier views stay valid
+    joined.push_back(std::move(line));
+    joinedAt[start] = joined.size() - 1;
+    found = joinedAt.find(start);
+  }
+  CaptureView view = { joined[found->second].data(), length };
+  return view;
+}
+
+std::vector<CaptureView> SerialCapture::lines() const {
+  std::vector<CaptureView> result;
+  std::vector<size_t> starts(chunks.size());
+  for (size_t i = 1; i < chunks.size(); i++) {
+    starts[i] = starts[i - 1] + chunks[i - 1].used;
+  }
+  // Where the current line starts
+  size_t lineChunk = 0;
+  size_t lineOffset = 0;
+  for (size_t i = 0; i < chunks.size(); i++) {
+    const char* begin = chunks[i].data.get();
+    const char* p = begin;
+    const char* end = begin + chunks[i].used;
+    while (p < end) {
+      const char* newline = (const char*)memchr(p, '\n', end - p);
+      if (!newline) {
+        break;
+      }
+      const size_t lineEnd = newline - begin;
+      CaptureView line;
+      if (lineChunk == i) {
+        line.data = begin + lineOffset;
+        line.length = lineEnd - lineOffset;
+      } else {
+        line = joinLine(starts, lineChunk, lineOffset, i, lineEnd);
+      }
+      if (line.length > 0 && line.data[line.length - 1] == '\r') {
+        line.length--;
+      }
+      result.push_back(line);
+      lineChunk = i;
+      lineOffset = lineEnd + 1;
+      p = newline + 1;
+    }
+    if (lineOffset == chunks[i].used && i + 1 < chunks.size()) {
+      lineChunk = i + 1;
+      lineOffset = 0;
+    }
+  }
+  if (!chunks.empty() && (lineChunk + 1 < chunks.size()
+                          || lineOffset < chunks[lineChunk].used)) {
+    const size_t last = chunks.size() - 1;
+    if (lineChunk == last) {
+      CaptureView line = { chunks[last].data.get() + lineOffset,
+                           chunks[last].used - lineOffset };
+      result.push_back(line);
+    } else {
+      result.push_back(joinLine(starts, lineChunk, lineOffset, last,
+                                chunks[last].used));
+    }
+  }
+  return result;
+}
+
+std::string SerialCapture::str() const {
+  std::string result;
+  result.reserve(total);
+  for (size_t i = 0; i < chunks.size(); i++) {
+    result.append(chunks[i].data.get(), chunks[i].used);
+  }
+  return result;
+}
@@ -0,0 +1,150 @@
+#include "arduino-mock/SerialPty.h"
+#include "arduino-mock/MockContext.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+const size_t SerialPty::rx_batch;
+const size_t SerialPty::tx_batch;
+const size_t SerialPty::tx_limit;
+
+static inline SerialPty*& gSerialPty() {
+  return currentMockContext().serialPty;
+}
+SerialPty* serialPtyInstance(const char* linkPath) {
+  if (!gSerialPty()) {
+    gSerialPty() = new SerialPty(linkPath);
+  }
+  return gSerialPty();
+}
+
+void releaseSerialPty() {
+  if (gSerialPty()) {
+    delete gSerialPty();
+    gSerialPty() = NULL;
+  }
+}
+
+SerialPty::SerialPty(const char* linkPath)
+  : master(-1), slave(-1), rx(rx_batch), txDropped(0) {
+  const int fd = posix_openpt(O_RDWR | O_NOCTTY);
+  if (fd < 0) {
+    return;
+  }
+  const char* name = NULL;
+  if (grantpt(fd) != 0 || unlockpt(fd) != 0 || !(name = ptsname(fd))) {
+    close(fd);
+    return;
+  }
+  slaveName = name;
+  // Keeping the slave side open ourselves means reads on the master return
+  // EAGAIN rather than EIO while no tool has the port open.
+  slave = open(name, O_RDWR | O_NOCTTY);
+  if (slave < 0) {
+    close(fd);
+    return;
+  }
+  struct termios tio;
+  if (tcgetattr(slave, &tio) == 0) {
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  master = fd;
+
+  if (linkPath) {
+    this->linkPath = linkPath;
+    unlink(linkPath);
+    if (symlink(name, linkPath) != 0) {
+      this->linkPath.clear();
+    }
+  }
+}
+
+SerialPty::~SerialPty() {
+  if (master >= 0) {
+    flush();
+    close(master);
+  }
+  if (slave >= 0) {
+    close(slave);
+  }
+  if (!linkPath.empty()) {
+    unlink(linkPath.c_str());
+  }
+}
+
+void SerialPty::receive() {
+  if (master < 0) {
+    return;
+  }
+  uint8_t buffer[rx_batch];
+  const ssize_t n = ::read(master, buffer, sizeof(buffer));
+  if (n > 0) {
+    rx.feed(buffer, n);
+  }
+}
+
+size_t SerialPty::available() {
+  flush();
+  if (rx.empty()) {
+    receive();
+  }
+  return rx.size();
+}
+
+int SerialPty::read() {
+  if (!available()) {
+    return -1;
+  }
+  return rx.pop();
+}
+
+size_t SerialPty::read(uint8_t* buffer, size_t length) {
+  available();
+  return rx.read(buffer, length);
+}
+
+int SerialPty::peek(size_t index) {
+  flush();
+  if (rx.size() <= index) {
+    receive();
+  }
+  return rx.size() > index ? rx.peek(index) : -1;
+}
+
+void SerialPty::write(const char* data, size_t length) {
+  if (tx.size() + length > tx_limit) {
+    flush();
+  }
+  size_t taken = length;
+  if (tx.size() + taken > tx_limit) {
+    taken = tx_limit - tx.size();
+    txDropped += length - taken;
+  }
+  tx.insert(tx.end(), data, data + taken);
+  if (tx.size() >= tx_batch || (length > 0 && data[length - 1] == '\n')) {
+    flush();
+  }
+}
+
+void SerialPty::flush() {
+  if (master < 0 || tx.empty()) {
+    return;
+  }
+  size_t sent = 0;
+  while (sent < tx.size()) {
+    const ssize_t n = ::write(master, &tx[sent], tx.size() - sent);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;  // EAGAIN: the tool is not reading, keep the rest pending
+    }
+    sent += n;
+  }
+  tx.erase(tx.begin(), tx.begin() + sent);
+}
@@ -0,0 +1,346 @@
+#include "arduino-mock/SerialReplay.h"
+#include "arduino-mock/Arduino.h"
+#include "arduino-mock/MockContext.h"
+#include "arduino-mock/SerialCapture.h"
+#include "arduino-mock/SoftwareSerial.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char replay_magic[4] = { 'A', 'M', 'S', 'R' };
+static const uint8_t replay_version = 1;
+static const size_t replay_header_size = 8;
+
+SerialReplayWriter::SerialReplayWriter(const char* path)
+  : file(fopen(path, "wb")), lastMicros(0), failed(false) {
+  if (file) {
+    uint8_t header[replay_header_size] = { 0 };
+    memcpy(header, replay_magic, sizeof(replay_magic));
+    header[4] = replay_version;
+    failed = fwrite(header, 1, sizeof(header), file) != sizeof(header);
+  }
+}
+
+SerialReplayWriter::~SerialReplayWriter() {
+  close();
+}
+
+void SerialReplayWriter::writeVarint(uint64_t value) {
+  uint8_t bytes[10];
+  size_t count = 0;
+  do {
+    bytes[count] = value & 0x7f;
+    value >>= 7;
+    if (value) {
+      bytes[count] |= 0x80;
+    }
+    count++;
+  } while (value);
+  failed |= fwrite(bytes, 1, count, file) != count;
+}
+
+void SerialReplayWriter::record(uint64_t micros, SerialDirection direction,
+                                const uint8_t* data, size_t length) {
+  if (!file) {
+    return;
+  }
+  writeVarint(micros > lastMicros ? micros - lastMicros : 0);
+  if (micros > lastMicros) {
+    lastMicros = micros;
+  }
+  failed |= fputc(direction, file) == EOF;
+  writeVarint(length);
+  failed |= fwrite(data, 1, length, file) != length;
+}
+
+bool SerialReplayWriter::close() {
+  if (file) {
+    failed |= fclose(file) != 0;
+    file = NULL;
+  }
+  return !failed;
+}
+
+struct SerialReplay::State {
+  const uint8_t* data;
+  size_t length;
+
+  Receiver receiver;
+  Cursor cursor;
+  SerialRecord pending;
+  uint64_t shift;
+  bool done;
+
+  State() : data(NULL), length(0), shift(0), done(true) {}
+  ~State() {
+    if (data) {
+      munmap((void*)data, length);
+    }
+  }
+};
+
+SerialReplay::SerialReplay(const char* path)
+  : state(new State()) {
+  const int fd = open(path, O_RDONLY);
+  if (fd >= 0) {
+    struct stat st;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= replay_header_size) {
+      void* mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapped != MAP_FAILED) {
+        state->data = (const uint8_t*)mapped;
+        state->length = st.st_size;
+        madvise(mapped, st.st_size, MADV_SEQUENTIAL);
+      }
+    }
+    close(fd);
+  }
+  if (state->data && (memcmp(state->data, replay_magic, 4) != 0
+                      || state->data[4] != replay_version)) {
+    munmap((void*)state->data, state->length);
+    state->data = NULL;
+    state->length = 0;
+  }
+  resetTx(tx);
+}
+
+SerialReplay::~SerialReplay() {
+}
+
+bool SerialReplay::isOpen() const {
+  return state->data != NULL;
+}
+
+static bool readVarint(const uint8_t* data, size_t length, size_t& offset,
+                       uint64_t& value) {
+  value = 0;
+  for (int shift = 0; shift < 64 && offset < length; shift += 7) {
+    const uint8_t byte = data[offset++];
+    value |= (uint64_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// A truncated last record, as left by a logger that lost power, ends the
+// capture.
+bool SerialReplay::next(const State& state, Cursor& cursor, SerialRecord& record) {
+  size_t offset = cursor.offset;
+  uint64_t delta;
+  uint64_t length;
+  if (!state.data
+      || !readVarint(state.data, state.length, offset, delta)
+      || offset >= state.length) {
+    return false;
+  }
+  const uint8_t direction = state.data[offset++];
+  if (!readVarint(state.data, state.length, offset, length)
+      || length > state.length - offset) {
+    return false;
+  }
+  record.micros = cursor.micros + delta;
+  record.direction = direction == SERIAL_TX ? SERIAL_TX : SERIAL_RX;
+  record.data = state.data + offset;
+  record.length = length;
+  cursor.offset = offset + length;
+  cursor.micros = record.micros;
+  return true;
+}
+
+uint64_t SerialReplay::getDurationMicros() const {
+  Cursor cursor = { replay_header_size, 0 };
+  SerialRecord record;
+  bool any = false;
+  uint64_t first = 0;
+  uint64_t last = 0;
+  while (next(*state, cursor, record)) {
+    if (!any) {
+      first = record.micros;
+      any = true;
+    }
+    last = record.micros;
+  }
+  return last - first;
+}
+
+void SerialReplay::start(Receiver receiver) {
+  ArduinoMock* arduinoMock = currentMockContext().arduino;
+  assert (arduinoMock != NULL);
+  state->receiver = receiver;
+  state->cursor.offset = replay_header_size;
+  state->cursor.micros = 0;
+  state->done = false;
+
+  Cursor peek = state->cursor;
+  SerialRecord first;
+  const uint64_t firstMicros = next(*state, peek, first) ? first.micros : 0;
+  state->shift = arduinoMock->getMicros64() - firstMicros;
+  scheduleRx(state);
+}
+
+void SerialReplay::start(SerialMock& mock) {
+  SerialMock* target = &mock;
+  start([target](const uint8_t* data, size_t length) {
+    target->mock_buffer_feed(data, length);
+  });
+}
+
+void SerialReplay::start(SoftwareSerialFake& fake) {
+  SoftwareSerialFake* target = &fake;
+  start([target](const uint8_t* data, size_t length) {
+    target->feed(data, length);
+  });
+}
+
+bool SerialReplay::isDone() const {
+  return state->done;
+}
+
+void SerialReplay::scheduleRx(const std::shared_ptr<State>& state) {
+  SerialRecord& record = state->pending;
+  while (next(*state, state->cursor, record)) {
+    if (record.direction == SERIAL_RX && record.length > 0) {
+      ArduinoMock* arduinoMock = currentMockContext().arduino;
+      assert (arduinoMock != NULL);
+      std::weak_ptr<State> weak = state;
+      arduinoMock->scheduleAt(record.micros + state->shift, [weak]() {
+        play(weak);
+      });
+      return;
+    }
+  }
+  state->done = true;
+}
+
+void SerialReplay::play(const std::weak_ptr<State>& weak) {
+  std::shared_ptr<State> state = weak.lock();
+  if (!state) {
+    return;
+  }
+  state->receiver(state->pending.data, state->pending.length);
+  scheduleRx(state);
+}
+
+void SerialReplay::resetTx(TxCheck& check) const {
+  check.cursor.offset = replay_header_size;
+  check.cursor.micros = 0;
+  check.record.length = 0;
+  check.record.micros = 0;
+  check.position = 0;
+  check.compared = 0;
+  check.mismatch = false;
+  check.extra = 0;
+}
+
+bool SerialReplay::nextTx(TxCheck& check) const {
+  while (next(*state, check.cursor, check.record)) {
+    if (check.record.direction == SERIAL_TX && check.record.length > 0) {
+      check.position = 0;
+      return true;
+    }
+  }
+  check.record.length = 0;
+  check.position = 0;
+  return false;
+}
+
+void SerialReplay::compare(TxCheck& check, const uint8_t* data, size_t length) const {
+  while (length > 0) {
+    if (check.extra > 0
+        || (check.position == check.record.length && !nextTx(check))) {
+      check.extra += length;
+      return;
+    }
+    const uint8_t* expected = check.record.data + check.position;
+    size_t n = check.record.length - check.position;
+    if (n > length) {
+      n = length;
+    }
+    if (!check.mismatch && memcmp(expected, data, n) != 0) {
+      size_t i = 0;
+      while (expected[i] == data[i]) {
+        i++;
+      }
+      check.mismatch = true;
+      check.mismatchOffset = check.compared + i;
+      check.mismatchMicros = check.record.micros;
+      check.expected = expected[i];
+      check.actual = data[i];
+    }
+    check.position += n;
+    check.compared += n;
+    data += n;
+    length -= n;
+  }
+}
+
+static std::string byteText(uint8_t byte) {
+  char text[16];
+  if (byte >= 0x20 && byte < 0x7f) {
+    snprintf(text, sizeof(text), "0x%02X '%c'", byte, byte);
+  } else {
+    snprintf(text, sizeof(text), "0x%02X", byte);
+  }
+  return text;
+}
+
+std::string SerialReplay::describe(const TxCheck& check) const {
+  char text[160];
+  if (check.mismatch) {
+    snprintf(text, sizeof(text),
+             "TX differs at byte %llu (recorded at %llu us): expected %s, got %s",
+             (unsigned long long)check.mismatchOffset,
+             (unsigned long long)check.mismatchMicros,
+             byteText(check.expected).c_str(), byteText(check.actual).c_str());
+    return text;
+  }
+  if (check.extra > 0) {
+    snprintf(text, sizeof(text), "TX has %llu bytes more than the %llu recorded",
+             (unsigned long long)check.extra, (unsigned long long)check.compared);
+    return text;
+  }
+  TxCheck rest = check;
+  uint64_t missing = 0;
+  uint64_t from = 0;
+  if (rest.position < rest.record.length) {
+    missing = rest.record.length - rest.position;
+    from = rest.record.micros;
+  }
+  while (nextTx(rest)) {
+    if (missing == 0) {
+      from = rest.record.micros;
+    }
+    missing += rest.record.length;
+  }
+  if (missing > 0) {
+    snprintf(text, sizeof(text),
+             "TX is missing %llu of %llu recorded bytes, from %llu us on",
+             (unsigned long long)missing,
+             (unsigned long long)(check.compared + missing),
+             (unsigned long long)from);
+    return text;
+  }
+  return "";
+}
+
+void SerialReplay::transmitted(const uint8_t* data, size_t length) {
+  compare(tx, data, length);
+}
+
+std::string SerialReplay::diffTx() const {
+  return describe(tx);
+}
+
+std::string SerialReplay::diffTx(const SerialCapture& capture) const {
+  TxCheck check;
+  resetTx(check);
+  for (size_t i = 0; i < capture.chunkCount(); i++) {
+    const CaptureView chunk = capture.chunk(i);
+    compare(check, (const uint8_t*)chunk.data, chunk.length);
+  }
+  return describe(check);
+}
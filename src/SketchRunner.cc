@@ -0,0 +1,114 @@
+#include "arduino-mock/SketchRunner.h"
+#include "arduino-mock/MockContext.h"
+
+#include <algorithm>
+#include <chrono>
+
+static uint64_t virtualNow() {
+  ArduinoMock* arduinoMock = currentMockContext().arduino;
+  return arduinoMock ? arduinoMock->getMicros64() : 0;
+}
+
+// Orders the heap of slowest iterations with the fastest on top, so it can
+// be replaced cheaply by a slower one.
+static bool slower(const SketchIteration& a, const SketchIteration& b) {
+  return a.wallNanos > b.wallNanos;
+}
+
+SketchStats SketchRunner::runLoops(uint64_t iterations) {
+  return run(Predicate(), iterations, false, 0);
+}
+
+SketchStats SketchRunner::runFor(time_t milliseconds) {
+  assert (currentMockContext().arduino != NULL);
+  const uint64_t deadline = virtualNow() + (uint64_t)milliseconds * 1000;
+  return run(Predicate(), UINT64_MAX, true, deadline);
+}
+
+SketchStats SketchRunner::runUntil(Predicate predicate, uint64_t maxIterations) {
+  return run(predicate, maxIterations, false, 0);
+}
+
+SketchStats SketchRunner::run(const Predicate& done, uint64_t maxIterations,
+                              bool skipIdle, uint64_t deadline) {
+  typedef std::chrono::steady_clock Clock;
+
+  if (!setupDone) {
+    setupDone = true;
+    setupFunction();
+  }
+
+  SketchStats stats;
+  stats.loops = 0;
+  std::vector<SketchIteration>& slowest = stats.slowest;
+  slowest.reserve(slowestCount + 1);
+
+  const uint64_t virtualStart = virtualNow();
+  const Clock::time_point wallStart = Clock::now();
+  Clock::time_point iterationStart = wallStart;
+
+  while (stats.loops < maxIterations) {
+    if (skipIdle && virtualNow() >= deadline) {
+      break;
+    }
+    if (done && done()) {
+      break;
+    }
+
+    const uint64_t before = virtualNow();
+    loopFunction();
+    const Clock::time_point iterationEnd = Clock::now();
+
+    SketchIteration iteration;
+    iteration.index = stats.loops++;
+    iteration.wallNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            iterationEnd - iterationStart).count();
+    iteration.startMicros = before;
+    // The bookkeeping below is charged to the next iteration, which keeps
+    // the measurement to one clock read per loop() call.
+    iterationStart = iterationEnd;
+    if (slowestCount > 0
+        && (slowest.size() < slowestCount || slower(iteration, slowest.front()))) {
+      slowest.push_back(iteration);
+      std::push_heap(slowest.begin(), slowest.end(), slower);
+      if (slowest.size() > slowestCount) {
+        std::pop_heap(slowest.begin(), slowest.end(), slower);
+        slowest.pop_back();
+      }
+    }
+
+    ArduinoMock* arduinoMock = currentMockContext().arduino;
+    if (arduinoMock && idleMicros) {
+      arduinoMock->addMicrosRaw(idleMicros);
+    } else if (skipIdle && arduinoMock && arduinoMock->getMicros64() == before) {
+      arduinoMock->advanceToNextEvent(deadline - before);
+    }
+  }
+
+  const Clock::time_point wallEnd = Clock::now();
+  stats.wallSeconds = std::chrono::duration<double>(wallEnd - wallStart).count();
+  stats.virtualMicros = virtualNow() - virtualStart;
+  stats.loopsPerSecond = stats.wallSeconds > 0 ? stats.loops / stats.wallSeconds : 0;
+  stats.virtualPerWall = stats.wallSeconds > 0
+                         ? stats.virtualMicros / 1e6 / stats.wallSeconds : 0;
+  std::sort_heap(slowest.begin(), slowest.end(), slower);
+  return stats;
+}
+
+void SketchStats::print(std::ostream& out) const {
+  out << "loops: " << loops << "\n"
+      << "wall time: " << wallSeconds << " s\n"
+      << "virtual time: " << virtualMicros / 1e6 << " s\n"
+      << "loops per second: " << loopsPerSecond << "\n"
+      << "virtual/wall: " << virtualPerWall << "\n"
+      << "slowest iterations:\n";
+  for (size_t i = 0; i < slowest.size(); i++) {
+    out << "  #" << slowest[i].index << ": " << slowest[i].wallNanos
+        << " ns at " << slowest[i].startMicros << " us\n";
+  }
+}
+
+std::ostream& operator<<(std::ostream& out, const SketchStats& stats) {
+  stats.print(out);
+  return out;
+}
@@ -1,26 +1,125 @@
-
 #include "arduino-mock/SoftwareSerial.h"
+#include "arduino-mock/MockContext.h"
+
+#include <algorithm>
+
+const size_t SoftwareSerialFake::ss_max_rx_buff;
+
+static std::shared_ptr<SoftwareSerialRegistry> softwareSerialRegistry() {
+    std::shared_ptr<SoftwareSerialRegistry>& registry = currentMockContext().softwareSerials;
+    if (!registry) {
+        registry = std::make_shared<SoftwareSerialRegistry>();
+    }
+    return registry;
+}
+
+SoftwareSerialFake::SoftwareSerialFake()
+  : registry(softwareSerialRegistry()), rxLimit(0), overflowFlag(false),
+    dropped(0), overflowed(0) {
+    registry->instances.push_back(this);
+}
+
+SoftwareSerialFake::~SoftwareSerialFake() {
+    std::vector<SoftwareSerialFake*>& instances = registry->instances;
+    instances.erase(std::remove(instances.begin(), instances.end(), this), instances.end());
+    if (registry->listener == this) {
+        registry->listener = NULL;
+    }
+    if (registry->previous == this) {
+        registry->previous = NULL;
+    }
+}
+
+SoftwareSerialFake* SoftwareSerialFake::getListener() {
+    return softwareSerialRegistry()->listener;
+}
 
-void SoftwareSerialFake::buffer_load(const uint8_t buffer_0[], const uint8_t len) {
-    assert (len <= buffer_size);
+void SoftwareSerialFake::buffer_load(const uint8_t buffer_0[], const size_t len) {
+    rx.clear();
+    rx.feed(buffer_0, len);
+}
 
-    memcpy(buffer, buffer_0, len);
-    buffer_head = 0;
-    buffer_tail = len;
+void SoftwareSerialFake::feed(const uint8_t data[], const size_t len) {
+    if (registry->listener != this) {
+        dropped += len;
+        return;
+    }
+    size_t accepted = len;
+    if (rxLimit) {
+        accepted = rx.size() < rxLimit ? std::min(len, rxLimit - rx.size()) : 0;
+    }
+    rx.feed(data, accepted);
+    if (accepted < len) {
+        overflowed += len - accepted;
+        overflowFlag = true;
+    }
 }
 
 uint8_t SoftwareSerialFake::available() {
-    return (buffer_tail - buffer_head);
+    return rx.size() > UINT8_MAX ? UINT8_MAX : rx.size();
 }
 
 uint8_t SoftwareSerialFake::read()
 {
-    assert(buffer_tail - buffer_head > 0);
+    assert(!rx.empty());
 
-    return buffer[buffer_head++];
+    return rx.pop();
 }
+
+size_t SoftwareSerialFake::read(uint8_t buffer_0[], const size_t len) {
+    return rx.read(buffer_0, len);
+}
+
 uint8_t SoftwareSerialFake::at(const uint8_t index) {
-    assert(buffer_head + index < buffer_tail);
+    assert(index < rx.size());
+
+    return rx.peek(index);
+}
+
+uint8_t SoftwareSerialFake::begin(uint32_t baud) {
+    (void)baud;
+    listen();
+    return 1;
+}
+
+void SoftwareSerialFake::end() {
+    stopListening();
+}
+
+bool SoftwareSerialFake::listen() {
+    if (registry->listener == this) {
+        return false;
+    }
+    registry->previous = registry->listener;
+    registry->listener = this;
+    overflowFlag = false;
+    return true;
+}
+
+bool SoftwareSerialFake::isListening() {
+    return registry->listener == this;
+}
+
+bool SoftwareSerialFake::stopListening() {
+    if (registry->listener != this) {
+        return false;
+    }
+    registry->listener = NULL;
+    return true;
+}
+
+bool SoftwareSerialFake::overflow() {
+    const bool flag = overflowFlag;
+    overflowFlag = false;
+    return flag;
+}
+
+void SoftwareSerialFake::restore_listener() {
+    if (registry->listener == this && registry->previous) {
+        registry->previous->listen();
+    }
+}
 
-    return buffer[buffer_head + index];
+void SoftwareSerialFake::setRxBufferSize(size_t size) {
+    rxLimit = size;
 }
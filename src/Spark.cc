@@ -1,76 +1,80 @@
 // Copyright 2014 http://switchdevice.com
 
 #include "arduino-mock/Spark.h"
+#include "arduino-mock/MockContext.h"
 
-static SparkMock* gSparkMock = NULL;
+// The mock lives in the calling thread's context, see MockContext.h
+static inline SparkMock*& gSparkMock() {
+  return currentMockContext().spark;
+}
 SparkMock* sparkMockInstance() {
-  if(!gSparkMock) {
-    gSparkMock = new SparkMock();
+  if(!gSparkMock()) {
+    gSparkMock() = new SparkMock();
   }
-  return gSparkMock;
+  return gSparkMock();
 }
 
 void releaseSparkMock() {
-  if(gSparkMock) {
-    delete gSparkMock;
-    gSparkMock = NULL;
+  if(gSparkMock()) {
+    delete gSparkMock();
+    gSparkMock() = NULL;
   }
 }
 
 void Spark_::publish(const char *eventName, const char *data) {
-  gSparkMock->publish(eventName, data);
+  gSparkMock()->publish(eventName, data);
 }
 
 void Spark_::variable(const char* name, int* p_value) {
-  gSparkMock->variable(name, p_value);
+  gSparkMock()->variable(name, p_value);
 }
 
 void Spark_::function(const char* funckey, const char* funcname) {
-  gSparkMock->function(funckey, funcname);
+  gSparkMock()->function(funckey, funcname);
 }
 
 void Spark_::subscribe(const char* name, const char* cbHandler) {
-  gSparkMock->subscribe(name, cbHandler);
+  gSparkMock()->subscribe(name, cbHandler);
 }
 
 void Spark_::connect() {
-  gSparkMock->connect();
+  gSparkMock()->connect();
 }
 
 void Spark_::disconnect() {
-  gSparkMock->disconnect();
+  gSparkMock()->disconnect();
 }
 
 bool Spark_::connected() {
-  return gSparkMock->connected();
+  return gSparkMock()->connected();
 }
 
 void Spark_::process() {
-  gSparkMock->process();
+  gSparkMock()->process();
 }
 
 char* Spark_::deviceID() {
-  return gSparkMock->deviceID();
+  return gSparkMock()->deviceID();
 }
 
 void Spark_::sleep() {
-  gSparkMock->sleep();
+  gSparkMock()->sleep();
 }
 
 void Spark_::sleep(int seconds) {
-  gSparkMock->sleep(seconds);
+  gSparkMock()->sleep(seconds);
 }
 
 void Spark_::sleep(const char* sleep_mode, int seconds) {
-  gSparkMock->sleep(sleep_mode, seconds);
+  gSparkMock()->sleep(sleep_mode, seconds);
 }
 
 void Spark_::sleep(uint16_t wakeUpPin, uint16_t edgeTriggerMode, int seconds) {
-  gSparkMock->sleep(wakeUpPin, edgeTriggerMode, seconds);
+  gSparkMock()->sleep(wakeUpPin, edgeTriggerMode, seconds);
 }
 
 void Spark_::syncTime() {
-  gSparkMock->syncTime();
+  gSparkMock()->syncTime();
 }
 
 // Preinstantiate Objects
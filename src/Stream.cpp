@@ -20,8 +20,15 @@
  parsing functions based on TextFinder library by Michael Margolis
  */
 
-#include <Arduino.h>
-#include <Stream.h>
+#include "arduino-mock/Arduino.h"
+#include "Stream.h"
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
 #define PARSE_TIMEOUT 1000  // default number of milli-seconds to wait
 #define NO_SKIP_CHAR  1  // a magic char not found in a valid ASCII numeric field
 
@@ -35,7 +42,8 @@ int Stream::timedRead() {
             return c;
         if(_timeout == 0)
             return -1;
-        yield();
+        // sleep until new data may have been scheduled, or until the timeout
+        delayUntilEvent(_timeout - (millis() - _startMillis));
     } while(millis() - _startMillis < _timeout);
     return -1;     // -1 indicates timeout
 }
@@ -50,11 +58,29 @@ int Stream::timedPeek() {
             return c;
         if(_timeout == 0)
             return -1;
-        yield();
+        // sleep until new data may have been scheduled, or until the timeout
+        delayUntilEvent(_timeout - (millis() - _startMillis));
     } while(millis() - _startMillis < _timeout);
     return -1;     // -1 indicates timeout
 }
 
+// private method to wait for the peek buffer with timeout
+// returns the number of bytes peekBuffer() points to, 0 on timeout
+size_t Stream::timedPeekAvailable() {
+    size_t avail;
+    _startMillis = millis();
+    do {
+        avail = peekAvailable();
+        if(avail > 0)
+            return avail;
+        if(_timeout == 0)
+            return 0;
+        // sleep until new data may have been scheduled, or until the timeout
+        delayUntilEvent(_timeout - (millis() - _startMillis));
+    } while(millis() - _startMillis < _timeout);
+    return peekAvailable();
+}
+
 // returns peek of the next digit in the stream or -1 if timeout
 // discards non-numeric characters
 int Stream::peekNextDigit() {
@@ -99,31 +125,246 @@ bool Stream::findUntil(const char *target, const char *terminator) {
 // search terminated if the terminator string is found
 // returns true if target string is found, false if terminated or timed out
 bool Stream::findUntil(const char *target, size_t targetLen, const char *terminator, size_t termLen) {
-    size_t index = 0;  // maximum target string length is 64k bytes!
-    size_t termIndex = 0;
+    if(terminator == NULL || termLen == 0) {
+        MultiTarget t[1] = {{target, targetLen, 0}};
+        return findMulti(t, 1) == 0;
+    }
+    MultiTarget t[2] = {{target, targetLen, 0}, {terminator, termLen, 0}};
+    return findMulti(t, 2) == 0;
+}
+
+// advances the KMP state of every target by one byte
+// fail holds the failure tables of all targets back to back
+static int findMultiStep(Stream::MultiTarget *targets, int tCount, const size_t *fail, uint8_t c) {
+    for(int i = 0; i < tCount; i++) {
+        Stream::MultiTarget &t = targets[i];
+        size_t k = t.index;
+        while(k > 0 && (uint8_t) t.str[k] != c)
+            k = fail[k - 1];
+        if((uint8_t) t.str[k] == c)
+            k++;
+        if(k == t.len)
+            return i;
+        t.index = k;
+        fail += t.len;
+    }
+    return -1;
+}
+
+int Stream::findMulti(MultiTarget *targets, int tCount) {
+    if(tCount <= 0)
+        return -1;  // nothing to find, leave the stream alone
+    size_t total = 0;
+    for(int i = 0; i < tCount; i++) {
+        if(targets[i].len == 0)
+            return i;  // an empty target is found right away
+        total += targets[i].len;
+    }
+
+    // fail[k] is the length of the longest proper prefix of str[0..k]
+    // that is also a suffix of it
+    std::unique_ptr<size_t[]> fail(new size_t[total]);
+    size_t *f = fail.get();
+    for(int i = 0; i < tCount; i++) {
+        MultiTarget &t = targets[i];
+        t.index = 0;
+        f[0] = 0;
+        size_t k = 0;
+        for(size_t j = 1; j < t.len; j++) {
+            while(k > 0 && t.str[j] != t.str[k])
+                k = f[k - 1];
+            if(t.str[j] == t.str[k])
+                k++;
+            f[j] = k;
+        }
+        f += t.len;
+    }
+
+    int found;
+    if(hasPeekBufferAPI()) {
+        size_t avail;
+        while((avail = timedPeekAvailable()) > 0) {
+            const char *data = peekBuffer();
+            for(size_t n = 0; n < avail; n++) {
+                found = findMultiStep(targets, tCount, fail.get(), (uint8_t) data[n]);
+                if(found >= 0) {
+                    peekConsume(n + 1);  // leave what follows the match in the stream
+                    return found;
+                }
+            }
+            peekConsume(avail);
+        }
+        return -1;
+    }
     int c;
+    while((c = timedRead()) >= 0) {
+        found = findMultiStep(targets, tCount, fail.get(), (uint8_t) c);
+        if(found >= 0)
+            return found;
+    }
+    return -1;
+}
 
-    if(*target == 0)
-        return true;   // return true if target is a null string
-    while((c = timedRead()) > 0) {
+int Stream::findAny(std::initializer_list<const char *> targets) {
+    std::vector<MultiTarget> t;
+    t.reserve(targets.size());
+    for(const char *target : targets)
+        t.push_back({target, strlen(target), 0});
+    return findMulti(t.data(), (int) t.size());
+}
 
-        if(c != target[index])
-            index = 0; // reset index if any char does not match
+// Scans one number a byte at a time, without allocating: integers are
+// accumulated with overflow checks, floats are collected as significant
+// digits and a decimal exponent and converted with strtof(), which rounds
+// correctly. The token has no decimal point, so the C locale does not
+// matter.
+class Stream::NumberScanner {
+public:
+    // enough significant digits that every float rounding boundary is
+    // decided exactly; the rest only count as a sticky nonzero digit
+    static const size_t maxDigits = 120;
+
+    NumberScanner(bool isFloat, char skipChar, char decimalPoint, bool inField) :
+        _isFloat(isFloat), _skipChar(skipChar), _decimalPoint(decimalPoint), _inField(inField)
+    {
+    }
 
-        if(c == target[index]) {
-            //////Serial.print("found "); Serial.write(c); Serial.print("index now"); Serial.println(index+1);
-            if(++index >= targetLen) { // return true if all chars in the target match
+    // returns false if c is not part of the number, which then ends before it;
+    // non-numeric characters before the number are taken and dropped, except
+    // in a CSV field, where only blanks are
+    bool feed(int c) {
+        if(!_started) {
+            if(c == '-') {
+                _negative = true;
+                _started = true;
                 return true;
             }
+            if((c >= '0' && c <= '9') || (_isFloat && c == _decimalPoint))
+                _started = true;
+            else
+                return !_inField || c == ' ' || c == '\t';
+        }
+        if(c == _skipChar)
+            return true;
+        if(c >= '0' && c <= '9') {
+            _empty = false;
+            if(_isFloat)
+                floatDigit(c);
+            else
+                intDigit(c - '0');
+            return true;
+        }
+        if(_isFloat && c == _decimalPoint && !_fraction) {
+            _fraction = true;
+            return true;
+        }
+        return false;
+    }
+
+    // true if no digit was seen, e.g. on timeout or an empty CSV field
+    bool empty() const { return _empty; }
+    bool overflowed() const { return _overflow; }
+
+    long longValue() const {
+        if(!_negative || _value == 0)
+            return (long) _value;
+        return -(long) (_value - 1) - 1;
+    }
+
+    float floatValue() {
+        char token[maxDigits + 16];
+        size_t len = _digits;
+        long exponent = _exponent;
+        if(len == 0)
+            return _negative ? -0.0f : 0.0f;
+        memcpy(token, _mantissa, len);
+        if(_sticky) {
+            token[len++] = '1';
+            exponent--;
+        }
+        token[len++] = 'e';
+        if(exponent < 0) {
+            token[len++] = '-';
+            exponent = -exponent;
+        }
+        char reversed[24];
+        size_t n = 0;
+        do {
+            reversed[n++] = '0' + exponent % 10;
+            exponent /= 10;
+        } while(exponent);
+        while(n)
+            token[len++] = reversed[--n];
+        token[len] = 0;
+
+        float value = strtof(token, NULL);
+        if(isinf(value))
+            _overflow = true;
+        return _negative ? -value : value;
+    }
+
+protected:
+    void intDigit(unsigned d) {
+        const unsigned long limit = _negative ? (unsigned long) LONG_MAX + 1 : (unsigned long) LONG_MAX;
+        if(_overflow || _value > (limit - d) / 10) {
+            _overflow = true;
+            _value = limit;  // saturate, but keep taking the digits
+        } else {
+            _value = _value * 10 + d;
         }
+    }
+
+    void floatDigit(int c) {
+        if(_digits == 0 && c == '0') {
+            // leading zeros only move the point
+            if(_fraction)
+                _exponent--;
+        } else if(_digits < maxDigits) {
+            _mantissa[_digits++] = (char) c;
+            if(_fraction)
+                _exponent--;
+        } else {
+            _sticky |= c != '0';
+            if(!_fraction)
+                _exponent++;
+        }
+    }
 
-        if(termLen > 0 && c == terminator[termIndex]) {
-            if(++termIndex >= termLen)
-                return false;       // return false if terminate string found before target string
-        } else
-            termIndex = 0;
+    const bool _isFloat;
+    const char _skipChar;
+    const char _decimalPoint;
+    const bool _inField;
+    bool _started = false;
+    bool _negative = false;
+    bool _fraction = false;
+    bool _empty = true;
+    bool _overflow = false;
+    unsigned long _value = 0;
+    char _mantissa[maxDigits];
+    size_t _digits = 0;
+    long _exponent = 0;
+    bool _sticky = false;
+};
+
+// feeds the stream to scanner until the number ends or the stream times out;
+// the character that ends the number is left in the stream
+void Stream::scanNumber(NumberScanner &scanner) {
+    if(hasPeekBufferAPI()) {
+        size_t avail;
+        while((avail = timedPeekAvailable()) > 0) {
+            const char *data = peekBuffer();
+            size_t n = 0;
+            while(n < avail && scanner.feed((uint8_t) data[n]))
+                n++;
+            peekConsume(n);
+            if(n < avail)
+                return;
+        }
+        return;
     }
-    return false;
+    int c;
+    while((c = timedPeek()) >= 0 && scanner.feed(c))
+        read();
 }
 
 // returns the first valid (long) integer value from the current position.
@@ -136,29 +377,10 @@ long Stream::parseInt() {
 // as above but a given skipChar is ignored
 // this allows format characters (typically commas) in values to be ignored
 long Stream::parseInt(char skipChar) {
-    boolean isNegative = false;
-    long value = 0;
-    int c;
-
-    c = peekNextDigit();
-    // ignore non numeric leading characters
-    if(c < 0)
-        return 0; // zero returned if timeout
-
-    do {
-        if(c == skipChar)
-            ; // ignore this charactor
-        else if(c == '-')
-            isNegative = true;
-        else if(c >= '0' && c <= '9')        // is c a digit?
-            value = value * 10 + c - '0';
-        read();  // consume the character we got with peek
-        c = timedPeek();
-    } while((c >= '0' && c <= '9') || c == skipChar);
-
-    if(isNegative)
-        value = -value;
-    return value;
+    NumberScanner scanner(false, skipChar, _decimalPoint, false);
+    scanNumber(scanner);
+    _parseOverflow = scanner.overflowed();
+    return scanner.longValue(); // zero returned if timeout
 }
 
 // as parseInt but returns a floating point value
@@ -169,39 +391,70 @@ float Stream::parseFloat() {
 // as above but the given skipChar is ignored
 // this allows format characters (typically commas) in values to be ignored
 float Stream::parseFloat(char skipChar) {
-    boolean isNegative = false;
-    boolean isFraction = false;
-    long value = 0;
+    NumberScanner scanner(true, skipChar, _decimalPoint, false);
+    scanNumber(scanner);
+    float value = scanner.floatValue(); // zero returned if timeout
+    _parseOverflow = scanner.overflowed();
+    return value;
+}
+
+// skips the rest of a CSV field
+// returns the delimiter or '\n' that ended it, -1 on timeout
+int Stream::skipCsvField(char delimiter) {
+    if(hasPeekBufferAPI()) {
+        size_t avail;
+        while((avail = timedPeekAvailable()) > 0) {
+            const char *data = peekBuffer();
+            for(size_t n = 0; n < avail; n++) {
+                if(data[n] == delimiter || data[n] == '\n') {
+                    peekConsume(n + 1);
+                    return (uint8_t) data[n];
+                }
+            }
+            peekConsume(avail);
+        }
+        return -1;
+    }
     int c;
-    float fraction = 1.0;
+    while((c = timedRead()) >= 0) {
+        if(c == (uint8_t) delimiter || c == '\n')
+            return c;
+    }
+    return -1;
+}
 
-    c = peekNextDigit();
-    // ignore non numeric leading characters
-    if(c < 0)
-        return 0; // zero returned if timeout
+size_t Stream::parseCsvRow(float *values, size_t count, char delimiter) {
+    size_t fields = 0;
+    int end;
+    _parseOverflow = false;
+    do {
+        NumberScanner scanner(true, NO_SKIP_CHAR, _decimalPoint, true);
+        scanNumber(scanner);
+        end = skipCsvField(delimiter);
+        if(fields == 0 && scanner.empty() && end != (uint8_t) delimiter)
+            return 0;  // blank line or timeout
+        if(fields < count)
+            values[fields++] = scanner.empty() ? NAN : scanner.floatValue();
+        _parseOverflow |= scanner.overflowed();
+    } while(end == (uint8_t) delimiter);
+    return fields;
+}
 
+size_t Stream::parseCsvRow(long *values, size_t count, char delimiter) {
+    size_t fields = 0;
+    int end;
+    _parseOverflow = false;
     do {
-        if(c == skipChar)
-            ; // ignore
-        else if(c == '-')
-            isNegative = true;
-        else if(c == '.')
-            isFraction = true;
-        else if(c >= '0' && c <= '9') {      // is c a digit?
-            value = value * 10 + c - '0';
-            if(isFraction)
-                fraction *= 0.1;
-        }
-        read();  // consume the character we got with peek
-        c = timedPeek();
-    } while((c >= '0' && c <= '9') || c == '.' || c == skipChar);
-
-    if(isNegative)
-        value = -value;
-    if(isFraction)
-        return value * fraction;
-    else
-        return value;
+        NumberScanner scanner(false, NO_SKIP_CHAR, _decimalPoint, true);
+        scanNumber(scanner);
+        end = skipCsvField(delimiter);
+        if(fields == 0 && scanner.empty() && end != (uint8_t) delimiter)
+            return 0;  // blank line or timeout
+        if(fields < count)
+            values[fields++] = scanner.longValue();
+        _parseOverflow |= scanner.overflowed();
+    } while(end == (uint8_t) delimiter);
+    return fields;
 }
 
 // read characters from stream into buffer
@@ -211,6 +464,16 @@ float Stream::parseFloat(char skipChar) {
 //
 size_t Stream::readBytes(char *buffer, size_t length) {
     size_t count = 0;
+    if(hasPeekBufferAPI()) {
+        size_t avail;
+        while(count < length && (avail = timedPeekAvailable()) > 0) {
+            size_t chunk = std::min(avail, length - count);
+            memcpy(buffer + count, peekBuffer(), chunk);
+            peekConsume(chunk);
+            count += chunk;
+        }
+        return count;
+    }
     while(count < length) {
         int c = timedRead();
         if(c < 0)
@@ -229,6 +492,24 @@ size_t Stream::readBytesUntil(char terminator, char *buffer, size_t length) {
     if(length < 1)
         return 0;
     size_t index = 0;
+    if(hasPeekBufferAPI()) {
+        size_t avail;
+        while(index < length && (avail = timedPeekAvailable()) > 0) {
+            const char* data = peekBuffer();
+            size_t chunk = std::min(avail, length - index);
+            const char* found = (const char*) memchr(data, terminator, chunk);
+            if(found) {
+                size_t before = found - data;
+                memcpy(buffer + index, data, before);
+                peekConsume(before + 1);  // the terminator is consumed too
+                return index + before;
+            }
+            memcpy(buffer + index, data, chunk);
+            peekConsume(chunk);
+            index += chunk;
+        }
+        return index;
+    }
     while(index < length) {
         int c = timedRead();
         if(c < 0 || c == terminator)
@@ -241,6 +522,16 @@ size_t Stream::readBytesUntil(char terminator, char *buffer, size_t length) {
 
 String Stream::readString() {
     String ret;
+    if(hasPeekBufferAPI()) {
+        size_t avail;
+        ret.reserve(available());
+        while((avail = timedPeekAvailable()) > 0) {
+            if(!ret.concat(peekBuffer(), avail))
+                break;  // out of memory, leave the rest in the stream
+            peekConsume(avail);
+        }
+        return ret;
+    }
     int c = timedRead();
     while(c >= 0) {
         ret += (char) c;
@@ -251,6 +542,22 @@ String Stream::readString() {
 
 String Stream::readStringUntil(char terminator) {
     String ret;
+    if(hasPeekBufferAPI()) {
+        size_t avail;
+        while((avail = timedPeekAvailable()) > 0) {
+            const char* data = peekBuffer();
+            const char* found = (const char*) memchr(data, terminator, avail);
+            size_t chunk = found ? found - data : avail;
+            if(!ret.concat(data, chunk))
+                break;
+            if(found) {
+                peekConsume(chunk + 1);
+                break;
+            }
+            peekConsume(chunk);
+        }
+        return ret;
+    }
     int c = timedRead();
     while(c >= 0 && c != terminator) {
         ret += (char) c;
@@ -258,3 +565,20 @@ String Stream::readStringUntil(char terminator) {
     }
     return ret;
 }
+
+int StreamFake::available() {
+    return rx.size() < INT_MAX ? (int) rx.size() : INT_MAX;
+}
+
+int StreamFake::read() {
+    return rx.empty() ? -1 : rx.pop();
+}
+
+int StreamFake::peek() {
+    return rx.empty() ? -1 : rx.peek(0);
+}
+
+size_t StreamFake::write(const uint8_t *buffer, size_t size) {
+    written.append((const char *) buffer, size);
+    return size;
+}
@@ -0,0 +1,205 @@
+#include "arduino-mock/StringAllocator.h"
+#include "arduino-mock/MockContext.h"
+#include "arduino-mock/EspHeap.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+const size_t PoolStringAllocator::min_class;
+const size_t PoolStringAllocator::max_class;
+const size_t PoolStringAllocator::page_size;
+const size_t PoolStringAllocator::class_count;
+const size_t ArenaStringAllocator::default_chunk_size;
+
+StringAllocator::StringAllocator()
+  : allocations(0), releases(0), bytesInUse(0) {
+}
+
+void* StringAllocator::reallocate(void* ptr, size_t oldSize, size_t newSize) {
+  if (!ptr) {
+    oldSize = 0;
+  }
+  void* result = doReallocate(ptr, oldSize, newSize);
+  if (result) {
+    allocations++;
+    bytesInUse = bytesInUse - oldSize + newSize;
+  }
+  return result;
+}
+
+void StringAllocator::release(void* ptr, size_t size) {
+  if (!ptr) {
+    return;
+  }
+  doRelease(ptr, size);
+  releases++;
+  bytesInUse -= size;
+}
+
+void StringAllocator::resetCounters() {
+  allocations = 0;
+  releases = 0;
+}
+
+void* MallocStringAllocator::doReallocate(void* ptr, size_t oldSize, size_t newSize) {
+  (void)oldSize;
+  return ptr ? espHeapRealloc(ptr, newSize) : malloc(newSize);
+}
+
+void MallocStringAllocator::doRelease(void* ptr, size_t size) {
+  (void)size;
+  espHeapFree(ptr);
+}
+
+PoolStringAllocator::PoolStringAllocator()
+  : pageUsed(page_size) {
+  for (size_t i = 0; i < class_count; i++) {
+    freeLists[i] = NULL;
+  }
+}
+
+PoolStringAllocator::~PoolStringAllocator() {
+  for (size_t i = 0; i < pages.size(); i++) {
+    free(pages[i]);
+  }
+}
+
+size_t PoolStringAllocator::classOf(size_t size) {
+  size_t index = 0;
+  for (size_t block = min_class; block <= max_class; block <<= 1, index++) {
+    if (size <= block) {
+      return index;
+    }
+  }
+  return class_count;
+}
+
+void* PoolStringAllocator::allocate(size_t size) {
+  const size_t index = classOf(size);
+  if (index == class_count) {
+    return malloc(size);
+  }
+  FreeBlock* block = freeLists[index];
+  if (block) {
+    freeLists[index] = block->next;
+    return block;
+  }
+  const size_t blockSize = min_class << index;
+  if (pageUsed + blockSize > page_size) {
+    char* page = (char*)malloc(page_size);
+    if (!page) {
+      return NULL;
+    }
+    pages.push_back(page);
+    pageUsed = 0;
+  }
+  void* result = pages.back() + pageUsed;
+  pageUsed += blockSize;
+  return result;
+}
+
+void PoolStringAllocator::deallocate(void* ptr, size_t size) {
+  const size_t index = classOf(size);
+  if (index == class_count) {
+    free(ptr);
+    return;
+  }
+  FreeBlock* block = (FreeBlock*)ptr;
+  block->next = freeLists[index];
+  freeLists[index] = block;
+}
+
+void* PoolStringAllocator::doReallocate(void* ptr, size_t oldSize, size_t newSize) {
+  const size_t oldClass = classOf(oldSize);
+  const size_t newClass = classOf(newSize);
+  if (ptr && oldClass == newClass) {
+    return oldClass == class_count ? realloc(ptr, newSize) : ptr;
+  }
+  void* result = allocate(newSize);
+  if (result && ptr) {
+    memcpy(result, ptr, std::min(oldSize, newSize));
+    deallocate(ptr, oldSize);
+  }
+  return result;
+}
+
+void PoolStringAllocator::doRelease(void* ptr, size_t size) {
+  deallocate(ptr, size);
+}
+
+ArenaStringAllocator::ArenaStringAllocator(size_t chunkSize)
+  : chunkSize(chunkSize), current(0), used(0), last(NULL) {
+}
+
+ArenaStringAllocator::~ArenaStringAllocator() {
+  for (size_t i = 0; i < chunks.size(); i++) {
+    free(chunks[i].data);
+  }
+}
+
+void ArenaStringAllocator::reset() {
+  current = 0;
+  used = 0;
+  last = NULL;
+}
+
+void* ArenaStringAllocator::allocate(size_t size) {
+  size = (size + 15) & ~(size_t)15;
+  if (chunks.empty() || used + size > chunks[current].size) {
+    // Chunks kept from before a reset() are reused; one that is too small
+    // for this buffer gets a bigger one put in front of it
+    const size_t next = chunks.empty() ? 0 : current + 1;
+    if (next == chunks.size() || chunks[next].size < size) {
+      Chunk chunk;
+      chunk.size = std::max(chunkSize, size);
+      chunk.data = (char*)malloc(chunk.size);
+      if (!chunk.data) {
+        return NULL;
+      }
+      chunks.insert(chunks.begin() + next, chunk);
+    }
+    current = next;
+    used = 0;
+  }
+  last = chunks[current].data + used;
+  used += size;
+  return last;
+}
+
+void* ArenaStringAllocator::doReallocate(void* ptr, size_t oldSize, size_t newSize) {
+  if (ptr && ptr == last) {
+    const size_t offset = last - chunks[current].data;
+    const size_t size = (newSize + 15) & ~(size_t)15;
+    if (offset + size <= chunks[current].size) {
+      used = offset + size;  // the most recent buffer grows in place
+      return ptr;
+    }
+  }
+  void* result = allocate(newSize);
+  if (result && ptr) {
+    memcpy(result, ptr, std::min(oldSize, newSize));
+  }
+  return result;
+}
+
+void ArenaStringAllocator::doRelease(void* ptr, size_t size) {
+  (void)size;
+  if (ptr == last) {
+    used = last - chunks[current].data;
+    last = NULL;
+  }
+}
+
+static thread_local MallocStringAllocator defaultStringAllocator;
+
+StringAllocator& stringAllocator() {
+  StringAllocator* allocator = currentMockContext().stringAllocator;
+  return allocator ? *allocator : defaultStringAllocator;
+}
+
+StringAllocator* setStringAllocator(StringAllocator* allocator) {
+  StringAllocator* previous = currentMockContext().stringAllocator;
+  currentMockContext().stringAllocator = allocator;
+  return previous;
+}
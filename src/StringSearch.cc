@@ -0,0 +1,371 @@
+#include "arduino-mock/StringSearch.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define STRING_SEARCH_BLOCKS 1
+typedef __m256i SearchBlock;
+static const size_t search_block_size = 32;
+static const uint32_t search_block_all = 0xffffffff;
+
+static inline SearchBlock searchLoad(const char* p) {
+  return _mm256_loadu_si256((const __m256i*)p);
+}
+static inline void searchStore(char* p, SearchBlock block) {
+  _mm256_storeu_si256((__m256i*)p, block);
+}
+static inline SearchBlock searchSplat(char c) {
+  return _mm256_set1_epi8(c);
+}
+// One bit per byte, set where a and b are equal
+static inline uint32_t searchEqual(SearchBlock a, SearchBlock b) {
+  return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b));
+}
+// Flips bit 0x20 of the bytes that are > below and < above, comparing
+// signed, so bytes >= 0x80 never match an ASCII range
+static inline SearchBlock searchFlipCase(SearchBlock block, SearchBlock below,
+                                         SearchBlock above) {
+  const SearchBlock inRange = _mm256_and_si256(_mm256_cmpgt_epi8(block, below),
+                                               _mm256_cmpgt_epi8(above, block));
+  return _mm256_xor_si256(block, _mm256_and_si256(inRange, searchSplat(0x20)));
+}
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define STRING_SEARCH_BLOCKS 1
+typedef __m128i SearchBlock;
+static const size_t search_block_size = 16;
+static const uint32_t search_block_all = 0xffff;
+
+static inline SearchBlock searchLoad(const char* p) {
+  return _mm_loadu_si128((const __m128i*)p);
+}
+static inline void searchStore(char* p, SearchBlock block) {
+  _mm_storeu_si128((__m128i*)p, block);
+}
+static inline SearchBlock searchSplat(char c) {
+  return _mm_set1_epi8(c);
+}
+static inline uint32_t searchEqual(SearchBlock a, SearchBlock b) {
+  return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(a, b));
+}
+static inline SearchBlock searchFlipCase(SearchBlock block, SearchBlock below,
+                                         SearchBlock above) {
+  const SearchBlock inRange = _mm_and_si128(_mm_cmpgt_epi8(block, below),
+                                            _mm_cmpgt_epi8(above, block));
+  return _mm_xor_si128(block, _mm_and_si128(inRange, searchSplat(0x20)));
+}
+#endif
+
+static inline char asciiLower(char c) {
+  return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+static inline char asciiUpper(char c) {
+  return c >= 'a' && c <= 'z' ? c - ('a' - 'A') : c;
+}
+
+const char* stringFindChar(const char* s, size_t length, char c) {
+  size_t i = 0;
+#ifdef STRING_SEARCH_BLOCKS
+  const SearchBlock wanted = searchSplat(c);
+  for (; i + search_block_size <= length; i += search_block_size) {
+    const uint32_t mask = searchEqual(searchLoad(s + i), wanted);
+    if (mask) {
+      return s + i + __builtin_ctz(mask);
+    }
+  }
+#endif
+  for (; i < length; i++) {
+    if (s[i] == c) {
+      return s + i;
+    }
+  }
+  return NULL;
+}
+
+const char* stringFindLastChar(const char* s, size_t length, char c) {
+  size_t end = length;
+#ifdef STRING_SEARCH_BLOCKS
+  const SearchBlock wanted = searchSplat(c);
+  for (; end >= search_block_size; end -= search_block_size) {
+    const uint32_t mask = searchEqual(searchLoad(s + end - search_block_size),
+                                      wanted);
+    if (mask) {
+      return s + end - search_block_size + (31 - __builtin_clz(mask));
+    }
+  }
+#endif
+  while (end > 0) {
+    if (s[--end] == c) {
+      return s + end;
+    }
+  }
+  return NULL;
+}
+
+// Bytes of a text, read front to back or back to front, so Two-Way can
+// search in both directions
+struct ForwardText {
+  const uint8_t* begin;
+  uint8_t operator[](size_t i) const { return begin[i]; }
+};
+
+struct ReverseText {
+  const uint8_t* end;
+  uint8_t operator[](size_t i) const { return *(end - 1 - i); }
+};
+
+static const size_t two_way_none = (size_t)-1;
+
+// Crochemore and Perrin's Two-Way algorithm: the needle is split at a
+// critical factorization, the right part is matched left to right and the
+// left part right to left, and the known period of the needle decides the
+// shift. Linear time, constant space. needleLength must be at least 1.
+// Returns the position of the first match in text order, two_way_none if
+// there is none.
+template <typename Text>
+static size_t twoWaySearch(Text h, size_t length, Text n, size_t needleLength) {
+  // Maximal suffix for < and for >; the later one gives the factorization.
+  // ip starts at -1, which the unsigned arithmetic wraps as intended.
+  size_t ip = -1;
+  size_t jp = 0;
+  size_t k = 1;
+  size_t p = 1;
+  while (jp + k < needleLength) {
+    if (n[ip + k] == n[jp + k]) {
+      if (k == p) {
+        jp += p;
+        k = 1;
+      } else {
+        k++;
+      }
+    } else if (n[ip + k] > n[jp + k]) {
+      jp += k;
+      k = 1;
+      p = jp - ip;
+    } else {
+      ip = jp++;
+      k = p = 1;
+    }
+  }
+  size_t split = ip;
+  const size_t period = p;
+
+  ip = -1;
+  jp = 0;
+  k = p = 1;
+  while (jp + k < needleLength) {
+    if (n[ip + k] == n[jp + k]) {
+      if (k == p) {
+        jp += p;
+        k = 1;
+      } else {
+        k++;
+      }
+    } else if (n[ip + k] < n[jp + k]) {
+      jp += k;
+      k = 1;
+      p = jp - ip;
+    } else {
+      ip = jp++;
+      k = p = 1;
+    }
+  }
+  if (ip + 1 > split + 1) {
+    split = ip;
+  } else {
+    p = period;
+  }
+
+  // For a periodic needle, the part matched before a shift by the period is
+  // known to match again; otherwise shift past the larger half.
+  bool periodic = true;
+  for (size_t i = 0; i < split + 1; i++) {
+    if (n[i] != n[i + p]) {
+      periodic = false;
+      break;
+    }
+  }
+  size_t remembered;
+  if (!periodic) {
+    remembered = 0;
+    p = (split > needleLength - split - 1 ? split : needleLength - split - 1) + 1;
+  } else {
+    remembered = needleLength - p;
+  }
+
+  size_t pos = 0;
+  size_t memory = 0;
+  while (length - pos >= needleLength) {
+    size_t i = split + 1 > memory ? split + 1 : memory;
+    while (i < needleLength && n[i] == h[pos + i]) {
+      i++;
+    }
+    if (i < needleLength) {
+      pos += i - split;
+      memory = 0;
+      continue;
+    }
+    i = split + 1;
+    while (i > memory && n[i - 1] == h[pos + i - 1]) {
+      i--;
+    }
+    if (i <= memory) {
+      return pos;
+    }
+    pos += p;
+    memory = remembered;
+  }
+  return two_way_none;
+}
+
+static const char* twoWayFind(const char* haystack, size_t length,
+                              const char* needle, size_t needleLength) {
+  const ForwardText h = { (const uint8_t*)haystack };
+  const ForwardText n = { (const uint8_t*)needle };
+  const size_t pos = twoWaySearch(h, length, n, needleLength);
+  return pos == two_way_none ? NULL : haystack + pos;
+}
+
+// The first match of the reversed needle in the reversed haystack is the
+// last match of the needle
+static const char* twoWayFindLast(const char* haystack, size_t length,
+                                  const char* needle, size_t needleLength) {
+  const ReverseText h = { (const uint8_t*)haystack + length };
+  const ReverseText n = { (const uint8_t*)needle + needleLength };
+  const size_t pos = twoWaySearch(h, length, n, needleLength);
+  return pos == two_way_none ? NULL : haystack + length - pos - needleLength;
+}
+
+const char* stringFind(const char* haystack, size_t length,
+                       const char* needle, size_t needleLength) {
+  if (needleLength == 0) {
+    return haystack;
+  }
+  if (needleLength > length) {
+    return NULL;
+  }
+  if (needleLength == 1) {
+    return stringFindChar(haystack, length, needle[0]);
+  }
+  size_t i = 0;
+#ifdef STRING_SEARCH_BLOCKS
+  // Positions i .. i + block size - 1 at a time; a candidate has the first
+  // and the last byte of the needle in place. Bytes compared on false
+  // candidates are counted, and once they outgrow the bytes scanned the
+  // Two-Way search takes over, which keeps the worst case linear.
+  const SearchBlock first = searchSplat(needle[0]);
+  const SearchBlock last = searchSplat(needle[needleLength - 1]);
+  size_t wasted = 0;
+  for (; i + search_block_size + needleLength - 1 <= length;
+       i += search_block_size) {
+    uint32_t mask = searchEqual(searchLoad(haystack + i), first)
+                    & searchEqual(searchLoad(haystack + i + needleLength - 1), last);
+    while (mask) {
+      const char* candidate = haystack + i + __builtin_ctz(mask);
+      if (memcmp(candidate + 1, needle + 1, needleLength - 2) == 0) {
+        return candidate;
+      }
+      wasted += needleLength;
+      mask &= mask - 1;
+    }
+    if (wasted > 2 * i + 256) {
+      i += search_block_size;
+      break;
+    }
+  }
+#endif
+  return twoWayFind(haystack + i, length - i, needle, needleLength);
+}
+
+const char* stringFindLast(const char* haystack, size_t length,
+                           const char* needle, size_t needleLength) {
+  if (needleLength == 0) {
+    return haystack + length;
+  }
+  if (needleLength > length) {
+    return NULL;
+  }
+  if (needleLength == 1) {
+    return stringFindLastChar(haystack, length, needle[0]);
+  }
+  // Candidates are the positions [0, end)
+  size_t end = length - needleLength + 1;
+#ifdef STRING_SEARCH_BLOCKS
+  // The block filter of stringFind, walking back from the end
+  const SearchBlock first = searchSplat(needle[0]);
+  const SearchBlock last = searchSplat(needle[needleLength - 1]);
+  const size_t candidates = end;
+  size_t wasted = 0;
+  while (end >= search_block_size) {
+    const size_t i = end - search_block_size;
+    uint32_t mask = searchEqual(searchLoad(haystack + i), first)
+                    & searchEqual(searchLoad(haystack + i + needleLength - 1), last);
+    while (mask) {
+      const int bit = 31 - __builtin_clz(mask);
+      const char* candidate = haystack + i + bit;
+      if (memcmp(candidate + 1, needle + 1, needleLength - 2) == 0) {
+        return candidate;
+      }
+      wasted += needleLength;
+      mask &= ~(1u << bit);
+    }
+    end = i;
+    if (wasted > 2 * (candidates - end) + 256) {
+      break;
+    }
+  }
+#endif
+  return twoWayFindLast(haystack, end + needleLength - 1, needle, needleLength);
+}
+
+bool stringEqualsIgnoreCase(const char* a, const char* b, size_t length) {
+  size_t i = 0;
+#ifdef STRING_SEARCH_BLOCKS
+  const SearchBlock below = searchSplat('A' - 1);
+  const SearchBlock above = searchSplat('Z' + 1);
+  for (; i + search_block_size <= length; i += search_block_size) {
+    const SearchBlock x = searchFlipCase(searchLoad(a + i), below, above);
+    const SearchBlock y = searchFlipCase(searchLoad(b + i), below, above);
+    if (searchEqual(x, y) != search_block_all) {
+      return false;
+    }
+  }
+#endif
+  for (; i < length; i++) {
+    if (asciiLower(a[i]) != asciiLower(b[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void stringToLower(char* s, size_t length) {
+  size_t i = 0;
+#ifdef STRING_SEARCH_BLOCKS
+  const SearchBlock below = searchSplat('A' - 1);
+  const SearchBlock above = searchSplat('Z' + 1);
+  for (; i + search_block_size <= length; i += search_block_size) {
+    searchStore(s + i, searchFlipCase(searchLoad(s + i), below, above));
+  }
+#endif
+  for (; i < length; i++) {
+    s[i] = asciiLower(s[i]);
+  }
+}
+
+void stringToUpper(char* s, size_t length) {
+  size_t i = 0;
+#ifdef STRING_SEARCH_BLOCKS
+  const SearchBlock below = searchSplat('a' - 1);
+  const SearchBlock above = searchSplat('z' + 1);
+  for (; i + search_block_size <= length; i += search_block_size) {
+    searchStore(s + i, searchFlipCase(searchLoad(s + i), below, above));
+  }
+#endif
+  for (; i < length; i++) {
+    s[i] = asciiUpper(s[i]);
+  }
+}
@@ -21,9 +21,14 @@
  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
-#include <Arduino.h>
-#include "WString.h"
-#include "stdlib_noniso.h"
+#include "arduino-mock/Arduino.h"
+#include "include/WString.h"
+#include "include/stdlib_noniso.h"
+#include "arduino-mock/StringAllocator.h"
+#include "arduino-mock/StringSearch.h"
+
+#include <assert.h>
+#include <float.h>
 
 /*********************************************/
 /*  Constructors                             */
@@ -108,15 +113,19 @@ String::String(unsigned long value, unsigned char base) {
     *this = buf;
 }
 
+// dtostrf() prints the integer part in full, up to 309 digits for a double,
+// besides the sign, the point, up to 255 decimals and the NUL
+#define DTOSTRF_BUFFER_SIZE (DBL_MAX_10_EXP + 1 + 3 + 255 + 1)
+
 String::String(float value, unsigned char decimalPlaces) {
     init();
-    char buf[33];
+    char buf[DTOSTRF_BUFFER_SIZE];
     *this = dtostrf(value, (decimalPlaces + 2), decimalPlaces, buf);
 }
 
 String::String(double value, unsigned char decimalPlaces) {
     init();
-    char buf[33];
+    char buf[DTOSTRF_BUFFER_SIZE];
     *this = dtostrf(value, (decimalPlaces + 2), decimalPlaces, buf);
 }
 
@@ -134,9 +143,11 @@ inline void String::init(void) {
     wbuffer()[0] = 0;
 }
 
+// Heap buffers come from the current StringAllocator, which is told the
+// size of each buffer it gets back: capacity() plus the terminating NUL.
 void String::invalidate(void) {
     if(!isSSO() && wbuffer())
-        free(wbuffer());
+        stringAllocator().release(wbuffer(), capacity() + 1);
     init();
 }
 
@@ -164,7 +175,7 @@ unsigned char String::changeBuffer(unsigned int maxStrLen) {
             // Using bufptr, need to shrink into sso.buff
             char temp[sizeof(sso.buff)];
             memcpy(temp, buffer(), maxStrLen);
-            free(wbuffer());
+            stringAllocator().release(wbuffer(), capacity() + 1);
             uint16_t oldLen = len();
             setSSO(true);
             setLen(oldLen);
@@ -179,7 +190,7 @@ unsigned char String::changeBuffer(unsigned int maxStrLen) {
         return false;
     }
     uint16_t oldLen = len();
-    char *newbuffer = (char *) realloc(isSSO() ? nullptr : wbuffer(), newSize);
+    char *newbuffer = (char *) stringAllocator().reallocate(isSSO() ? nullptr : wbuffer(), capacity() + 1, newSize);
     if (newbuffer) {
         size_t oldSize = capacity() + 1; // include NULL.
         if (isSSO()) {
@@ -233,7 +244,7 @@ void String::move(String &rhs) {
             return;
         } else {
             if (!isSSO()) {
-                free(wbuffer());
+                stringAllocator().release(wbuffer(), capacity() + 1);
                 setBuffer(nullptr);
             }
         }
@@ -329,7 +340,7 @@ unsigned char String::concat(const char *cstr, unsigned int length) {
         return 1;
     if (!reserve(newlen))
         return 0;
-    memmove_P(wbuffer() + len(), cstr, length + 1);
+    memmove_P(wbuffer() + len(), cstr, length);
     setLen(newlen);
     wbuffer()[newlen] = 0;
     return 1;
@@ -349,45 +360,31 @@ unsigned char String::concat(char c) {
 }
 
 unsigned char String::concat(unsigned char num) {
-    char buf[1 + 3 * sizeof(unsigned char)];
-    sprintf(buf, "%d", num);
-    return concat(buf, strlen(buf));
+    return concatAll(num);
 }
 
 unsigned char String::concat(int num) {
-    char buf[2 + 3 * sizeof(int)];
-    sprintf(buf, "%d", num);
-    return concat(buf, strlen(buf));
+    return concatAll(num);
 }
 
 unsigned char String::concat(unsigned int num) {
-    char buf[1 + 3 * sizeof(unsigned int)];
-    utoa(num, buf, 10);
-    return concat(buf, strlen(buf));
+    return concatAll(num);
 }
 
 unsigned char String::concat(long num) {
-    char buf[2 + 3 * sizeof(long)];
-    sprintf(buf, "%ld", num);
-    return concat(buf, strlen(buf));
+    return concatAll(num);
 }
 
 unsigned char String::concat(unsigned long num) {
-    char buf[1 + 3 * sizeof(unsigned long)];
-    ultoa(num, buf, 10);
-    return concat(buf, strlen(buf));
+    return concatAll(num);
 }
 
 unsigned char String::concat(float num) {
-    char buf[20];
-    char* string = dtostrf(num, 4, 2, buf);
-    return concat(string, strlen(string));
+    return concatAll(num);
 }
 
 unsigned char String::concat(double num) {
-    char buf[20];
-    char* string = dtostrf(num, 4, 2, buf);
-    return concat(string, strlen(string));
+    return concatAll(num);
 }
 
 unsigned char String::concat(const __FlashStringHelper * str) {
@@ -405,82 +402,134 @@ unsigned char String::concat(const __FlashStringHelper * str) {
 /*  Concatenate                              */
 /*********************************************/
 
+size_t String::sumLength(const String &s) {
+    return s.buffer() ? s.len() : CAPACITY_MAX + 1;
+}
+
+size_t String::sumLength(const char *cstr) {
+    return cstr ? strlen(cstr) : CAPACITY_MAX + 1;
+}
+
+size_t String::sumLength(int num) {
+    return sumLength((long)num);
+}
+
+size_t String::sumLength(long num) {
+    return num < 0 ? 1 + sumDigits(0UL - (unsigned long)num) : sumDigits(num);
+}
+
+// dtostrf(num, 4, 2) prints the integer part in full: count its digits,
+// plus one for rounding up to the next power of ten, the sign, the point
+// and two decimals. NaN and infinity print shorter than that.
+size_t String::sumLength(double num) {
+    double magnitude = num < 0 ? -num : num;
+    size_t digits = 1;
+    while (magnitude >= 10 && digits < 310) {
+        magnitude /= 10;
+        digits++;
+    }
+    return digits + 5;
+}
+
+size_t String::sumLength(const __FlashStringHelper *str) {
+    return str ? strlen_P((PGM_P)str) : CAPACITY_MAX + 1;
+}
+
+size_t String::sumDigits(unsigned long num) {
+    size_t digits = 1;
+    while (num >= 10) {
+        num /= 10;
+        digits++;
+    }
+    return digits;
+}
+
+// s may be *this: its length is only updated once everything is written,
+// and the copy goes behind the old end
+char *String::sumWrite(char *out, const String &s) {
+    memmove_P(out, s.buffer(), s.len());
+    return out + s.len();
+}
+
+char *String::sumWrite(char *out, const char *cstr) {
+    size_t length = strlen(cstr);
+    memmove_P(out, cstr, length);
+    return out + length;
+}
+
+char *String::sumWrite(char *out, long num) {
+    if (num < 0) {
+        *out++ = '-';
+        return sumWriteDigits(out, 0UL - (unsigned long)num);
+    }
+    return sumWriteDigits(out, num);
+}
+
+char *String::sumWrite(char *out, double num) {
+    dtostrf(num, 4, 2, out);
+    size_t length = strlen(out);
+    assert(length <= sumLength(num));  // or the reserved space overflowed
+    return out + length;
+}
+
+char *String::sumWrite(char *out, const __FlashStringHelper *str) {
+    size_t length = strlen_P((PGM_P)str);
+    memcpy_P(out, (PGM_P)str, length);
+    return out + length;
+}
+
+char *String::sumWriteDigits(char *out, unsigned long num) {
+    char *end = out + sumDigits(num);
+    char *digit = end;
+    do {
+        *--digit = '0' + num % 10;
+        num /= 10;
+    } while (num);
+    return end;
+}
+
 StringSumHelper & operator +(const StringSumHelper &lhs, const String &rhs) {
-    StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
-    if (!a.concat(rhs.buffer(), rhs.len()))
-        a.invalidate();
-    return a;
+    return const_cast<StringSumHelper&>(lhs).append(rhs);
 }
 
 StringSumHelper & operator +(const StringSumHelper &lhs, const char *cstr) {
-    StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
-    if (!cstr || !a.concat(cstr, strlen(cstr)))
-        a.invalidate();
-    return a;
+    return const_cast<StringSumHelper&>(lhs).append(cstr);
 }
 
 StringSumHelper & operator +(const StringSumHelper &lhs, char c) {
-    StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
-    if (!a.concat(c))
-        a.invalidate();
-    return a;
+    return const_cast<StringSumHelper&>(lhs).append(c);
 }
 
 StringSumHelper & operator +(const StringSumHelper &lhs, unsigned char num) {
-    StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
-    if (!a.concat(num))
-        a.invalidate();
-    return a;
+    return const_cast<StringSumHelper&>(lhs).append(num);
 }
 
 StringSumHelper & operator +(const StringSumHelper &lhs, int num) {
-    StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
-    if (!a.concat(num))
-        a.invalidate();
-    return a;
+    return const_cast<StringSumHelper&>(lhs).append(num);
 }
 
 StringSumHelper & operator +(const StringSumHelper &lhs, unsigned int num) {
-    StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
-    if (!a.concat(num))
-        a.invalidate();
-    return a;
+    return const_cast<StringSumHelper&>(lhs).append(num);
 }
 
 StringSumHelper & operator +(const StringSumHelper &lhs, long num) {
-    StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
-    if (!a.concat(num))
-        a.invalidate();
-    return a;
+    return const_cast<StringSumHelper&>(lhs).append(num);
 }
 
 StringSumHelper & operator +(const StringSumHelper &lhs, unsigned long num) {
-    StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
-    if (!a.concat(num))
-        a.invalidate();
-    return a;
+    return const_cast<StringSumHelper&>(lhs).append(num);
 }
 
 StringSumHelper & operator +(const StringSumHelper &lhs, float num) {
-    StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
-    if (!a.concat(num))
-        a.invalidate();
-    return a;
+    return const_cast<StringSumHelper&>(lhs).append(num);
 }
 
 StringSumHelper & operator +(const StringSumHelper &lhs, double num) {
-    StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
-    if (!a.concat(num))
-        a.invalidate();
-    return a;
+    return const_cast<StringSumHelper&>(lhs).append(num);
 }
 
-StringSumHelper & operator + (const StringSumHelper &lhs, const __FlashStringHelper *rhs)
-{
-    StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
-    if (!a.concat(rhs))
-        a.invalidate();
-    return a;
+StringSumHelper & operator +(const StringSumHelper &lhs, const __FlashStringHelper *rhs) {
+    return const_cast<StringSumHelper&>(lhs).append(rhs);
 }
 
 // /*********************************************/
@@ -533,13 +582,7 @@ unsigned char String::equalsIgnoreCase(const String &s2) const {
         return 0;
     if (len() == 0)
         return 1;
-    const char *p1 = buffer();
-    const char *p2 = s2.buffer();
-    while (*p1) {
-        if (tolower(*p1++) != tolower(*p2++))
-            return 0;
-    }
-    return 1;
+    return stringEqualsIgnoreCase(buffer(), s2.buffer(), len());
 }
 
 unsigned char String::equalsConstantTime(const String &s2) const {
@@ -578,13 +621,13 @@ unsigned char String::startsWith(const String &s2) const {
 unsigned char String::startsWith(const String &s2, unsigned int offset) const {
     if(offset > (unsigned)(len() - s2.len()) || !buffer() || !s2.buffer())
         return 0;
-    return strncmp(&buffer()[offset], s2.buffer(), s2.len()) == 0;
+    return memcmp(&buffer()[offset], s2.buffer(), s2.len()) == 0;
 }
 
 unsigned char String::endsWith(const String &s2) const {
     if(len() < s2.len() || !buffer() || !s2.buffer())
         return 0;
-    return strcmp(&buffer()[len() - s2.len()], s2.buffer()) == 0;
+    return memcmp(&buffer()[len() - s2.len()], s2.buffer(), s2.len()) == 0;
 }
 
 // /*********************************************/
@@ -640,7 +683,7 @@ int String::indexOf(char c) const {
 int String::indexOf(char ch, unsigned int fromIndex) const {
     if (fromIndex >= len())
         return -1;
-    const char* temp = strchr(buffer() + fromIndex, ch);
+    const char* temp = stringFindChar(buffer() + fromIndex, len() - fromIndex, ch);
     if (temp == NULL)
         return -1;
     return temp - buffer();
@@ -653,7 +696,7 @@ int String::indexOf(const String &s2) const {
 int String::indexOf(const String &s2, unsigned int fromIndex) const {
     if (fromIndex >= len())
         return -1;
-    const char *found = strstr(buffer() + fromIndex, s2.buffer());
+    const char *found = stringFind(buffer() + fromIndex, len() - fromIndex, s2.buffer(), s2.len());
     if (found == NULL)
         return -1;
     return found - buffer();
@@ -666,10 +709,7 @@ int String::lastIndexOf(char theChar) const {
 int String::lastIndexOf(char ch, unsigned int fromIndex) const {
     if (fromIndex >= len())
         return -1;
-    char tempchar = buffer()[fromIndex + 1];
-    wbuffer()[fromIndex + 1] = '\0';
-    char* temp = strrchr(wbuffer(), ch);
-    wbuffer()[fromIndex + 1] = tempchar;
+    const char* temp = stringFindLastChar(buffer(), fromIndex + 1, ch);
     if (temp == NULL)
         return -1;
     return temp - buffer();
@@ -684,15 +724,12 @@ int String::lastIndexOf(const String &s2, unsigned int fromIndex) const {
         return -1;
     if (fromIndex >= len())
         fromIndex = len() - 1;
-    int found = -1;
-    for (char *p = wbuffer(); p <= wbuffer() + fromIndex; p++) {
-        p = strstr(p, s2.buffer());
-        if (!p)
-            break;
-        if ((unsigned int) (p - wbuffer()) <= fromIndex)
-            found = p - buffer();
-    }
-    return found;
+    // a match may start at fromIndex and run past it
+    unsigned int searched = fromIndex + s2.len() < len() ? fromIndex + s2.len() : len();
+    const char *found = stringFindLast(buffer(), searched, s2.buffer(), s2.len());
+    if (found == NULL)
+        return -1;
+    return found - buffer();
 }
 
 String String::substring(unsigned int left, unsigned int right) const {
@@ -757,19 +794,99 @@ void String::replace(const String& find, const String& replace) {
         }
         if (size == len())
             return;
-        if (size > capacity() && !changeBuffer(size))
+        if (size > CAPACITY_MAX || (size > capacity() && !changeBuffer(size)))
             return; // XXX: tell user!
-        int index = len() - 1;
-        while (index >= 0 && (index = lastIndexOf(find, index)) >= 0) {
-            readFrom = wbuffer() + index + find.len();
-            memmove_P(readFrom + diff, readFrom, len() - (readFrom - buffer()));
-            int newLen = len() + diff;
-            memmove_P(wbuffer() + index, replace.buffer(), replace.len());
-            setLen(newLen);
-            wbuffer()[newLen] = 0;
-            index--;
+        // Move the text to the end of the buffer and build the result from
+        // the front in one sweep. The output never gets ahead of the input,
+        // as it only grows by diff per match.
+        unsigned int shift = size - len();
+        char *writeTo = wbuffer();
+        readFrom = wbuffer() + shift;
+        memmove_P(readFrom, wbuffer(), len() + 1);
+        while ((foundAt = strstr(readFrom, find.buffer())) != NULL) {
+            unsigned int n = foundAt - readFrom;
+            memmove_P(writeTo, readFrom, n);
+            writeTo += n;
+            memmove_P(writeTo, replace.buffer(), replace.len());
+            writeTo += replace.len();
+            readFrom = foundAt + find.len();
+        }
+        memmove_P(writeTo, readFrom, strlen(readFrom) + 1);
+        setLen(size);
+    }
+}
+
+// index of the first replacement whose find string starts at s, or -1
+static int replacementAt(const char *s, size_t remaining, const StringReplacement *replacements, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        const char *find = replacements[i].find;
+        if (!find || find[0] != s[0])
+            continue;
+        size_t findLen = strlen(find);
+        if (findLen <= remaining && memcmp(s, find, findLen) == 0)
+            return i;
+    }
+    return -1;
+}
+
+void String::replaceAll(const StringReplacement *replacements, size_t count) {
+    if (len() == 0 || count == 0)
+        return;
+    bool first[256] = { false };
+    for (size_t i = 0; i < count; i++) {
+        if (replacements[i].find && replacements[i].find[0])
+            first[(unsigned char)replacements[i].find[0]] = true;
+    }
+
+    // First pass: the size of the result, and how far the output of a
+    // sweep from the front would get ahead of the input at most
+    const char *text = buffer();
+    const size_t length = len();
+    long diff = 0;
+    long ahead = 0;
+    size_t matches = 0;
+    for (size_t i = 0; i < length; ) {
+        int match = first[(unsigned char)text[i]] ? replacementAt(text + i, length - i, replacements, count) : -1;
+        if (match < 0) {
+            i++;
+            continue;
         }
+        size_t findLen = strlen(replacements[match].find);
+        size_t replaceLen = replacements[match].replace ? strlen(replacements[match].replace) : 0;
+        diff += (long)replaceLen - (long)findLen;
+        if (diff > ahead)
+            ahead = diff;
+        i += findLen;
+        matches++;
     }
+    if (matches == 0)
+        return;
+    size_t size = length + diff;
+    if (length + ahead > CAPACITY_MAX || (length + ahead > capacity() && !changeBuffer(length + ahead)))
+        return; // XXX: tell user!
+
+    // Second pass: the text moves up by ahead bytes and the result is built
+    // from the front, so it never overwrites input that is still unread
+    char *out = wbuffer();
+    const char *in = out + ahead;
+    memmove_P(out + ahead, out, length);
+    const char *end = in + length;
+    while (in < end) {
+        int match = first[(unsigned char)*in] ? replacementAt(in, end - in, replacements, count) : -1;
+        if (match < 0) {
+            *out++ = *in++;
+            continue;
+        }
+        const char *replace = replacements[match].replace;
+        if (replace) {
+            size_t replaceLen = strlen(replace);
+            memmove_P(out, replace, replaceLen);
+            out += replaceLen;
+        }
+        in += strlen(replacements[match].find);
+    }
+    setLen(size);
+    wbuffer()[size] = 0;
 }
 
 void String::remove(unsigned int index) {
@@ -799,17 +916,13 @@ void String::remove(unsigned int index, unsigned int count) {
 void String::toLowerCase(void) {
     if (!buffer())
         return;
-    for (char *p = wbuffer(); *p; p++) {
-        *p = tolower(*p);
-    }
+    stringToLower(wbuffer(), len());
 }
 
 void String::toUpperCase(void) {
     if (!buffer())
         return;
-    for (char *p = wbuffer(); *p; p++) {
-        *p = toupper(*p);
-    }
+    stringToUpper(wbuffer(), len());
 }
 
 void String::trim(void) {
@@ -1,94 +1,98 @@
 #include "arduino-mock/WiFi.h"
+#include "arduino-mock/MockContext.h"
 
-static WiFiMock* p_WiFiMock = NULL;
+// The mock lives in the calling thread's context, see MockContext.h
+static inline WiFiMock*& p_WiFiMock() {
+  return currentMockContext().wifi;
+}
 WiFiMock* WiFiMockInstance() {
-  if (!p_WiFiMock) {
-    p_WiFiMock = new WiFiMock();
+  if (!p_WiFiMock()) {
+    p_WiFiMock() = new WiFiMock();
   }
-  return p_WiFiMock;
+  return p_WiFiMock();
 }
 
 void releaseWiFiMock() {
-  if (p_WiFiMock) {
-    delete p_WiFiMock;
-    p_WiFiMock = NULL;
+  if (p_WiFiMock()) {
+    delete p_WiFiMock();
+    p_WiFiMock() = NULL;
   }
 }
 
 void WiFi_::on() {
-  p_WiFiMock->on();
+  p_WiFiMock()->on();
 }
 
 void WiFi_::off() {
-  p_WiFiMock->off();
+  p_WiFiMock()->off();
 }
 
 void WiFi_::connect() {
-  p_WiFiMock->connect();
+  p_WiFiMock()->connect();
 }
 
 void WiFi_::disconnect() {
-  p_WiFiMock->disconnect();
+  p_WiFiMock()->disconnect();
 }
 
 bool WiFi_::connecting() {
-  return p_WiFiMock->connecting();
+  return p_WiFiMock()->connecting();
 }
 
 bool WiFi_::ready() {
-  return p_WiFiMock->ready();
+  return p_WiFiMock()->ready();
 }
 
 void WiFi_::listen() {
-  p_WiFiMock->listen();
+  p_WiFiMock()->listen();
 }
 
 bool WiFi_::listening() {
-  return p_WiFiMock->listening();
+  return p_WiFiMock()->listening();
 }
 
 void WiFi_::setCredentials() {
-  p_WiFiMock->setCredentials();
+  p_WiFiMock()->setCredentials();
 }
 
 bool WiFi_::clearCredentials() {
-  return p_WiFiMock->clearCredentials();
+  return p_WiFiMock()->clearCredentials();
 }
 
 bool WiFi_::hasCredentials() {
-  return p_WiFiMock->hasCredentials();
+  return p_WiFiMock()->hasCredentials();
 }
 
 uint8_t WiFi_::macAddress() {
-  return p_WiFiMock->macAddress();
+  return p_WiFiMock()->macAddress();
 }
 
 char* WiFi_::SSID() {
-  return p_WiFiMock->SSID();
+  return p_WiFiMock()->SSID();
 }
 
 int WiFi_::RSSI() {
-  return p_WiFiMock->RSSI();
+  return p_WiFiMock()->RSSI();
 }
 
 void WiFi_::ping(char* a) {
-  p_WiFiMock->ping(a);
+  p_WiFiMock()->ping(a);
 }
 
 void WiFi_::ping(char* a, uint8_t b) {
-  p_WiFiMock->ping(a, b);
+  p_WiFiMock()->ping(a, b);
 }
 
 char* WiFi_::localIP() {
-  return p_WiFiMock->localIP();
+  return p_WiFiMock()->localIP();
 }
 
 char* WiFi_::subnetMask() {
-  return p_WiFiMock->subnetMask();
+  return p_WiFiMock()->subnetMask();
 }
 
 char* WiFi_::gatewayIP() {
-  return p_WiFiMock->gatewayIP();
+  return p_WiFiMock()->gatewayIP();
 }
 
 // Preinstantiate Objects
@@ -298,7 +298,7 @@ size_t WiFiClient::peekBytes(uint8_t *buffer, size_t length) {
 
     _startMillis = millis();
     while((available() < (int) length) && ((millis() - _startMillis) < _timeout)) {
-        yield();
+        delayUntilEvent(_timeout - (millis() - _startMillis));
     }
 
     if(available() < (int) length) {
@@ -310,6 +310,35 @@ size_t WiFiClient::peekBytes(uint8_t *buffer, size_t length) {
     return _client->peekBytes((char *)buffer, count);
 }
 
+bool WiFiClient::hasPeekBufferAPI() const
+{
+    return true;
+}
+
+size_t WiFiClient::peekAvailable()
+{
+    if (!_client)
+        return 0;
+
+    size_t result = _client->peekAvailable();
+
+    if (!result) {
+        optimistic_yield(100);
+    }
+    return result;
+}
+
+const char* WiFiClient::peekBuffer()
+{
+    return _client? _client->peekBuffer(): nullptr;
+}
+
+void WiFiClient::peekConsume(size_t consume)
+{
+    if (_client)
+        _client->peekConsume(consume);
+}
+
 bool WiFiClient::flush(unsigned int maxWaitMs)
 {
     if (!_client)
@@ -46,6 +46,7 @@ extern "C" {
 #include <include/ClientContext.h>
 #include "c_types.h"
 #include "coredecls.h"
+#include "arduino-mock/EspHeap.h"
 
 #if !CORE_MOCK
 
@@ -400,6 +401,26 @@ int WiFiClientSecure_::available() {
   return 0;
 }
 
+size_t WiFiClientSecure_::peekAvailable() {
+  if (!ctx_present() || !_handshake_done) {
+    return 0;
+  }
+  return available();
+}
+
+const char* WiFiClientSecure_::peekBuffer() {
+  return (const char*)_recvapp_buf;
+}
+
+void WiFiClientSecure_::peekConsume(size_t consume) {
+  if (!_recvapp_buf || !consume) {
+    return;
+  }
+  br_ssl_engine_recvapp_ack(_eng, consume < _recvapp_len ? consume : _recvapp_len);
+  _recvapp_buf = nullptr;
+  _recvapp_len = 0;
+}
+
 int WiFiClientSecure_::peek() {
   if (!ctx_present() || !available()) {
     DEBUG_BSSL("peek: Not connected, none left available\n");
@@ -1069,8 +1090,8 @@ bool WiFiClientSecure_::_connectSSL(const char* hostName) {
 
   _sc = std::make_shared<br_ssl_client_context>();
   _eng = &_sc->eng; // Allocation/deallocation taken care of by the _sc shared_ptr
-  _iobuf_in = std::shared_ptr<unsigned char>(new unsigned char[_iobuf_in_size], std::default_delete<unsigned char[]>());
-  _iobuf_out = std::shared_ptr<unsigned char>(new unsigned char[_iobuf_out_size], std::default_delete<unsigned char[]>());
+  _iobuf_in = std::shared_ptr<unsigned char>((unsigned char*)espHeapMalloc(_iobuf_in_size), espHeapFree);
+  _iobuf_out = std::shared_ptr<unsigned char>((unsigned char*)espHeapMalloc(_iobuf_out_size), espHeapFree);
 
   if (!_sc || !_iobuf_in || !_iobuf_out) {
     _freeSSL(); // Frees _sc, _iobuf*
@@ -1185,8 +1206,8 @@ bool WiFiClientSecure_::_connectSSLServerRSA(const X509List *chain,
   _oom_err = false;
   _sc_svr = std::make_shared<br_ssl_server_context>();
   _eng = &_sc_svr->eng; // Allocation/deallocation taken care of by the _sc shared_ptr
-  _iobuf_in = std::shared_ptr<unsigned char>(new unsigned char[_iobuf_in_size], std::default_delete<unsigned char[]>());
-  _iobuf_out = std::shared_ptr<unsigned char>(new unsigned char[_iobuf_out_size], std::default_delete<unsigned char[]>());
+  _iobuf_in = std::shared_ptr<unsigned char>((unsigned char*)espHeapMalloc(_iobuf_in_size), espHeapFree);
+  _iobuf_out = std::shared_ptr<unsigned char>((unsigned char*)espHeapMalloc(_iobuf_out_size), espHeapFree);
 
   if (!_sc_svr || !_iobuf_in || !_iobuf_out) {
     _freeSSL();
@@ -1222,8 +1243,8 @@ bool WiFiClientSecure_::_connectSSLServerEC(const X509List *chain,
   _oom_err = false;
   _sc_svr = std::make_shared<br_ssl_server_context>();
   _eng = &_sc_svr->eng; // Allocation/deallocation taken care of by the _sc shared_ptr
-  _iobuf_in = std::shared_ptr<unsigned char>(new unsigned char[_iobuf_in_size], std::default_delete<unsigned char[]>());
-  _iobuf_out = std::shared_ptr<unsigned char>(new unsigned char[_iobuf_out_size], std::default_delete<unsigned char[]>());
+  _iobuf_in = std::shared_ptr<unsigned char>((unsigned char*)espHeapMalloc(_iobuf_in_size), espHeapFree);
+  _iobuf_out = std::shared_ptr<unsigned char>((unsigned char*)espHeapMalloc(_iobuf_out_size), espHeapFree);
 
   if (!_sc_svr || !_iobuf_in || !_iobuf_out) {
     _freeSSL();
@@ -1,29 +1,35 @@
 #include "arduino-mock/serialHelper.h"
 
+#include <stdio.h>
+
 stringCapture::stringCapture()
   : d() {
 }
 
 bool stringCapture::captureUInt16(uint16_t c) {
-  d << c;
+  char text[8];
+  d.append(text, snprintf(text, sizeof(text), "%u", (unsigned)c));
   return true;
 }
 
 bool stringCapture::captureUInt8(uint8_t c) {
-  d << c;
+  d.append((char)c);
   return true;
 }
 
 bool stringCapture::captureCStr(const uint8_t *buffer, size_t size) {
-  d << std::string((const char*)buffer, size);
+  d.append((const char*)buffer, size);
   return true;
 }
 
 void stringCapture::clear() {
-  return d.str("");
+  d.clear();
 }
 
 std::string stringCapture::get() {
   return d.str();
 }
 
+std::vector<CaptureView> stringCapture::lines() const {
+  return d.lines();
+}
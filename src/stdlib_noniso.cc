@@ -0,0 +1,63 @@
+#include "include/stdlib_noniso.h"
+
+#include <stdio.h>
+
+extern "C" {
+
+void reverse(char* begin, char* end) {
+  while (begin < --end) {
+    char c = *begin;
+    *begin++ = *end;
+    *end = c;
+  }
+}
+
+// Digits of value in radix 2 to 36, lower case, no sign
+static char* unsignedToString(unsigned long value, char* s, int radix) {
+  if (radix < 2 || radix > 36) {
+    *s = 0;
+    return s;
+  }
+  char* out = s;
+  do {
+    const unsigned long digit = value % radix;
+    *out++ = digit < 10 ? '0' + digit : 'a' + digit - 10;
+    value /= radix;
+  } while (value);
+  reverse(s, out);
+  *out = 0;
+  return s;
+}
+
+// Only base 10 has a sign, other bases show the two's complement, as with
+// the AVR and ESP8266 libc
+char* ltoa(long val, char* s, int radix) {
+  if (val < 0 && radix == 10) {
+    *s = '-';
+    unsignedToString(0UL - (unsigned long)val, s + 1, radix);
+    return s;
+  }
+  return unsignedToString((unsigned long)val, s, radix);
+}
+
+char* itoa(int val, char* s, int radix) {
+  if (radix != 10) {
+    return unsignedToString((unsigned int)val, s, radix);
+  }
+  return ltoa(val, s, radix);
+}
+
+char* utoa(unsigned int val, char* s, int radix) {
+  return unsignedToString(val, s, radix);
+}
+
+char* ultoa(unsigned long val, char* s, int radix) {
+  return unsignedToString(val, s, radix);
+}
+
+char* dtostrf(double val, signed char width, unsigned char prec, char* s) {
+  sprintf(s, "%*.*f", width, prec, val);
+  return s;
+}
+
+}
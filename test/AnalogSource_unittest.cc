@@ -0,0 +1,94 @@
+#include "gtest/gtest.h"
+#include "arduino-mock/Arduino.h"
+#include "arduino-mock/AnalogSource.h"
+
+#include <fstream>
+#include <string>
+
+static std::string writeSampleFile(const char* name, const std::string& contents) {
+  const std::string path = ::testing::TempDir() + name;
+  std::ofstream out(path.c_str(), std::ios::binary);
+  out << contents;
+  return path;
+}
+
+TEST(AnalogSource, functions) {
+  ConstantSource constant(42);
+  EXPECT_EQ(42, constant.sample(0));
+  EXPECT_EQ(42, constant.sample(123456789));
+
+  SineSource sine(512, 100, 1000);  // 1 ms period
+  EXPECT_EQ(512, sine.sample(0));
+  EXPECT_EQ(612, sine.sample(250));
+  EXPECT_EQ(412, sine.sample(750));
+  EXPECT_EQ(612, sine.sample(1000250));
+
+  SquareSource square(0, 1023, 100, 0.25);
+  EXPECT_EQ(1023, square.sample(0));
+  EXPECT_EQ(1023, square.sample(24));
+  EXPECT_EQ(0, square.sample(25));
+  EXPECT_EQ(1023, square.sample(1000));
+
+  NoiseSource noise(500, 10, 7);
+  bool varies = false;
+  for (uint64_t t = 0; t < 1000; t++) {
+    const int value = noise.sample(t);
+    EXPECT_GE(value, 490);
+    EXPECT_LE(value, 510);
+    EXPECT_EQ(value, noise.sample(t));
+    varies |= value != noise.sample(0);
+  }
+  EXPECT_TRUE(varies);
+}
+
+TEST(SampleFileSource, csv) {
+  const std::string path = writeSampleFile("samples.csv",
+                           "time,value\n0,100\n10, 200.5\nbad line\n20,-300");
+  SampleFileSource source(path.c_str(), SampleFileSource::CSV, 10, 1000,
+                          false, 1);
+  ASSERT_TRUE(source.isOpen());
+  EXPECT_EQ(3u, source.getSampleCount());
+  EXPECT_EQ(100, source.sample(0));
+  EXPECT_EQ(100, source.sample(1009));
+  EXPECT_EQ(200, source.sample(1010));
+  EXPECT_EQ(-300, source.sample(1025));
+  EXPECT_EQ(-300, source.sample(5000));
+  // back in time
+  EXPECT_EQ(200, source.sample(1015));
+
+  SampleFileSource looping(path.c_str(), SampleFileSource::CSV, 10, 0,
+                           true, 1);
+  EXPECT_EQ(100, looping.sample(30));
+  EXPECT_EQ(-300, looping.sample(50));
+}
+
+TEST(SampleFileSource, raw) {
+  const std::string path = writeSampleFile("samples.bin",
+                           std::string("\x01\x00\xff\xff\x00\x80", 6));
+  SampleFileSource source(path.c_str(), SampleFileSource::RAW_UINT16, 100);
+  EXPECT_EQ(3u, source.getSampleCount());
+  EXPECT_EQ(1, source.sample(50));
+  EXPECT_EQ(65535, source.sample(100));
+  EXPECT_EQ(32768, source.sample(299));
+  SampleFileSource signedSource(path.c_str(), SampleFileSource::RAW_INT16, 100);
+  EXPECT_EQ(-1, signedSource.sample(100));
+  EXPECT_EQ(-32768, signedSource.sample(200));
+
+  SampleFileSource missing("/nonexistent/samples.bin",
+                           SampleFileSource::RAW_UINT16, 100);
+  EXPECT_FALSE(missing.isOpen());
+  EXPECT_EQ(0, missing.sample(0));
+}
+
+TEST(ArduinoFake, analogSource) {
+  ArduinoMock* arduinoMock = arduinoMockInstance();
+  ArduinoFake* fake = arduinoFakeInstance();
+  fake->setAnalogSource(3, new SquareSource(10, 20, 2000));
+  EXPECT_EQ(20, analogRead(3));
+  arduinoMock->addMillisRaw(1);
+  EXPECT_EQ(10, analogRead(3));
+  fake->setAnalogInput(3, 5);
+  EXPECT_EQ(5, analogRead(3));
+  releaseArduinoFake();
+  releaseArduinoMock();
+}
@@ -19,3 +19,186 @@ TEST(delay, normal) {
   releaseArduinoMock();
 }
 
+
+TEST(millis, startsAtZero) {
+  ArduinoMock* arduinoMock = arduinoMockInstance();
+  EXPECT_CALL(*arduinoMock, millis()).Times(2);
+  EXPECT_EQ(0, millis());
+  EXPECT_EQ(0, micros());
+  EXPECT_EQ(0, millis());
+  releaseArduinoMock();
+}
+
+TEST(millis, delayAdvancesClock) {
+  ArduinoMock* arduinoMock = arduinoMockInstance();
+  EXPECT_CALL(*arduinoMock, millis()).Times(1);
+  EXPECT_CALL(*arduinoMock, delay(30000));
+  delay(30000);
+  EXPECT_EQ(30000, millis());
+  EXPECT_EQ(30000000, micros());
+  releaseArduinoMock();
+}
+
+TEST(micros, delayMicroseconds) {
+  ArduinoMock* arduinoMock = arduinoMockInstance();
+  EXPECT_CALL(*arduinoMock, millis()).Times(2);
+  delayMicroseconds(999);
+  EXPECT_EQ(999, micros());
+  EXPECT_EQ(0, millis());
+  delayMicroseconds(1);
+  EXPECT_EQ(1000, micros());
+  EXPECT_EQ(1, millis());
+  releaseArduinoMock();
+}
+
+TEST(millis, wrapsAt32Bits) {
+  ArduinoMock* arduinoMock = arduinoMockInstance();
+  arduinoMock->setMillisRaw(UINT32_MAX);
+  EXPECT_EQ(UINT32_MAX, arduinoMock->getMillis());
+  arduinoMock->addMillisRaw(2);
+  EXPECT_EQ(1, arduinoMock->getMillis());
+  releaseArduinoMock();
+}
+
+TEST(yield, advancesClock) {
+  ArduinoMock* arduinoMock = arduinoMockInstance();
+  arduinoMock->setYieldMicros(250);
+  yield();
+  yield();
+  EXPECT_EQ(500, micros());
+  releaseArduinoMock();
+}
+
+TEST(ArduinoFake, digitalPins) {
+  ArduinoFake* fake = arduinoFakeInstance();
+  pinMode(13, OUTPUT);
+  EXPECT_EQ(OUTPUT, fake->getPinMode(13));
+  for (int i = 0; i < 1000; i++) {
+    digitalWrite(13, i & 1 ? HIGH : LOW);
+  }
+  EXPECT_EQ(1000u, fake->getWriteCount(13));
+  EXPECT_EQ(HIGH, fake->getDigitalOutput(13));
+  EXPECT_EQ(HIGH, digitalRead(13));
+
+  pinMode(4, INPUT);
+  EXPECT_EQ(LOW, digitalRead(4));
+  pinMode(4, INPUT_PULLUP);
+  EXPECT_EQ(HIGH, digitalRead(4));
+  fake->setDigitalInput(4, LOW);
+  EXPECT_EQ(LOW, digitalRead(4));
+  fake->releaseDigitalInput(4);
+  EXPECT_EQ(HIGH, digitalRead(4));
+  releaseArduinoFake();
+}
+
+TEST(ArduinoFake, analogPins) {
+  ArduinoFake* fake = arduinoFakeInstance();
+  EXPECT_EQ(0, analogRead(0));
+  fake->setAnalogInput(0, 512);
+  EXPECT_EQ(512, analogRead(0));
+  analogWrite(9, 128);
+  EXPECT_EQ(OUTPUT, fake->getPinMode(9));
+  EXPECT_EQ(128, fake->getAnalogOutput(9));
+  releaseArduinoFake();
+}
+
+static uint8_t shiftRegister;
+
+static void shiftRegisterClock(void) {
+  shiftRegister = (shiftRegister << 1) | digitalRead(8);
+}
+
+TEST(shiftOut, emitsTimedEdges) {
+  ArduinoMock* arduinoMock = arduinoMockInstance();
+  arduinoFakeInstance();
+  pinMode(8, OUTPUT);
+  pinMode(12, OUTPUT);
+  // A 74HC595 latching the data pin on every rising clock edge
+  shiftRegister = 0;
+  attachInterrupt(digitalPinToInterrupt(12), shiftRegisterClock, RISING);
+  arduinoMock->setShiftEdgeMicros(3);
+
+  shiftOut(8, 12, MSBFIRST, 0xa5);
+  EXPECT_EQ(0xa5, shiftRegister);
+  EXPECT_EQ(8 * 2 * 3u, micros());
+  shiftOut(8, 12, LSBFIRST, 0x01);
+  EXPECT_EQ(0x80, shiftRegister);
+  EXPECT_EQ(LOW, digitalRead(12));
+  releaseArduinoFake();
+  releaseArduinoMock();
+}
+
+TEST(shiftIn, samplesScriptedWaveform) {
+  ArduinoMock* arduinoMock = arduinoMockInstance();
+  ArduinoFake* fake = arduinoFakeInstance();
+  arduinoMock->setShiftEdgeMicros(5);
+  arduinoMock->setMicrosRaw(1000);
+  pinMode(4, INPUT);
+  // Bit i is sampled 5 us after the i-th rising edge at 1000 + 10 * i.
+  const uint8_t value = 0xb2;
+  for (int i = 0; i < 8; i++) {
+    fake->scheduleDigitalInput(4, (value >> (7 - i)) & 1, 1000 + 10 * i);
+  }
+  EXPECT_EQ(value, shiftIn(4, 5, MSBFIRST));
+  EXPECT_EQ(1080u, micros());
+  releaseArduinoFake();
+  releaseArduinoMock();
+}
+
+TEST(pulseIn, measuresScriptedPulses) {
+  arduinoMockInstance();
+  ArduinoFake* fake = arduinoFakeInstance();
+  pinMode(7, INPUT);
+  fake->schedulePulse(7, HIGH, 100, 580);
+  EXPECT_EQ(580, pulseIn(7, HIGH, 10000));
+  EXPECT_EQ(680u, micros());
+
+  // A pulse already in progress is skipped.
+  fake->setDigitalInput(7, HIGH);
+  fake->scheduleDigitalInput(7, LOW, 700);
+  fake->schedulePulse(7, HIGH, 900, 120);
+  EXPECT_EQ(120, pulseIn(7, HIGH, 10000));
+
+  // LOW pulses on a pulled up pin
+  pinMode(7, INPUT_PULLUP);
+  fake->releaseDigitalInput(7);
+  fake->schedulePulse(7, LOW, 2000, 40);
+  EXPECT_EQ(40, pulseIn(7, LOW, 10000));
+  releaseArduinoFake();
+  releaseArduinoMock();
+}
+
+TEST(pulseIn, timeout) {
+  ArduinoMock* arduinoMock = arduinoMockInstance();
+  ArduinoFake* fake = arduinoFakeInstance();
+  pinMode(7, INPUT);
+  EXPECT_EQ(0, pulseIn(7, HIGH, 5000));
+  EXPECT_EQ(5000u, micros());
+
+  // The timeout covers the whole call, not just the wait for the pulse.
+  fake->schedulePulse(7, HIGH, 6000, 6000);
+  EXPECT_EQ(0, pulseIn(7, HIGH, 5000));
+  EXPECT_EQ(10000u, arduinoMock->getMicros64());
+  releaseArduinoFake();
+  releaseArduinoMock();
+}
+
+TEST(pulseIn, pollsMockedDigitalRead) {
+  ArduinoMock* arduinoMock = arduinoMockInstance();
+  int level = LOW;
+  int reads = 0;
+  ON_CALL(*arduinoMock, digitalRead(7))
+    .WillByDefault(::testing::Invoke([&](int) { reads++; return level; }));
+  EXPECT_CALL(*arduinoMock, digitalRead(7)).Times(::testing::AnyNumber());
+
+  // One read per poll step, not per microsecond: the first read finds the
+  // pin LOW already, then it is polled at 0, 10, ..., 10000 us
+  EXPECT_EQ(0, pulseIn(7, HIGH, 10000));
+  EXPECT_EQ(1002, reads);
+
+  // Edges from scheduled events are timed exactly
+  arduinoMock->scheduleIn(105, [&]() { level = HIGH; });
+  arduinoMock->scheduleIn(685, [&]() { level = LOW; });
+  EXPECT_EQ(580, pulseIn(7, HIGH, 10000));
+  releaseArduinoMock();
+}
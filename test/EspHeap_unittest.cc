@@ -0,0 +1,273 @@
+#include "gtest/gtest.h"
+#include "arduino-mock/EspHeap.h"
+#include "arduino-mock/Arduino.h"
+#include "arduino-mock/MockContext.h"
+
+#include "include/WString.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+TEST(EspHeap, firstFit) {
+  EspHeap heap(1024);
+  EXPECT_EQ(1024U, heap.getSize());
+  EXPECT_EQ(1020U, heap.getMaxFreeBlockSize());
+
+  // 100 bytes plus header take 13 blocks
+  char* a = (char*)heap.allocate(100);
+  char* b = (char*)heap.allocate(100);
+  char* c = (char*)heap.allocate(100);
+  ASSERT_TRUE(a && b && c);
+  EXPECT_EQ(a + 13 * 8, b);
+  EXPECT_EQ(3 * 13 * 8U, heap.getUsedBytes());
+
+  heap.release(b);
+  EXPECT_EQ(b, heap.allocate(50));
+  EXPECT_EQ(3U, heap.getLiveAllocations());
+
+  heap.release(a);
+  heap.release(b);
+  heap.release(c);
+  EXPECT_EQ(0U, heap.getUsedBytes());
+  EXPECT_EQ(1020U, heap.getMaxFreeBlockSize());
+  EXPECT_EQ(0, heap.getFragmentation());
+  EXPECT_EQ(3 * 13 * 8U, heap.getPeakUsedBytes());
+}
+
+TEST(EspHeap, fragmentation) {
+  EspHeap heap(1024);
+  void* blocks[8];
+  for (int i = 0; i < 8; i++) {
+    blocks[i] = heap.allocate(124);
+  }
+  EXPECT_EQ(NULL, heap.allocate(1));
+  for (int i = 0; i < 8; i += 2) {
+    heap.release(blocks[i]);
+  }
+  EXPECT_EQ(512U, heap.getFreeBytes());
+  EXPECT_EQ(124U, heap.getMaxFreeBlockSize());
+  EXPECT_EQ(50, heap.getFragmentation());
+  EXPECT_EQ(NULL, heap.allocate(200));
+  EXPECT_EQ(2U, heap.getFailedAllocations());
+}
+
+TEST(EspHeap, reallocate) {
+  EspHeap heap(1024);
+  char* a = (char*)heap.allocate(20);
+  strcpy(a, "grows in place");
+  EXPECT_EQ(a, heap.reallocate(a, 100));
+  char* b = (char*)heap.allocate(20);
+  char* moved = (char*)heap.reallocate(a, 200);
+  EXPECT_NE(a, moved);
+  EXPECT_STREQ("grows in place", moved);
+  EXPECT_EQ(moved, heap.reallocate(moved, 10));
+  EXPECT_EQ(16U + 24U, heap.getUsedBytes());
+  heap.release(moved);
+  heap.release(b);
+  EXPECT_EQ(0U, heap.getLiveAllocations());
+}
+
+TEST(EspHeap, failAfterCalls) {
+  EspHeap heap;
+  heap.failAfterCalls(2);
+  void* a = heap.allocate(10);
+  void* b = heap.allocate(10);
+  EXPECT_TRUE(a && b);
+  EXPECT_EQ(NULL, heap.allocate(10));
+  EXPECT_EQ(NULL, heap.reallocate(a, 100));
+  EXPECT_EQ(a, heap.reallocate(a, 5));
+  heap.clearFailure();
+  void* c = heap.allocate(10);
+  EXPECT_TRUE(c != NULL);
+  EXPECT_EQ(2U, heap.getFailedAllocations());
+  heap.release(a);
+  heap.release(b);
+  heap.release(c);
+}
+
+TEST(EspHeap, failAfterBytes) {
+  EspHeap heap;
+  heap.failAfterBytes(100);
+  void* a = heap.allocate(60);
+  EXPECT_TRUE(a != NULL);
+  EXPECT_EQ(NULL, heap.allocate(50));
+  // Growing only costs the bytes added
+  a = heap.reallocate(a, 100);
+  EXPECT_TRUE(a != NULL);
+  EXPECT_EQ(NULL, heap.reallocate(a, 101));
+  heap.release(a);
+}
+
+TEST(EspHeap, historyOnVirtualTime) {
+  ScopedMockContext context;
+  ArduinoMock* arduinoMock = arduinoMockInstance();
+  EspHeap heap(1024);
+  EXPECT_TRUE(heap.getHistory().empty());
+  heap.keepHistory(16);
+  void* a = heap.allocate(100);
+  void* b = heap.allocate(100);
+  arduinoMock->addMicrosRaw(500);
+  heap.release(a);
+  arduinoMock->addMicrosRaw(500);
+  heap.release(b);
+
+  const std::deque<EspHeapSample>& history = heap.getHistory();
+  ASSERT_EQ(3U, history.size());
+  EXPECT_EQ(0U, history[0].micros);
+  EXPECT_EQ(2 * 13 * 8U, history[0].used);
+  EXPECT_EQ(500U, history[1].micros);
+  EXPECT_EQ(13 * 8U, history[1].used);
+  EXPECT_EQ(11, history[1].fragmentation);
+  EXPECT_EQ(1000U, history[2].micros);
+  EXPECT_EQ(0U, history[2].used);
+  EXPECT_EQ(1020U, history[2].maxFreeBlock);
+}
+
+TEST(EspHeap, historyRing) {
+  ScopedMockContext context;
+  ArduinoMock* arduinoMock = arduinoMockInstance();
+  EspHeap heap(1024);
+  heap.keepHistory(2);
+  void* blocks[4];
+  for (int i = 0; i < 4; i++) {
+    arduinoMock->addMicrosRaw(100);
+    blocks[i] = heap.allocate(20);
+  }
+  ASSERT_EQ(2U, heap.getHistory().size());
+  EXPECT_EQ(300U, heap.getHistory()[0].micros);
+  EXPECT_EQ(400U, heap.getHistory()[1].micros);
+  EXPECT_EQ(4 * 24U, heap.getHistory()[1].used);
+
+  heap.keepHistory(0);
+  EXPECT_TRUE(heap.getHistory().empty());
+  for (int i = 0; i < 4; i++) {
+    heap.release(blocks[i]);
+  }
+  EXPECT_TRUE(heap.getHistory().empty());
+}
+
+TEST(EspHeap, statsAfterChurn) {
+  // The largest free block and the fragmentation are kept as runs split
+  // and merge; the largest block must still be exactly what fits
+  EspHeap heap(4096);
+  std::vector<void*> live;
+  unsigned int seed = 7;
+  for (int i = 0; i < 2000; i++) {
+    seed = seed * 1103515245 + 12345;
+    if (!live.empty() && (seed >> 16) % 3 == 0) {
+      const size_t victim = (seed >> 8) % live.size();
+      heap.release(live[victim]);
+      live.erase(live.begin() + victim);
+    } else if ((seed >> 16) % 3 == 1 && !live.empty()) {
+      const size_t index = (seed >> 8) % live.size();
+      void* moved = heap.reallocate(live[index], 1 + (seed >> 4) % 200);
+      if (moved) {
+        live[index] = moved;
+      }
+    } else {
+      void* ptr = heap.allocate(1 + (seed >> 4) % 200);
+      if (ptr) {
+        live.push_back(ptr);
+      }
+    }
+    const size_t largest = heap.getMaxFreeBlockSize();
+    EXPECT_LE(heap.getFragmentation(), 100);
+    if (largest > 0) {
+      EXPECT_EQ(NULL, heap.allocate(largest + 1));
+      void* fits = heap.allocate(largest);
+      ASSERT_TRUE(fits != NULL);
+      heap.release(fits);
+    }
+  }
+  for (size_t i = 0; i < live.size(); i++) {
+    heap.release(live[i]);
+  }
+  EXPECT_EQ(4092U, heap.getMaxFreeBlockSize());
+  EXPECT_EQ(0, heap.getFragmentation());
+}
+
+TEST(EspHeap, routing) {
+  ScopedMockContext context;
+  void* host = espHeapMalloc(16);
+  EspHeap heap(4096);
+  EXPECT_EQ(NULL, setEspHeap(&heap));
+  EXPECT_EQ(&heap, espHeap());
+  EXPECT_EQ(&heap.getStringAllocator(), &stringAllocator());
+
+  char* buffer = (char*)stringAllocator().reallocate(NULL, 0, 32);
+  EXPECT_TRUE(heap.owns(buffer));
+  stringAllocator().release(buffer, 32);
+
+  char* iobuf = (char*)espHeapCalloc(64, 8);
+  EXPECT_TRUE(heap.owns(iobuf));
+  EXPECT_EQ(0, iobuf[511]);
+  EXPECT_EQ(NULL, espHeapMalloc(8192));
+  espHeapFree(iobuf);
+  espHeapFree(host);
+  EXPECT_EQ(0U, heap.getLiveAllocations());
+
+  EXPECT_EQ(&heap, setEspHeap(NULL));
+  EXPECT_NE(&heap.getStringAllocator(), &stringAllocator());
+}
+
+TEST(EspHeap, callocOverflow) {
+  ScopedMockContext context;
+  EXPECT_EQ(NULL, espHeapCalloc(SIZE_MAX / 2 + 1, 2));
+  EspHeap heap;
+  setEspHeap(&heap);
+  EXPECT_EQ(NULL, espHeapCalloc(2, SIZE_MAX / 2 + 1));
+  EXPECT_EQ(0U, heap.getFailedAllocations());
+  setEspHeap(NULL);
+}
+
+TEST(EspHeap, freeAfterUnset) {
+  ScopedMockContext context;
+  EspHeap heap;
+  setEspHeap(&heap);
+  void* iobuf = espHeapMalloc(512);
+  void* grown = espHeapMalloc(16);
+  setEspHeap(NULL);
+  EXPECT_EQ(&heap, espHeapOwning(iobuf));
+  EXPECT_EQ(NULL, espHeapOwning(&heap));
+  grown = espHeapRealloc(grown, 64);
+  EXPECT_TRUE(heap.owns(grown));
+  espHeapFree(iobuf);
+  espHeapFree(grown);
+  EXPECT_EQ(0U, heap.getLiveAllocations());
+}
+
+TEST(EspHeap, stringOutlivesHeap) {
+  ScopedMockContext context;
+  EspHeap heap;
+  String before("allocated on the host before the heap was set");
+  setEspHeap(&heap);
+  {
+    String reply("a reply long enough to leave the SSO buffer");
+    reply += " and then some";
+    before += " and grown after";
+    EXPECT_TRUE(heap.owns(reply.c_str()));
+    EXPECT_FALSE(heap.owns(before.c_str()));
+    setEspHeap(NULL);
+    reply += ", grown and freed after setEspHeap(NULL)";
+    EXPECT_TRUE(heap.owns(reply.c_str()));
+  }
+  EXPECT_EQ(0U, heap.getLiveAllocations());
+}
+
+TEST(EspHeap, keepsUserAllocator) {
+  ScopedMockContext context;
+  PoolStringAllocator pool;
+  EspHeap heap;
+  setEspHeap(&heap);
+  setStringAllocator(&pool);
+  setEspHeap(NULL);
+  EXPECT_EQ(&pool, &stringAllocator());
+
+  // Nor does a heap replace it
+  setEspHeap(&heap);
+  EXPECT_EQ(&pool, &stringAllocator());
+  setEspHeap(NULL);
+  setStringAllocator(NULL);
+}
@@ -0,0 +1,156 @@
+#include "gtest/gtest.h"
+#include "arduino-mock/Arduino.h"
+#include "arduino-mock/Interrupts.h"
+
+#include <thread>
+#include <vector>
+
+static volatile int isrCount;
+static volatile int isrOtherCount;
+
+static void countingIsr(void) {
+  isrCount++;
+}
+
+static void otherIsr(void) {
+  isrOtherCount++;
+}
+
+static std::vector<int> isrOrder;
+
+static void isr4(void) {
+  isrOrder.push_back(4);
+}
+
+static void isr5(void) {
+  isrOrder.push_back(5);
+}
+
+TEST(PinEdgeQueue, pushPop) {
+  PinEdgeQueue queue(3);
+  EXPECT_TRUE(queue.push(5, HIGH));
+  EXPECT_TRUE(queue.push(6, LOW));
+  EXPECT_TRUE(queue.push(7, HIGH));
+  EXPECT_TRUE(queue.push(8, HIGH));
+  EXPECT_FALSE(queue.push(9, HIGH));
+  uint8_t pin, level;
+  EXPECT_TRUE(queue.pop(pin, level));
+  EXPECT_EQ(5, pin);
+  EXPECT_EQ(HIGH, level);
+  EXPECT_TRUE(queue.pop(pin, level));
+  EXPECT_EQ(6, pin);
+  EXPECT_EQ(LOW, level);
+  EXPECT_TRUE(queue.push(9, LOW));
+  EXPECT_TRUE(queue.pop(pin, level));
+  EXPECT_TRUE(queue.pop(pin, level));
+  EXPECT_TRUE(queue.pop(pin, level));
+  EXPECT_EQ(9, pin);
+  EXPECT_FALSE(queue.pop(pin, level));
+}
+
+TEST(attachInterrupt, edges) {
+  ArduinoFake* fake = arduinoFakeInstance();
+  isrCount = isrOtherCount = 0;
+  pinMode(2, INPUT);
+  pinMode(3, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(2), countingIsr, RISING);
+  attachInterrupt(digitalPinToInterrupt(3), otherIsr, FALLING);
+
+  fake->setDigitalInput(2, HIGH);
+  fake->setDigitalInput(2, HIGH);
+  fake->setDigitalInput(2, LOW);
+  EXPECT_EQ(1, isrCount);
+
+  fake->setDigitalInput(3, LOW);
+  fake->releaseDigitalInput(3);  // pulled up again
+  EXPECT_EQ(1, isrOtherCount);
+
+  attachInterrupt(digitalPinToInterrupt(2), countingIsr, CHANGE);
+  fake->setDigitalInput(2, HIGH);
+  fake->setDigitalInput(2, LOW);
+  EXPECT_EQ(3, isrCount);
+
+  detachInterrupt(digitalPinToInterrupt(2));
+  fake->setDigitalInput(2, HIGH);
+  EXPECT_EQ(3, isrCount);
+  EXPECT_EQ(NOT_AN_INTERRUPT, digitalPinToInterrupt(20));
+  releaseArduinoFake();
+}
+
+TEST(noInterrupts, pendingDeliveredOnEnable) {
+  ArduinoFake* fake = arduinoFakeInstance();
+  isrCount = isrOtherCount = 0;
+  attachInterrupt(4, countingIsr, CHANGE);
+  attachInterrupt(5, otherIsr, CHANGE);
+  noInterrupts();
+  fake->setDigitalInput(4, HIGH);
+  fake->setDigitalInput(5, HIGH);
+  fake->setDigitalInput(4, LOW);
+  EXPECT_EQ(0, isrCount);
+  EXPECT_EQ(2u, fake->getInterrupts().getPendingCount());
+  EXPECT_EQ(1u, fake->getInterrupts().getLostCount(4));
+  interrupts();
+  EXPECT_EQ(1, isrCount);
+  EXPECT_EQ(1, isrOtherCount);
+  EXPECT_EQ(0u, fake->getInterrupts().getPendingCount());
+  releaseArduinoFake();
+}
+
+TEST(detachInterrupt, reattachKeepsPendingOrder) {
+  ArduinoFake* fake = arduinoFakeInstance();
+  isrOrder.clear();
+  attachInterrupt(4, isr4, CHANGE);
+  attachInterrupt(5, isr5, CHANGE);
+  noInterrupts();
+  fake->setDigitalInput(4, HIGH);
+  detachInterrupt(4);
+  EXPECT_EQ(0u, fake->getInterrupts().getPendingCount());
+  fake->setDigitalInput(5, HIGH);
+  attachInterrupt(4, isr4, CHANGE);
+  fake->setDigitalInput(4, LOW);
+  EXPECT_EQ(2u, fake->getInterrupts().getPendingCount());
+  interrupts();
+  ASSERT_EQ(2u, isrOrder.size());
+  EXPECT_EQ(5, isrOrder[0]);
+  EXPECT_EQ(4, isrOrder[1]);
+  releaseArduinoFake();
+}
+
+TEST(attachInterrupt, outputChangesRaiseInterrupts) {
+  arduinoFakeInstance();
+  isrCount = 0;
+  pinMode(12, OUTPUT);
+  attachInterrupt(12, countingIsr, RISING);
+  for (int i = 0; i < 10; i++) {
+    digitalWrite(12, HIGH);
+    digitalWrite(12, LOW);
+  }
+  EXPECT_EQ(10, isrCount);
+  releaseArduinoFake();
+}
+
+TEST(injectDigitalInput, stimulusThread) {
+  ArduinoFake* fake = arduinoFakeInstance();
+  isrCount = 0;
+  attachInterrupt(6, countingIsr, RISING);
+  const int pulses = 100000;
+  std::thread stimulus([fake]() {
+    for (int i = 0; i < pulses; i++) {
+      while (!fake->injectDigitalInput(6, HIGH)) {
+        std::this_thread::yield();
+      }
+      while (!fake->injectDigitalInput(6, LOW)) {
+        std::this_thread::yield();
+      }
+    }
+  });
+  while (isrCount < pulses) {
+    digitalRead(6);
+  }
+  stimulus.join();
+  fake->service();
+  EXPECT_EQ(pulses, isrCount);
+  EXPECT_EQ(LOW, digitalRead(6));
+  EXPECT_EQ(0u, fake->getInterrupts().getLostCount(6));
+  releaseArduinoFake();
+}
@@ -0,0 +1,56 @@
+#include "gtest/gtest.h"
+#include "arduino-mock/Arduino.h"
+#include "arduino-mock/Serial.h"
+#include "arduino-mock/MockContext.h"
+
+#include <thread>
+#include <vector>
+
+using ::testing::_;
+using ::testing::Return;
+
+TEST(MockContext, scopedContextIsolatesMocks) {
+  ArduinoMock* outer = arduinoMockInstance();
+  outer->setMillisRaw(100);
+  {
+    ScopedMockContext context;
+    EXPECT_EQ(NULL, currentMockContext().arduino);
+    ArduinoMock* inner = arduinoMockInstance();
+    EXPECT_NE(outer, inner);
+    EXPECT_EQ(0, inner->getMillis());
+    // Left for the context to delete
+  }
+  EXPECT_EQ(outer, arduinoMockInstance());
+  EXPECT_EQ(100, outer->getMillis());
+  releaseArduinoMock();
+}
+
+TEST(MockContext, threadsRunInParallel) {
+  const int shards = 8;
+  std::vector<std::thread> threads;
+  std::vector<long> seenMillis(shards, -1);
+  std::vector<size_t> seenPrint(shards, 0);
+  for (int i = 0; i < shards; i++) {
+    threads.push_back(std::thread([i, &seenMillis, &seenPrint]() {
+      ScopedMockContext context;
+      ArduinoMock* arduinoMock = arduinoMockInstance();
+      SerialMock* serialMock = serialMockInstance();
+      EXPECT_CALL(*arduinoMock, millis()).Times(1);
+      EXPECT_CALL(*arduinoMock, delay(i * 1000));
+      EXPECT_CALL(*serialMock, print(::testing::Matcher<int>(i), DEC))
+      .WillOnce(Return(i + 1));
+      delay(i * 1000);
+      seenMillis[i] = millis();
+      seenPrint[i] = Serial.print(i);
+      releaseSerialMock();
+      releaseArduinoMock();
+    }));
+  }
+  for (size_t i = 0; i < threads.size(); i++) {
+    threads[i].join();
+  }
+  for (int i = 0; i < shards; i++) {
+    EXPECT_EQ(i * 1000, seenMillis[i]);
+    EXPECT_EQ((size_t)i + 1, seenPrint[i]);
+  }
+}
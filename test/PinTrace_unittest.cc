@@ -0,0 +1,72 @@
+#include "gtest/gtest.h"
+#include "arduino-mock/Arduino.h"
+#include "arduino-mock/PinTrace.h"
+
+#include <sstream>
+#include <string>
+
+TEST(PinTrace, records) {
+  ArduinoMock* arduino = arduinoMockInstance();
+  arduinoFakeInstance();
+  PinTrace* trace = pinTraceInstance(16);
+
+  pinMode(13, OUTPUT);
+  arduino->addMicrosRaw(10);
+  digitalWrite(13, HIGH);
+  arduino->addMicrosRaw(5);
+  analogWrite(9, 100000);
+
+  ASSERT_EQ(3, trace->size());
+  EXPECT_EQ(0, trace->dropped());
+  PinTrace::Record record = trace->at(0);
+  EXPECT_EQ(PinTrace::PIN_MODE, record.kind);
+  EXPECT_EQ(13, record.pin);
+  EXPECT_EQ(OUTPUT, record.value);
+  EXPECT_EQ(0, record.micros);
+  record = trace->at(1);
+  EXPECT_EQ(PinTrace::DIGITAL_WRITE, record.kind);
+  EXPECT_EQ(HIGH, record.value);
+  EXPECT_EQ(10, record.micros);
+  record = trace->at(2);
+  EXPECT_EQ(PinTrace::ANALOG_WRITE, record.kind);
+  EXPECT_EQ(9, record.pin);
+  EXPECT_EQ(PinTrace::max_value, record.value);
+  EXPECT_EQ(15, record.micros);
+
+  releasePinTrace();
+  releaseArduinoFake();
+  releaseArduinoMock();
+}
+
+TEST(PinTrace, overwritesOldest) {
+  PinTrace trace(3);
+  EXPECT_EQ(4, trace.capacity());
+  for (int i = 0; i < 6; i++) {
+    trace.record(PinTrace::DIGITAL_WRITE, 2, i & 1, i);
+  }
+  EXPECT_EQ(4, trace.size());
+  EXPECT_EQ(2, trace.dropped());
+  EXPECT_EQ(2, trace.at(0).micros);
+  EXPECT_EQ(5, trace.at(3).micros);
+  trace.clear();
+  EXPECT_EQ(0, trace.size());
+}
+
+TEST(PinTrace, exportVcd) {
+  PinTrace trace(16);
+  trace.record(PinTrace::PIN_MODE, 13, OUTPUT, 0);
+  trace.record(PinTrace::DIGITAL_WRITE, 13, HIGH, 10);
+  trace.record(PinTrace::ANALOG_WRITE, 9, 5, 10);
+  trace.record(PinTrace::PIN_MODE, 13, INPUT, 25);
+
+  std::ostringstream out;
+  trace.exportVcd(out);
+  const std::string vcd = out.str();
+  EXPECT_NE(std::string::npos, vcd.find("$timescale 1us $end"));
+  // Signals are declared in pin order, so pwm9 gets the first identifier.
+  EXPECT_NE(std::string::npos, vcd.find("$var wire 16 ! pwm9 $end"));
+  EXPECT_NE(std::string::npos, vcd.find("$var wire 1 \" pin13 $end"));
+  EXPECT_NE(std::string::npos, vcd.find("#0\n$dumpvars\nbx !\nx\"\n$end\n0\"\n"));
+  EXPECT_NE(std::string::npos, vcd.find("#10\n1\"\nb101 !\n"));
+  EXPECT_NE(std::string::npos, vcd.find("#25\nz\"\n"));
+}
@@ -0,0 +1,72 @@
+#include "gtest/gtest.h"
+#include "arduino-mock/Arduino.h"
+#include "arduino-mock/Serial.h"
+#include "arduino-mock/PrintFormat.h"
+
+#include <limits.h>
+#include <math.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+template<typename T> static std::string integer(T value, int base) {
+  char text[print_number_size];
+  const size_t length = formatInteger(text, value, base);
+  EXPECT_EQ(strlen(text), length);
+  return std::string(text, length);
+}
+
+static std::string decimal(double value, int digits) {
+  char text[print_double_size];
+  const size_t length = formatDouble(text, value, digits);
+  EXPECT_EQ(strlen(text), length);
+  return std::string(text, length);
+}
+
+TEST(PrintFormat, integers) {
+  EXPECT_EQ("1001110", integer(78, BIN));
+  EXPECT_EQ("116", integer(78, OCT));
+  EXPECT_EQ("78", integer(78, DEC));
+  EXPECT_EQ("4E", integer(78, HEX));
+  EXPECT_EQ("0", integer(0, BIN));
+  EXPECT_EQ("-123", integer(-123, DEC));
+  EXPECT_EQ("FFFFFFFF", integer(-1, HEX));
+  EXPECT_EQ("11111111", integer((unsigned char)255, BIN));
+  EXPECT_EQ("-2147483648", integer(INT_MIN, DEC));
+  EXPECT_EQ("18446744073709551615", integer(ULLONG_MAX, DEC));
+  EXPECT_EQ(std::string(64, '1'), integer(ULLONG_MAX, BIN));
+  EXPECT_EQ("Z", integer(35, 36));
+  EXPECT_EQ("12", integer(12, 1));  // invalid bases print in decimal
+  EXPECT_EQ("A", integer(65, 0));   // base 0 writes the raw byte
+}
+
+TEST(PrintFormat, doubles) {
+  EXPECT_EQ("1", decimal(1.23456, 0));
+  EXPECT_EQ("1.23", decimal(1.23456, 2));
+  EXPECT_EQ("1.2346", decimal(1.23456, 4));
+  EXPECT_EQ("-0.50", decimal(-0.499, 2));
+  EXPECT_EQ("2.0", decimal(1.96, 1));
+  EXPECT_EQ("4294967040.00", decimal(4294967040.0, 2));
+  EXPECT_EQ("ovf", decimal(1e10, 2));
+  EXPECT_EQ("nan", decimal(NAN, 2));
+  EXPECT_EQ("inf", decimal(-INFINITY, 2));
+}
+
+TEST(serial, printToCoutKeepsStreamState) {
+  std::ostringstream out;
+  std::streambuf* saved = std::cout.rdbuf(out.rdbuf());
+  const std::ios::fmtflags flags = std::cout.flags();
+  const std::streamsize precision = std::cout.precision();
+  Serial_::setPrintToCout(true);
+  Serial.print(78, BIN);
+  Serial.print(' ');
+  Serial.print(255, HEX);
+  Serial.print(' ');
+  Serial.println(3.14159, 3);
+  Serial.println(-7);
+  Serial_::setPrintToCout(false);
+  std::cout.rdbuf(saved);
+  EXPECT_EQ("1001110 FF 3.142\n-7\n", out.str());
+  EXPECT_EQ(flags, std::cout.flags());
+  EXPECT_EQ(precision, std::cout.precision());
+}
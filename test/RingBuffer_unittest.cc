@@ -0,0 +1,100 @@
+#include "gtest/gtest.h"
+#include "arduino-mock/RingBuffer.h"
+#include "arduino-mock/Serial.h"
+#include "arduino-mock/SoftwareSerial.h"
+
+#include <string>
+
+TEST(RingBuffer, wrapsAndGrows) {
+  RingBuffer ring(5);
+  EXPECT_EQ(8u, ring.capacity());
+  ring.feed((const uint8_t*)"abcdef", 6);
+  EXPECT_EQ('a', ring.pop());
+  EXPECT_EQ('b', ring.pop());
+  // wraps around the end of the storage
+  ring.feed((const uint8_t*)"ghij", 4);
+  EXPECT_EQ(8u, ring.capacity());
+  EXPECT_EQ(8u, ring.size());
+  EXPECT_EQ('j', ring.peek(7));
+
+  // grows while wrapped, keeping the order
+  ring.feed((const uint8_t*)"klm", 3);
+  EXPECT_EQ(16u, ring.capacity());
+  uint8_t out[32];
+  ASSERT_EQ(11u, ring.read(out, sizeof(out)));
+  EXPECT_EQ("cdefghijklm", std::string((const char*)out, 11));
+  EXPECT_TRUE(ring.empty());
+  EXPECT_EQ(0u, ring.read(out, sizeof(out)));
+}
+
+TEST(RingBuffer, contiguousFront) {
+  RingBuffer ring(8);
+  ring.feed((const uint8_t*)"abcdef", 6);
+  ring.consume(4);
+  ring.feed((const uint8_t*)"ghij", 4);
+  // "efgh" up to the end of the storage, "ij" wrapped to its start
+  EXPECT_EQ(6u, ring.size());
+  ASSERT_EQ(4u, ring.contiguous());
+  EXPECT_EQ("efgh", std::string((const char*)ring.front(), 4));
+  ring.consume(4);
+  ASSERT_EQ(2u, ring.contiguous());
+  EXPECT_EQ("ij", std::string((const char*)ring.front(), 2));
+  ring.consume(10);
+  EXPECT_TRUE(ring.empty());
+  EXPECT_EQ(0u, ring.contiguous());
+}
+
+TEST(RingBuffer, streamsMegabytes) {
+  RingBuffer ring;
+  std::string chunk;
+  for (int i = 0; i < 1000; i++) {
+    chunk += (char)('0' + i % 10);
+  }
+  uint8_t out[700];
+  size_t fed = 0, consumed = 0;
+  bool inOrder = true;
+  while (fed < 4 * 1024 * 1024) {
+    ring.feed((const uint8_t*)chunk.data(), chunk.size());
+    fed += chunk.size();
+    const size_t n = ring.read(out, sizeof(out));
+    for (size_t i = 0; i < n; i++) {
+      inOrder &= out[i] == '0' + (consumed + i) % 1000 % 10;
+    }
+    consumed += n;
+  }
+  EXPECT_TRUE(inOrder);
+  EXPECT_EQ(fed - consumed, ring.size());
+  // only the backlog is ever buffered
+  EXPECT_LE(ring.capacity(), 2 * ring.size());
+}
+
+TEST(serial, feed) {
+  SerialMock* serialMock = serialMockInstance();
+  std::string transcript;
+  for (int i = 0; i < 20; i++) {
+    transcript += "$GPGGA,123519,4807.038,N,01131.000,E*47\r\n";
+  }
+  serialMock->mock_buffer_load(transcript.data(), transcript.size());
+  EXPECT_EQ(255, Serial.available());
+  serialMock->mock_buffer_feed((const uint8_t*)"OK\r\n", 4);
+  std::string received;
+  while (Serial.available()) {
+    received += (char)Serial.read();
+  }
+  EXPECT_EQ(transcript + "OK\r\n", received);
+  releaseSerialMock();
+}
+
+TEST(SoftwareSerialFake, feed) {
+  SoftwareSerialFake fake;
+  fake.listen();
+  fake.buffer_load((const uint8_t*)"AT\r\n", 4);
+  fake.feed((const uint8_t*)"OK\r\n", 4);
+  EXPECT_EQ(8, fake.available());
+  EXPECT_EQ('A', fake.read());
+  EXPECT_EQ('\r', fake.at(1));
+  uint8_t out[16];
+  ASSERT_EQ(7u, fake.read(out, sizeof(out)));
+  EXPECT_EQ("T\r\nOK\r\n", std::string((const char*)out, 7));
+  EXPECT_EQ(0, fake.available());
+}
@@ -0,0 +1,101 @@
+#include "gtest/gtest.h"
+#include "arduino-mock/Arduino.h"
+#include "arduino-mock/Scheduler.h"
+
+#include <vector>
+
+using ::testing::_;
+
+TEST(VirtualScheduler, popsInTimeOrder) {
+  VirtualScheduler s;
+  std::vector<int> order;
+  s.scheduleAt(5000, [&]() { order.push_back(3); });
+  s.scheduleAt(20, [&]() { order.push_back(1); });
+  s.scheduleAt(5000, [&]() { order.push_back(4); });
+  s.scheduleAt(999, [&]() { order.push_back(2); });
+  s.scheduleAt(3600000000ULL, [&]() { order.push_back(5); });
+  EXPECT_EQ(5u, s.size());
+  EXPECT_EQ(20u, s.nextEventTime());
+
+  uint64_t when;
+  VirtualScheduler::Callback cb;
+  uint64_t last = 0;
+  while (s.popDue(UINT64_MAX, when, cb)) {
+    EXPECT_LE(last, when);
+    last = when;
+    cb();
+  }
+  EXPECT_EQ(3600000000ULL, last);
+  EXPECT_EQ(std::vector<int>({1, 2, 3, 4, 5}), order);
+  EXPECT_TRUE(s.empty());
+  EXPECT_EQ(UINT64_MAX, s.nextEventTime());
+}
+
+TEST(VirtualScheduler, respectsLimit) {
+  VirtualScheduler s;
+  s.scheduleAt(1000000, []() {});
+  uint64_t when;
+  VirtualScheduler::Callback cb;
+  EXPECT_FALSE(s.popDue(999999, when, cb));
+  EXPECT_TRUE(s.popDue(1000000, when, cb));
+  EXPECT_EQ(1000000u, when);
+}
+
+TEST(VirtualScheduler, pastEventsAreDueFirst) {
+  VirtualScheduler s;
+  s.advance(500000);
+  s.scheduleAt(500100, []() {});
+  s.scheduleAt(10, []() {});
+  EXPECT_EQ(10u, s.nextEventTime());
+}
+
+TEST(delay, runsScheduledEvents) {
+  ArduinoMock* arduinoMock = arduinoMockInstance();
+  EXPECT_CALL(*arduinoMock, delay(_)).Times(1);
+  std::vector<uint64_t> seen;
+  arduinoMock->scheduleAt(1500, [&]() {
+    seen.push_back(arduinoMock->getMicros64());
+  });
+  arduinoMock->scheduleAt(29000000, [&]() {
+    seen.push_back(arduinoMock->getMicros64());
+    // events may schedule follow-up events
+    arduinoMock->scheduleIn(250, [&]() {
+      seen.push_back(arduinoMock->getMicros64());
+    });
+  });
+  arduinoMock->scheduleAt(40000000, [&]() {
+    seen.push_back(arduinoMock->getMicros64());
+  });
+  delay(30000);
+  EXPECT_EQ(std::vector<uint64_t>({1500, 29000000, 29000250}), seen);
+  EXPECT_EQ(30000000u, arduinoMock->getMicros64());
+  EXPECT_EQ(1u, arduinoMock->getScheduler().size());
+  releaseArduinoMock();
+}
+
+TEST(delayUntilEvent, stopsAtNextEvent) {
+  ArduinoMock* arduinoMock = arduinoMockInstance();
+  bool fired = false;
+  arduinoMock->scheduleAt(2500000, [&]() {
+    fired = true;
+  });
+  EXPECT_TRUE(delayUntilEvent(5000));
+  EXPECT_TRUE(fired);
+  EXPECT_EQ(2500000u, arduinoMock->getMicros64());
+  EXPECT_FALSE(delayUntilEvent(5000));
+  EXPECT_EQ(7500000u, arduinoMock->getMicros64());
+  releaseArduinoMock();
+}
+
+TEST(setMicrosRaw, doesNotRunEvents) {
+  ArduinoMock* arduinoMock = arduinoMockInstance();
+  bool fired = false;
+  arduinoMock->scheduleAt(1000, [&]() {
+    fired = true;
+  });
+  arduinoMock->setMillisRaw(10);
+  EXPECT_FALSE(fired);
+  arduinoMock->addMicrosRaw(0);
+  EXPECT_TRUE(fired);
+  releaseArduinoMock();
+}
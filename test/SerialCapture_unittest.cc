@@ -0,0 +1,104 @@
+#include "gtest/gtest.h"
+#include "arduino-mock/Arduino.h"
+#include "arduino-mock/Serial.h"
+#include "arduino-mock/SerialCapture.h"
+
+#include <string>
+
+TEST(SerialCapture, serialOutput) {
+  SerialCapture* capture = serialCaptureInstance();
+  // No SerialMock and no expectations needed
+  EXPECT_EQ(5u, Serial.print("temp="));
+  EXPECT_EQ(3u, Serial.print(-12));
+  EXPECT_EQ(1u, Serial.print(','));
+  EXPECT_EQ(2u, Serial.print(78, HEX));
+  EXPECT_EQ(3u, Serial.print(78ul, OCT));
+  EXPECT_EQ(8u, Serial.println(1.23456, 4));
+  EXPECT_EQ(4u, Serial.println("OK"));
+  EXPECT_EQ(1u, Serial.write('x'));
+  EXPECT_EQ(3u, Serial.write((const uint8_t*)"yz\n", 3));
+  EXPECT_EQ("temp=-12,4E1161.2346\r\nOK\r\nxyz\n", capture->str());
+
+  std::vector<CaptureView> lines = capture->lines();
+  ASSERT_EQ(3u, lines.size());
+  EXPECT_EQ("temp=-12,4E1161.2346", lines[0]);
+  EXPECT_EQ("OK", lines[1]);
+  EXPECT_EQ("xyz", lines[2]);
+  releaseSerialCapture();
+}
+
+TEST(SerialCapture, linesSpanChunks) {
+  SerialCapture capture;
+  const std::string line(1000, 'a');
+  size_t lines = 0;
+  while (capture.chunkCount() < 4) {
+    capture.append(line.data(), line.size() - 1);
+    capture.append('b');
+    capture.append("\n");
+    lines++;
+  }
+  // a line longer than a chunk spans several of them
+  const std::string huge(SerialCapture::chunk_size + 10, 'c');
+  capture.append(huge.data(), huge.size());
+  capture.append("\r\nend");
+
+  EXPECT_EQ(lines * 1001 + huge.size() + 5, capture.size());
+  size_t total = 0;
+  for (size_t i = 0; i < capture.chunkCount(); i++) {
+    total += capture.chunk(i).length;
+  }
+  EXPECT_EQ(capture.size(), total);
+
+  std::vector<CaptureView> views = capture.lines();
+  ASSERT_EQ(lines + 2, views.size());
+  for (size_t i = 0; i < lines; i++) {
+    ASSERT_EQ(line.substr(0, 999) + "b", views[i].str());
+  }
+  EXPECT_EQ(huge, views[lines].str());
+  EXPECT_EQ("end", views[lines + 1]);
+  // Views of joined lines stay valid while more is captured
+  capture.append("ing\n");
+  std::vector<CaptureView> again = capture.lines();
+  EXPECT_EQ(huge.size(), views[lines].length);
+  EXPECT_EQ("ending", again[lines + 1]);
+  EXPECT_EQ("end", views[lines + 1]);
+
+  capture.clear();
+  EXPECT_TRUE(capture.empty());
+  EXPECT_EQ("", capture.str());
+  EXPECT_TRUE(capture.lines().empty());
+}
+
+TEST(SerialCapture, startsSmall) {
+  SerialCapture capture;
+  capture.append("OK\r\n");
+  EXPECT_EQ(1u, capture.chunkCount());
+  const std::string more(SerialCapture::first_chunk_size, 'x');
+  capture.append(more.data(), more.size());
+  // the first chunk is full, the second one twice its size
+  EXPECT_EQ(2u, capture.chunkCount());
+  EXPECT_EQ(SerialCapture::first_chunk_size, capture.chunk(0).length);
+  capture.append(more.data(), more.size());
+  EXPECT_EQ(2u, capture.chunkCount());
+}
+
+TEST(SerialCapture, megabytesWithoutNewline) {
+  // Binary frames: the unfinished line grows across many chunks
+  SerialCapture capture;
+  std::string frame(1000, '\0');
+  for (size_t i = 0; i < frame.size(); i++) {
+    frame[i] = (char)(0x80 | i);  // never a newline
+  }
+  const size_t frames = 6 * 1024;
+  for (size_t i = 0; i < frames; i++) {
+    capture.append(frame.data(), frame.size());
+  }
+  EXPECT_EQ(frames * frame.size(), capture.size());
+  EXPECT_LT(capture.chunkCount(), 20u);
+  const std::vector<CaptureView> lines = capture.lines();
+  ASSERT_EQ(1u, lines.size());
+  ASSERT_EQ(capture.size(), lines[0].length);
+  EXPECT_EQ(0, memcmp(lines[0].data + 5 * frame.size(), frame.data(),
+                      frame.size()));
+  EXPECT_EQ(lines[0].str(), capture.str());
+}
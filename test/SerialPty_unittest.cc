@@ -0,0 +1,99 @@
+#include "gtest/gtest.h"
+#include "arduino-mock/Arduino.h"
+#include "arduino-mock/Serial.h"
+#include "arduino-mock/SerialPty.h"
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <string>
+
+// The tool's end of the terminal, e.g. what pyserial would open
+static int openPort(const std::string& name) {
+  const int fd = open(name.c_str(), O_RDWR | O_NOCTTY);
+  if (fd >= 0) {
+    struct termios tio;
+    tcgetattr(fd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(fd, TCSANOW, &tio);
+  }
+  return fd;
+}
+
+static std::string readPort(int fd, size_t length) {
+  std::string result;
+  char buffer[256];
+  while (result.size() < length) {
+    const ssize_t n = read(fd, buffer, sizeof(buffer));
+    if (n <= 0) {
+      break;
+    }
+    result.append(buffer, n);
+  }
+  return result;
+}
+
+TEST(SerialPty, bridgesSerial) {
+  const std::string link = ::testing::TempDir() + "ttyARDUINO";
+  SerialPty* pty = serialPtyInstance(link.c_str());
+  ASSERT_TRUE(pty->isOpen());
+  char target[256] = {0};
+  ASSERT_GT(readlink(link.c_str(), target, sizeof(target) - 1), 0);
+  EXPECT_EQ(pty->getSlaveName(), target);
+
+  const int port = openPort(link);
+  ASSERT_GE(port, 0);
+  EXPECT_EQ(0, Serial.available());
+
+  ASSERT_EQ(5, write(port, "AT+V\r", 5));
+  while (Serial.available() < 5) {
+    usleep(100);
+  }
+  EXPECT_EQ('A', Serial[0]);
+  std::string command;
+  while (Serial.available()) {
+    command += (char)Serial.read();
+  }
+  EXPECT_EQ("AT+V\r", command);
+
+  ASSERT_EQ(1, write(port, "\xFF", 1));
+  while (Serial.available() < 1) {
+    usleep(100);
+  }
+  EXPECT_EQ(0xFF, Serial[0]);
+  EXPECT_EQ(0, Serial[1]);  // past the pending bytes
+  EXPECT_EQ(0xFF, Serial.read());
+  EXPECT_EQ(0, Serial[0]);
+
+  Serial.print("v");
+  Serial.print(2, DEC);
+  Serial.println();
+  EXPECT_EQ("v2\r\n", readPort(port, 4));
+
+  // Binary output is batched and handed over on flush()
+  for (int i = 0; i < 100; i++) {
+    Serial.write((uint8_t)i);
+  }
+  Serial.flush();
+  const std::string data = readPort(port, 100);
+  ASSERT_EQ(100u, data.size());
+  EXPECT_EQ(99, data[99]);
+
+  close(port);
+  releaseSerialPty();
+  EXPECT_NE(0, access(link.c_str(), F_OK));
+}
+
+TEST(SerialPty, capsPendingOutput) {
+  // Nobody reads the terminal, so the kernel buffer fills up and the rest
+  // stays pending until tx_limit is reached
+  SerialPty pty;
+  ASSERT_TRUE(pty.isOpen());
+  const std::string chunk(1000, 'x');
+  const size_t total = 200 * chunk.size();
+  for (size_t sent = 0; sent < total; sent += chunk.size()) {
+    pty.write(chunk.data(), chunk.size());
+  }
+  EXPECT_GT(pty.getTxDropped(), 0u);
+  EXPECT_LE(pty.getTxDropped(), total - SerialPty::tx_limit);
+}
@@ -0,0 +1,99 @@
+#include "gtest/gtest.h"
+#include "arduino-mock/Arduino.h"
+#include "arduino-mock/Serial.h"
+#include "arduino-mock/SerialCapture.h"
+#include "arduino-mock/SerialReplay.h"
+#include "arduino-mock/SoftwareSerial.h"
+
+#include <string>
+
+static std::string writeModemCapture() {
+  const std::string path = ::testing::TempDir() + "modem.amsr";
+  SerialReplayWriter writer(path.c_str());
+  EXPECT_TRUE(writer.isOpen());
+  writer.record(5000000, SERIAL_TX, (const uint8_t*)"AT\r", 3);
+  writer.record(5002000, SERIAL_RX, (const uint8_t*)"OK\r\n", 4);
+  writer.record(5010000, SERIAL_TX, (const uint8_t*)"AT+CSQ\r", 7);
+  writer.record(5013500, SERIAL_RX, (const uint8_t*)"+CSQ: 17,0\r\n", 12);
+  writer.record(5013600, SERIAL_RX, (const uint8_t*)"OK\r\n", 4);
+  EXPECT_TRUE(writer.close());
+  return path;
+}
+
+TEST(SerialReplay, feedsRxOnVirtualTime) {
+  ArduinoMock* arduinoMock = arduinoMockInstance();
+  arduinoMock->setMicrosRaw(100);
+  SerialReplay replay(writeModemCapture().c_str());
+  ASSERT_TRUE(replay.isOpen());
+  EXPECT_EQ(13600u, replay.getDurationMicros());
+
+  SoftwareSerialFake modem;
+  modem.begin(9600);
+  replay.start(modem);
+  arduinoMock->addMicrosRaw(1999);
+  EXPECT_EQ(0, modem.available());
+  arduinoMock->addMicrosRaw(1);
+  EXPECT_EQ(4, modem.available());
+  uint8_t buffer[32];
+  modem.read(buffer, sizeof(buffer));
+
+  arduinoMock->addMicrosRaw(11500);
+  EXPECT_EQ(12, modem.available());
+  EXPECT_FALSE(replay.isDone());
+  arduinoMock->addMicrosRaw(100);
+  EXPECT_EQ(16, modem.available());
+  EXPECT_TRUE(replay.isDone());
+  releaseArduinoMock();
+}
+
+TEST(SerialReplay, diffsTx) {
+  SerialReplay replay(writeModemCapture().c_str());
+  replay.transmitted((const uint8_t*)"AT\rAT+", 6);
+  EXPECT_EQ("TX is missing 4 of 10 recorded bytes, from 5010000 us on",
+            replay.diffTx());
+  replay.transmitted((const uint8_t*)"CSQ\r", 4);
+  EXPECT_EQ("", replay.diffTx());
+  replay.transmitted((const uint8_t*)"\n", 1);
+  EXPECT_EQ("TX has 1 bytes more than the 10 recorded", replay.diffTx());
+
+  SerialCapture capture;
+  capture.append("AT\rAT+CSR\r");
+  EXPECT_EQ("TX differs at byte 8 (recorded at 5010000 us): "
+            "expected 0x51 'Q', got 0x52 'R'", replay.diffTx(capture));
+}
+
+TEST(SerialReplay, drivesSerialMock) {
+  ArduinoMock* arduinoMock = arduinoMockInstance();
+  SerialMock* serialMock = serialMockInstance();
+  SerialCapture* capture = serialCaptureInstance();
+  SerialReplay replay(writeModemCapture().c_str());
+  replay.start(*serialMock);
+
+  // A minimal modem driver
+  Serial.print("AT\r");
+  while (!Serial.available()) {
+    delay(1);
+  }
+  std::string reply;
+  while (Serial.available()) {
+    reply += (char)Serial.read();
+  }
+  EXPECT_EQ("OK\r\n", reply);
+  EXPECT_EQ(2u, arduinoMock->getMillis());
+  Serial.print("AT+CSQ\r");
+  EXPECT_EQ("", replay.diffTx(*capture));
+
+  releaseSerialCapture();
+  releaseSerialMock();
+  releaseArduinoMock();
+}
+
+TEST(SerialReplay, rejectsOtherFiles) {
+  const std::string path = ::testing::TempDir() + "not-a-capture.amsr";
+  FILE* file = fopen(path.c_str(), "wb");
+  fputs("hello world", file);
+  fclose(file);
+  SerialReplay replay(path.c_str());
+  EXPECT_FALSE(replay.isOpen());
+  EXPECT_EQ(0u, replay.getDurationMicros());
+}
@@ -195,6 +195,21 @@ TEST(serial, write1) {
   releaseSerialMock();
 }
 
+TEST(serial, writeDefaults) {
+  // Unless the test sets an action, the fake reports every byte written
+  SerialMock* serialMock = serialMockInstance();
+  const uint8_t frame[] = { 0x7E, 0x00, 0x04, 0x08 };
+  EXPECT_CALL(*serialMock, begin(9600));
+  EXPECT_CALL(*serialMock, write(frame, sizeof(frame)));
+  EXPECT_CALL(*serialMock, write(Matcher<uint8_t>('a')));
+  EXPECT_CALL(*serialMock, write(Matcher<const char*>(_)));
+  EXPECT_EQ(1, Serial.begin(9600));
+  EXPECT_EQ(sizeof(frame), Serial.write(frame, sizeof(frame)));
+  EXPECT_EQ(1U, Serial.write('a'));
+  EXPECT_EQ(3U, Serial.write("abc"));
+  releaseSerialMock();
+}
+
 TEST(serial, available) {
   SerialMock* serialMock = serialMockInstance();
   EXPECT_CALL(*serialMock, available())
@@ -218,3 +233,75 @@ TEST(serial, read2) {
   EXPECT_EQ(1, Serial.read());
   releaseSerialMock();
 }
+
+TEST(serial, pacedReceive) {
+  ArduinoMock* arduinoMock = arduinoMockInstance();
+  SerialMock* serialMock = serialMockInstance();
+  serialMock->getFake().setPaced(true);
+  EXPECT_CALL(*serialMock, begin(115200));
+  EXPECT_CALL(*serialMock, available()).WillRepeatedly(DoDefault());
+  EXPECT_CALL(*serialMock, read()).WillRepeatedly(DoDefault());
+  Serial.begin(115200);
+
+  // 10 bits per byte at 115200 baud: the tenth stop bit is in at 868.06 us
+  const uint8_t frame[10] = { 'A', 'T', '+', 'G', 'M', 'R', '\r', '\n', 0, 0 };
+  serialMock->mock_buffer_feed(frame, sizeof(frame));
+  EXPECT_EQ(0, Serial.available());
+  arduinoMock->addMicrosRaw(87);
+  EXPECT_EQ(1, Serial.available());
+  EXPECT_EQ('A', Serial.read());
+  arduinoMock->addMicrosRaw(868 - 87);
+  EXPECT_EQ(8, Serial.available());
+  arduinoMock->addMicrosRaw(1);
+  EXPECT_EQ(9, Serial.available());
+
+  // Every pending byte is an event, so waiting for data wakes up on time
+  const uint8_t more = 'x';
+  serialMock->mock_buffer_feed(&more, 1);
+  EXPECT_TRUE(delayUntilEvent(1000));
+  EXPECT_EQ(869U + 87, arduinoMock->getMicros64());
+  EXPECT_EQ(10, Serial.available());
+
+  releaseSerialMock();
+  releaseArduinoMock();
+}
+
+TEST(serial, pacedOverrun) {
+  ArduinoMock* arduinoMock = arduinoMockInstance();
+  SerialMock* serialMock = serialMockInstance();
+  serialMock->getFake().setPaced(true, 64, 64);
+  EXPECT_CALL(*serialMock, begin(115200));
+  EXPECT_CALL(*serialMock, available()).WillRepeatedly(DoDefault());
+  Serial.begin(115200);
+
+  uint8_t burst[100];
+  memset(burst, 'U', sizeof(burst));
+  serialMock->mock_buffer_feed(burst, sizeof(burst));
+  arduinoMock->addMillisRaw(100);  // the sketch is busy meanwhile
+  EXPECT_EQ(64, Serial.available());
+  EXPECT_EQ(36U, serialMock->getFake().getRxOverruns());
+
+  releaseSerialMock();
+  releaseArduinoMock();
+}
+
+TEST(serial, pacedTransmit) {
+  ArduinoMock* arduinoMock = arduinoMockInstance();
+  SerialMock* serialMock = serialMockInstance();
+  serialMock->getFake().setPaced(true, 64, 64);
+  EXPECT_CALL(*serialMock, begin(9600));
+  EXPECT_CALL(*serialMock, write(_, _)).WillRepeatedly(DoDefault());
+  EXPECT_CALL(*serialMock, flush());
+  Serial.begin(9600);
+
+  // Blocks until the last 64 bytes fit into the TX FIFO, i.e. until 36 of
+  // the 100 bytes are out, at 1041.67 us each
+  uint8_t block[100] = { 0 };
+  EXPECT_EQ(100U, Serial.write(block, sizeof(block)));
+  EXPECT_EQ(37500U, arduinoMock->getMicros64());
+  Serial.flush();
+  EXPECT_EQ(104167U, arduinoMock->getMicros64());
+
+  releaseSerialMock();
+  releaseArduinoMock();
+}
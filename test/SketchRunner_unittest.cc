@@ -0,0 +1,96 @@
+#include "gtest/gtest.h"
+#include "arduino-mock/Arduino.h"
+#include "arduino-mock/SketchRunner.h"
+
+#include <sstream>
+
+using ::testing::_;
+
+static int sketchSetups;
+static int sketchLoops;
+
+static void countingSetup(void) {
+  sketchSetups++;
+}
+
+static void blinkingSetup(void) {
+  sketchSetups++;
+  pinMode(13, OUTPUT);
+}
+
+static void blinkingLoop(void) {
+  sketchLoops++;
+  digitalWrite(13, sketchLoops & 1);
+  delay(10);
+}
+
+static void idleLoop(void) {
+  sketchLoops++;
+}
+
+TEST(SketchRunner, runLoops) {
+  sketchSetups = sketchLoops = 0;
+  ArduinoMock* arduinoMock = arduinoMockInstance();
+  ArduinoFake* fake = arduinoFakeInstance();
+  EXPECT_CALL(*arduinoMock, delay(10)).Times(150);
+  SketchRunner runner(blinkingSetup, blinkingLoop);
+  runner.setSlowestCount(3);
+  SketchStats stats = runner.runLoops(100);
+  EXPECT_EQ(1, sketchSetups);
+  EXPECT_EQ(100u, stats.loops);
+  EXPECT_EQ(1000000u, stats.virtualMicros);
+  EXPECT_EQ(3u, stats.slowest.size());
+  EXPECT_GE(stats.slowest[0].wallNanos, stats.slowest[2].wallNanos);
+
+  stats = runner.runLoops(50);
+  EXPECT_EQ(1, sketchSetups);
+  EXPECT_EQ(50u, stats.loops);
+  EXPECT_EQ(150u, fake->getWriteCount(13));
+
+  std::stringstream report;
+  report << stats;
+  EXPECT_NE(std::string::npos, report.str().find("loops: 50"));
+  releaseArduinoFake();
+  releaseArduinoMock();
+}
+
+TEST(SketchRunner, runForVirtualTime) {
+  sketchSetups = sketchLoops = 0;
+  ArduinoMock* arduinoMock = arduinoMockInstance();
+  arduinoFakeInstance();
+  EXPECT_CALL(*arduinoMock, delay(10)).Times(6000);
+  SketchRunner runner(blinkingSetup, blinkingLoop);
+  SketchStats stats = runner.runFor(60 * 1000);
+  EXPECT_EQ(6000u, stats.loops);
+  EXPECT_EQ(60000000u, stats.virtualMicros);
+  releaseArduinoFake();
+  releaseArduinoMock();
+}
+
+TEST(SketchRunner, runForSkipsIdleTime) {
+  sketchSetups = sketchLoops = 0;
+  ArduinoMock* arduinoMock = arduinoMockInstance();
+  int events = 0;
+  arduinoMock->scheduleAt(5000000, [&]() {
+    events++;
+  });
+  SketchRunner runner(countingSetup, idleLoop);
+  SketchStats stats = runner.runFor(10 * 1000);
+  EXPECT_EQ(1, events);
+  EXPECT_EQ(2u, stats.loops);
+  EXPECT_EQ(10000000u, stats.virtualMicros);
+  releaseArduinoMock();
+}
+
+TEST(SketchRunner, runUntilPredicate) {
+  sketchSetups = sketchLoops = 0;
+  SketchRunner runner(countingSetup, idleLoop);
+  SketchStats stats = runner.runUntil([]() {
+    return sketchLoops >= 43;
+  });
+  EXPECT_EQ(43u, stats.loops);
+  stats = runner.runUntil([]() {
+    return false;
+  }, 7);
+  EXPECT_EQ(7u, stats.loops);
+}
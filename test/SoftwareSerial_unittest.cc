@@ -0,0 +1,83 @@
+#include "gtest/gtest.h"
+#include "arduino-mock/SoftwareSerial.h"
+#include "arduino-mock/MockContext.h"
+
+#include <memory>
+
+TEST(SoftwareSerialFake, listenArbitration) {
+  SoftwareSerialFake gps;
+  SoftwareSerialFake co2;
+  SoftwareSerialFake pm;
+  EXPECT_FALSE(pm.isListening());  // not before begin()
+  EXPECT_EQ(NULL, SoftwareSerialFake::getListener());
+  pm.begin(9600);
+  EXPECT_TRUE(pm.isListening());
+  EXPECT_EQ(&pm, SoftwareSerialFake::getListener());
+
+  EXPECT_TRUE(gps.listen());
+  EXPECT_FALSE(gps.listen());
+  EXPECT_TRUE(gps.isListening());
+  EXPECT_FALSE(pm.isListening());
+
+  const uint8_t reading[] = { 0xFF, 0x86, 0x01, 0x90 };
+  co2.feed(reading, sizeof(reading));
+  gps.feed(reading, sizeof(reading));
+  EXPECT_EQ(0, co2.available());
+  EXPECT_EQ(sizeof(reading), co2.getDropped());
+  EXPECT_EQ(4, gps.available());
+  EXPECT_EQ(0U, gps.getDropped());
+
+  // Bytes received before another instance took over stay readable
+  co2.listen();
+  EXPECT_EQ(4, gps.available());
+  co2.restore_listener();
+  EXPECT_TRUE(gps.isListening());
+
+  EXPECT_FALSE(co2.stopListening());
+  EXPECT_TRUE(gps.stopListening());
+  EXPECT_EQ(NULL, SoftwareSerialFake::getListener());
+  gps.feed(reading, sizeof(reading));
+  EXPECT_EQ(sizeof(reading), gps.getDropped());
+}
+
+TEST(SoftwareSerialFake, overflow) {
+  SoftwareSerialFake sensor;
+  sensor.begin(9600);
+  sensor.setRxBufferSize(SoftwareSerialFake::ss_max_rx_buff);
+  uint8_t burst[100];
+  memset(burst, 'U', sizeof(burst));
+  sensor.feed(burst, sizeof(burst));
+  EXPECT_EQ(64, sensor.available());
+  EXPECT_EQ(36U, sensor.getOverflowed());
+  EXPECT_TRUE(sensor.overflow());
+  EXPECT_FALSE(sensor.overflow());  // reading the flag clears it
+}
+
+TEST(SoftwareSerialMock, listenDelegatesToFake) {
+  SoftwareSerialMock first;
+  SoftwareSerialMock second;
+  EXPECT_CALL(first, begin(9600));
+  EXPECT_CALL(first, isListening());
+  EXPECT_CALL(second, isListening());
+  first.begin(9600);
+  EXPECT_TRUE(first.isListening());
+  EXPECT_FALSE(second.isListening());
+
+  const uint8_t data[] = { 'O', 'K' };
+  second.mock_buffer_feed(data, sizeof(data));
+  EXPECT_EQ(sizeof(data), second.getFake().getDropped());
+}
+
+TEST(SoftwareSerialFake, outlivesContext) {
+  std::unique_ptr<SoftwareSerialFake> modem;
+  {
+    ScopedMockContext context;
+    modem.reset(new SoftwareSerialFake());
+    modem->listen();
+  }
+  // The registry stays alive as long as a fake uses it
+  const uint8_t data[] = { 'O', 'K' };
+  modem->feed(data, sizeof(data));
+  EXPECT_EQ(2, modem->available());
+  EXPECT_TRUE(modem->stopListening());
+}
@@ -0,0 +1,350 @@
+#include "gtest/gtest.h"
+#include "arduino-mock/Arduino.h"
+#include "arduino-mock/MockContext.h"
+#include "Stream.h"
+
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <string>
+
+// A Stream over a string, showing at most chunk bytes at a time through the
+// peek buffer, or going byte by byte without it. append() adds data, e.g.
+// from an event scheduled on the virtual clock.
+class ChunkedStream : public Stream {
+
+  public:
+    explicit ChunkedStream(bool peekBufferAPI = true, size_t chunk = SIZE_MAX)
+      : peekBufferAPI(peekBufferAPI), chunk(chunk), position(0), reads(0),
+        consumes(0) {
+    }
+
+    void append(const std::string& more) {
+      data += more;
+    }
+
+    int available() {
+      return data.size() - position;
+    }
+    int read() {
+      reads++;
+      return position < data.size() ? (uint8_t)data[position++] : -1;
+    }
+    int peek() {
+      return position < data.size() ? (uint8_t)data[position] : -1;
+    }
+    void flush() {}
+    size_t write(const uint8_t* buffer, size_t size) {
+      (void)buffer;
+      return size;
+    }
+
+    bool hasPeekBufferAPI() const {
+      return peekBufferAPI;
+    }
+    size_t peekAvailable() {
+      return std::min(chunk, data.size() - position);
+    }
+    const char* peekBuffer() {
+      return data.data() + position;
+    }
+    void peekConsume(size_t consume) {
+      consumes++;
+      position += consume;
+    }
+
+    const bool peekBufferAPI;
+    const size_t chunk;
+    std::string data;
+    size_t position;
+    size_t reads;
+    size_t consumes;
+};
+
+TEST(Stream, readBytesCopiesChunks) {
+  ScopedMockContext context;
+  arduinoMockInstance();
+  ChunkedStream stream(true, 4);
+  stream.append("0123456789");
+  char buffer[8];
+  EXPECT_EQ(8U, stream.readBytes(buffer, sizeof(buffer)));
+  EXPECT_EQ("01234567", std::string(buffer, 8));
+  EXPECT_EQ(0U, stream.reads);
+  EXPECT_EQ(2U, stream.consumes);  // two whole chunks
+  EXPECT_EQ(2, stream.available());
+}
+
+TEST(Stream, readBytesWaitsForMoreUntilTimeout) {
+  ScopedMockContext context;
+  ArduinoMock* arduinoMock = arduinoMockInstance();
+  ChunkedStream stream(true, 4);
+  stream.setTimeout(50);
+  stream.append("abc");
+  arduinoMock->scheduleIn(20000, [&]() { stream.append("defgh"); });
+  char buffer[16];
+  EXPECT_EQ(8U, stream.readBytes(buffer, sizeof(buffer)));
+  EXPECT_EQ("abcdefgh", std::string(buffer, 8));
+  // The timeout starts again with each wait
+  EXPECT_EQ(70000U, arduinoMock->getMicros64());
+  EXPECT_EQ(0U, stream.reads);
+}
+
+TEST(Stream, readStringCopiesChunks) {
+  ScopedMockContext context;
+  ArduinoMock* arduinoMock = arduinoMockInstance();
+  ChunkedStream stream(true, 3);
+  stream.setTimeout(10);
+  stream.append("HTTP/1.1 200 OK\r\n");
+  String line = stream.readString();
+  EXPECT_STREQ("HTTP/1.1 200 OK\r\n", line.c_str());
+  EXPECT_EQ(17U, line.length());
+  EXPECT_EQ(0U, stream.reads);
+  EXPECT_EQ(10000U, arduinoMock->getMicros64());
+}
+
+TEST(Stream, readUntilCopiesChunks) {
+  ScopedMockContext context;
+  arduinoMockInstance();
+  ChunkedStream stream(true, 4);
+  stream.append("key=value\nrest");
+  EXPECT_STREQ("key=value", stream.readStringUntil('\n').c_str());
+  char buffer[8];
+  stream.append(";");
+  EXPECT_EQ(4U, stream.readBytesUntil(';', buffer, sizeof(buffer)));
+  EXPECT_EQ("rest", std::string(buffer, 4));
+  EXPECT_EQ(0, stream.available());
+  EXPECT_EQ(0U, stream.reads);
+}
+
+TEST(Stream, peekBufferMatchesRead) {
+  ScopedMockContext context;
+  arduinoMockInstance();
+  const std::string text = "line one\nline two\nthree";
+  for (int api = 0; api < 2; api++) {
+    ChunkedStream stream(api == 1, 5);
+    stream.setTimeout(1);
+    stream.append(text);
+    char buffer[6];
+    EXPECT_EQ(6U, stream.readBytes(buffer, sizeof(buffer)));
+    EXPECT_EQ("line o", std::string(buffer, 6));
+    EXPECT_STREQ("ne", stream.readStringUntil('\n').c_str());
+    // Stops at the length before it reaches the terminator
+    EXPECT_EQ(6U, stream.readBytesUntil('\n', buffer, sizeof(buffer)));
+    EXPECT_EQ("line t", std::string(buffer, 6));
+    EXPECT_STREQ("wo\nthree", stream.readString().c_str());
+  }
+}
+
+TEST(StreamFake, readsAcrossTheWrap) {
+  ScopedMockContext context;
+  ArduinoMock* arduinoMock = arduinoMockInstance();
+  StreamFake stream(16);
+  stream.setTimeout(10);
+  stream.feed("0123456789ab");
+  char buffer[12];
+  EXPECT_EQ(10U, stream.readBytes(buffer, 10));
+  // Wraps around the end of the ring, so the peek buffer shows two runs
+  stream.feed("cdefghij\nrest");
+  EXPECT_EQ(6U, stream.peekAvailable());
+  EXPECT_STREQ("abcdefghij", stream.readStringUntil('\n').c_str());
+  arduinoMock->scheduleIn(5000, [&]() { stream.feed(" of it"); });
+  EXPECT_STREQ("rest of it", stream.readString().c_str());
+  EXPECT_EQ(15000U, arduinoMock->getMicros64());
+  EXPECT_EQ(-1, stream.read());
+
+  stream.write((const uint8_t*)"AT\r\n", 4);
+  EXPECT_EQ("AT\r\n", stream.getWritten());
+}
+
+TEST(StreamFake, parsesLikeAnyStream) {
+  ScopedMockContext context;
+  arduinoMockInstance();
+  StreamFake stream;
+  stream.setTimeout(0);
+  stream.feed("12;-3.5;OK\r\n");
+  EXPECT_EQ(12, stream.parseInt());
+  EXPECT_EQ(';', stream.read());
+  EXPECT_FLOAT_EQ(-3.5f, stream.parseFloat());
+  EXPECT_TRUE(stream.find("OK"));
+  EXPECT_EQ('\r', stream.peek());
+  EXPECT_EQ(2, stream.available());
+}
+
+TEST(Stream, findMultiOverlappingNeedles) {
+  ScopedMockContext context;
+  arduinoMockInstance();
+  for (int api = 0; api < 2; api++) {
+    ChunkedStream stream(api == 1, 3);
+    stream.setTimeout(1);
+    // "ABAC" restarts inside the partial match "ABAB"
+    stream.append("xABABACy");
+    EXPECT_TRUE(stream.find("ABAC"));
+    EXPECT_EQ('y', stream.read());
+
+    // "BCD" ends first although "CDE" starts later
+    stream.append("ABCDE");
+    EXPECT_EQ(1, stream.findAny({ "CDE", "BCD" }));
+    EXPECT_EQ('E', stream.read());
+
+    // Both end on the same byte: the lower index wins
+    stream.append("aaab!");
+    EXPECT_EQ(0, stream.findAny({ "aab", "ab" }));
+    EXPECT_EQ('!', stream.read());
+  }
+}
+
+TEST(Stream, findMultiPrefixNeedle) {
+  ScopedMockContext context;
+  arduinoMockInstance();
+  for (int api = 0; api < 2; api++) {
+    ChunkedStream stream(api == 1, 4);
+    stream.setTimeout(1);
+    stream.append("+CME ERROR: 10\r\n");
+    // The shorter needle is found as soon as it is complete
+    EXPECT_EQ(1, stream.findAny({ "+CME ERROR", "+CME" }));
+    EXPECT_EQ(' ', stream.read());
+    EXPECT_EQ(1, stream.findAny({ "\r\n", "\r" }));
+    EXPECT_EQ('\n', stream.read());
+  }
+}
+
+TEST(Stream, findMultiTimesOutMidMatch) {
+  ScopedMockContext context;
+  ArduinoMock* arduinoMock = arduinoMockInstance();
+  for (int api = 0; api < 2; api++) {
+    ChunkedStream stream(api == 1, 2);
+    stream.setTimeout(100);
+    const uint64_t start = arduinoMock->getMicros64();
+    stream.append("xxERR");
+    EXPECT_EQ(-1, stream.findAny({ "ERROR", "OK" }));
+    EXPECT_EQ(start + 100000, arduinoMock->getMicros64());
+    EXPECT_EQ(0, stream.available());
+    // The next search starts over, the partial match is gone
+    stream.append("OR\r\nOK");
+    EXPECT_EQ(1, stream.findAny({ "ERROR", "OK" }));
+  }
+}
+
+TEST(Stream, findAnyWithoutTargets) {
+  ScopedMockContext context;
+  ArduinoMock* arduinoMock = arduinoMockInstance();
+  ChunkedStream stream;
+  stream.append("OK");
+  EXPECT_EQ(-1, stream.findAny({}));
+  EXPECT_EQ(2, stream.available());
+  EXPECT_EQ(0U, arduinoMock->getMicros64());
+  // An empty needle is found right away
+  EXPECT_EQ(1, stream.findAny({ "ERROR", "" }));
+  EXPECT_EQ(2, stream.available());
+}
+
+TEST(Stream, parseIntSaturates) {
+  ScopedMockContext context;
+  arduinoMockInstance();
+  ChunkedStream stream(true, 5);
+  stream.setTimeout(1);
+  const std::string max = std::to_string(LONG_MAX);
+  const std::string min = std::to_string(LONG_MIN);
+  stream.append(max + " " + min + " ");
+  EXPECT_EQ(LONG_MAX, stream.parseInt());
+  EXPECT_FALSE(stream.parseOverflowed());
+  EXPECT_EQ(LONG_MIN, stream.parseInt());
+  EXPECT_FALSE(stream.parseOverflowed());
+
+  // One more in magnitude, and far beyond: the digits are all taken
+  stream.append("9223372036854775808 -9223372036854775809 ");
+  stream.append("123456789012345678901234567890;");
+  EXPECT_EQ(LONG_MAX, stream.parseInt());
+  EXPECT_TRUE(stream.parseOverflowed());
+  EXPECT_EQ(LONG_MIN, stream.parseInt());
+  EXPECT_TRUE(stream.parseOverflowed());
+  EXPECT_EQ(LONG_MAX, stream.parseInt());
+  EXPECT_TRUE(stream.parseOverflowed());
+  EXPECT_EQ(';', stream.read());
+
+  // The flag describes the last call only
+  stream.append("42 ");
+  EXPECT_EQ(42, stream.parseInt());
+  EXPECT_FALSE(stream.parseOverflowed());
+}
+
+TEST(Stream, parseCsvRowOverflowIsSticky) {
+  ScopedMockContext context;
+  arduinoMockInstance();
+  ChunkedStream stream(false);
+  stream.setTimeout(1);
+  long values[3];
+  // Set by the first field, kept through the fields after it
+  stream.append("99999999999999999999,2,3\n4,5,6\n");
+  EXPECT_EQ(3U, stream.parseCsvRow(values, 3));
+  EXPECT_EQ(LONG_MAX, values[0]);
+  EXPECT_EQ(3, values[2]);
+  EXPECT_TRUE(stream.parseOverflowed());
+  EXPECT_EQ(3U, stream.parseCsvRow(values, 3));
+  EXPECT_FALSE(stream.parseOverflowed());
+
+  float floats[2];
+  stream.append("1" + std::string(40, '0') + ",0.5\n");
+  EXPECT_EQ(2U, stream.parseCsvRow(floats, 2));
+  EXPECT_TRUE(isinf(floats[0]));
+  EXPECT_FLOAT_EQ(0.5f, floats[1]);
+  EXPECT_TRUE(stream.parseOverflowed());
+}
+
+TEST(Stream, decimalPoint) {
+  ScopedMockContext context;
+  arduinoMockInstance();
+  ChunkedStream stream(true, 3);
+  stream.setTimeout(1);
+  stream.setDecimalPoint(',');
+  stream.append("Temperatur: 21,75 C\n");
+  EXPECT_FLOAT_EQ(21.75f, stream.parseFloat());
+
+  float values[3];
+  stream.readStringUntil('\n');
+  stream.append("1,5;-2,25;,5\n");
+  ASSERT_EQ(3U, stream.parseCsvRow(values, 3, ';'));
+  EXPECT_FLOAT_EQ(1.5f, values[0]);
+  EXPECT_FLOAT_EQ(-2.25f, values[1]);
+  EXPECT_FLOAT_EQ(0.5f, values[2]);
+
+  // '.' is no longer part of a number
+  stream.append("3.5\n");
+  EXPECT_EQ(1U, stream.parseCsvRow(values, 3, ';'));
+  EXPECT_FLOAT_EQ(3.0f, values[0]);
+}
+
+TEST(Stream, parseCsvRowLength) {
+  ScopedMockContext context;
+  arduinoMockInstance();
+  for (int api = 0; api < 2; api++) {
+    ChunkedStream stream(api == 1, 4);
+    stream.setTimeout(1);
+    long values[3] = { -1, -1, -1 };
+
+    // A short row fills the first fields only
+    stream.append("10,20\n");
+    EXPECT_EQ(2U, stream.parseCsvRow(values, 3));
+    EXPECT_EQ(10, values[0]);
+    EXPECT_EQ(20, values[1]);
+    EXPECT_EQ(-1, values[2]);
+
+    // An over-long row is consumed up to its end of line
+    stream.append("1,2,3,4,5\n7\n");
+    EXPECT_EQ(3U, stream.parseCsvRow(values, 3));
+    EXPECT_EQ(3, values[2]);
+    EXPECT_EQ(1U, stream.parseCsvRow(values, 3));
+    EXPECT_EQ(7, values[0]);
+
+    // Empty fields, a blank line and the end of the data
+    float floats[3];
+    stream.append(",2,\n\n");
+    EXPECT_EQ(3U, stream.parseCsvRow(floats, 3));
+    EXPECT_TRUE(isnan(floats[0]));
+    EXPECT_FLOAT_EQ(2.0f, floats[1]);
+    EXPECT_TRUE(isnan(floats[2]));
+    EXPECT_EQ(0U, stream.parseCsvRow(floats, 3));
+    EXPECT_EQ(0U, stream.parseCsvRow(floats, 3));
+  }
+}
@@ -0,0 +1,80 @@
+#include "gtest/gtest.h"
+#include "arduino-mock/StringAllocator.h"
+#include "arduino-mock/MockContext.h"
+
+#include <string.h>
+
+TEST(StringAllocator, defaultIsMalloc) {
+  ScopedMockContext context;
+  StringAllocator& allocator = stringAllocator();
+  allocator.resetCounters();
+  char* buffer = (char*)allocator.reallocate(NULL, 0, 32);
+  ASSERT_TRUE(buffer != NULL);
+  strcpy(buffer, "grown past SSO");
+  buffer = (char*)allocator.reallocate(buffer, 32, 64);
+  EXPECT_STREQ("grown past SSO", buffer);
+  allocator.release(buffer, 64);
+  EXPECT_EQ(2U, allocator.getAllocations());
+  EXPECT_EQ(1U, allocator.getReleases());
+}
+
+TEST(StringAllocator, setPerContext) {
+  PoolStringAllocator pool;
+  ScopedMockContext context;
+  EXPECT_EQ(NULL, setStringAllocator(&pool));
+  EXPECT_EQ(&pool, &stringAllocator());
+  {
+    ScopedMockContext inner;
+    EXPECT_NE(&pool, &stringAllocator());
+  }
+  EXPECT_EQ(&pool, setStringAllocator(NULL));
+}
+
+TEST(PoolStringAllocator, reusesSizeClasses) {
+  PoolStringAllocator pool;
+  void* a = pool.reallocate(NULL, 0, 32);
+  void* b = pool.reallocate(NULL, 0, 32);
+  EXPECT_NE(a, b);
+  pool.release(a, 32);
+  EXPECT_EQ(a, pool.reallocate(NULL, 0, 32));
+
+  // Growing within the 64 byte class keeps the buffer
+  char* c = (char*)pool.reallocate(NULL, 0, 48);
+  strcpy(c, "json");
+  EXPECT_EQ(c, pool.reallocate(c, 48, 64));
+  char* d = (char*)pool.reallocate(c, 64, 80);
+  EXPECT_NE(c, d);
+  EXPECT_STREQ("json", d);
+  EXPECT_EQ(c, pool.reallocate(NULL, 0, 64));  // c went back to its free list
+
+  // Beyond max_class buffers come from malloc()
+  char* big = (char*)pool.reallocate(NULL, 0, 4096);
+  memset(big, 'x', 4096);
+  big = (char*)pool.reallocate(big, 4096, 8192);
+  EXPECT_EQ('x', big[4095]);
+  pool.release(big, 8192);
+  EXPECT_EQ(32U + 32 + 80 + 64, pool.getBytesInUse());
+}
+
+TEST(ArenaStringAllocator, bumpAndReset) {
+  ArenaStringAllocator arena(256);
+  char* a = (char*)arena.reallocate(NULL, 0, 32);
+  strcpy(a, "header");
+  // The most recent buffer grows in place
+  EXPECT_EQ(a, arena.reallocate(a, 32, 96));
+  char* b = (char*)arena.reallocate(NULL, 0, 32);
+  EXPECT_EQ(a + 96, b);
+  char* grown = (char*)arena.reallocate(a, 96, 112);
+  EXPECT_NE(a, grown);
+  EXPECT_STREQ("header", grown);
+
+  // Bigger than a chunk, so it gets a chunk of its own
+  char* big = (char*)arena.reallocate(NULL, 0, 1024);
+  memset(big, 'x', 1024);
+  EXPECT_EQ(5U, arena.getAllocations());
+
+  arena.reset();
+  EXPECT_EQ(a, arena.reallocate(NULL, 0, 16));
+  // The chunk kept for big is reused after the reset
+  EXPECT_EQ(big, arena.reallocate(NULL, 0, 1000));
+}
@@ -0,0 +1,111 @@
+#include "gtest/gtest.h"
+#include "arduino-mock/StringSearch.h"
+
+#include <string.h>
+#include <string>
+
+TEST(StringSearch, findChar) {
+  // Long enough to cover whole blocks and the tail, with an embedded NUL
+  std::string text(100, '.');
+  text[3] = '\0';
+  text[40] = 'x';
+  text[97] = 'x';
+  EXPECT_EQ(text.data() + 40, stringFindChar(text.data(), text.size(), 'x'));
+  EXPECT_EQ(text.data() + 97, stringFindLastChar(text.data(), text.size(), 'x'));
+  EXPECT_EQ(text.data() + 40, stringFindLastChar(text.data(), 97, 'x'));
+  EXPECT_EQ(text.data() + 3, stringFindChar(text.data(), text.size(), '\0'));
+  EXPECT_EQ(NULL, stringFindChar(text.data(), 40, 'x'));
+  EXPECT_EQ(NULL, stringFindLastChar(text.data(), 0, '.'));
+}
+
+TEST(StringSearch, find) {
+  const std::string headers =
+    "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\n"
+    "Content-Length: 1234\r\nConnection: close\r\n\r\n";
+  const char* h = headers.data();
+  EXPECT_EQ(h + headers.find("\r\n\r\n"),
+            stringFind(h, headers.size(), "\r\n\r\n", 4));
+  EXPECT_EQ(h + headers.find("Content-Length"),
+            stringFind(h, headers.size(), "Content-Length", 14));
+  EXPECT_EQ(h + headers.rfind("Content"),
+            stringFindLast(h, headers.size(), "Content", 7));
+  EXPECT_EQ(NULL, stringFind(h, headers.size(), "Content-Encoding", 16));
+  EXPECT_EQ(NULL, stringFindLast(h, 10, "OK", 2));
+  EXPECT_EQ(h, stringFind(h, headers.size(), "", 0));
+  EXPECT_EQ(h + 5, stringFindLast(h, 5, "", 0));
+}
+
+TEST(StringSearch, findAgainstReference) {
+  // Two-letter haystacks make for many overlapping partial matches
+  unsigned int seed = 1;
+  for (int i = 0; i < 2000; i++) {
+    std::string haystack(i % 300, 'a');
+    std::string needle(1 + i % 9, 'a');
+    for (size_t j = 0; j < haystack.size(); j++) {
+      seed = seed * 1103515245 + 12345;
+      haystack[j] = (seed >> 16) % 5 ? 'a' : 'b';
+    }
+    for (size_t j = 0; j < needle.size(); j++) {
+      seed = seed * 1103515245 + 12345;
+      needle[j] = (seed >> 16) % 5 ? 'a' : 'b';
+    }
+    const char* h = haystack.data();
+    const size_t first = haystack.find(needle);
+    const size_t last = haystack.rfind(needle);
+    EXPECT_EQ(first == std::string::npos ? NULL : h + first,
+              stringFind(h, haystack.size(), needle.data(), needle.size()));
+    EXPECT_EQ(last == std::string::npos ? NULL : h + last,
+              stringFindLast(h, haystack.size(), needle.data(), needle.size()));
+  }
+}
+
+TEST(StringSearch, findPeriodicNeedle) {
+  // Defeats the first/last byte filter, so Two-Way finishes the search
+  std::string haystack(20000, 'a');
+  std::string needle(300, 'a');
+  needle[299] = 'b';
+  EXPECT_EQ(NULL, stringFind(haystack.data(), haystack.size(),
+                             needle.data(), needle.size()));
+  haystack[15000] = 'b';
+  EXPECT_EQ(haystack.data() + 14701, stringFind(haystack.data(), haystack.size(),
+                                                needle.data(), needle.size()));
+}
+
+TEST(StringSearch, findLastPeriodicNeedle) {
+  // The backwards search meets the same worst case at the other end
+  std::string haystack(20000, 'a');
+  std::string needle(300, 'a');
+  needle[299] = 'b';
+  EXPECT_EQ(NULL, stringFindLast(haystack.data(), haystack.size(),
+                                 needle.data(), needle.size()));
+  haystack[5000] = 'b';
+  EXPECT_EQ(haystack.data() + 4701, stringFindLast(haystack.data(), haystack.size(),
+                                                   needle.data(), needle.size()));
+  needle[299] = 'a';
+  needle[0] = 'b';
+  EXPECT_EQ(haystack.data() + 5000, stringFindLast(haystack.data(), haystack.size(),
+                                                   needle.data(), needle.size()));
+  haystack[5000] = 'a';
+  EXPECT_EQ(NULL, stringFindLast(haystack.data(), haystack.size(),
+                                 needle.data(), needle.size()));
+}
+
+TEST(StringSearch, caseFolding) {
+  std::string text = "Content-Type: TEXT/html; charset=\xC3\x84UTF-8 [@`{]";
+  text += text;
+  std::string lower = text;
+  std::string upper = text;
+  stringToLower(&lower[0], lower.size());
+  stringToUpper(&upper[0], upper.size());
+  std::string half = "content-type: text/html; charset=\xC3\x84utf-8 [@`{]";
+  EXPECT_EQ(half + half, lower);
+  half = "CONTENT-TYPE: TEXT/HTML; CHARSET=\xC3\x84UTF-8 [@`{]";
+  EXPECT_EQ(half + half, upper);
+
+  EXPECT_TRUE(stringEqualsIgnoreCase(text.data(), lower.data(), text.size()));
+  EXPECT_TRUE(stringEqualsIgnoreCase(upper.data(), lower.data(), text.size()));
+  lower[text.size() - 2] = '}';
+  EXPECT_FALSE(stringEqualsIgnoreCase(text.data(), lower.data(), text.size()));
+  // '@' and '`' differ only in bit 0x20, but are not letters
+  EXPECT_FALSE(stringEqualsIgnoreCase("@", "`", 1));
+}
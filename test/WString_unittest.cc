@@ -0,0 +1,323 @@
+#include "gtest/gtest.h"
+#include "arduino-mock/Arduino.h"
+#include "arduino-mock/MockContext.h"
+#include "arduino-mock/StringAllocator.h"
+#include "arduino-mock/EspHeap.h"
+#include "include/WString.h"
+
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+TEST(String, concatTakesLength) {
+  // Only length bytes are appended, the source needs no terminator
+  String s("ab");
+  const char chunk[] = { 'c', 'd', 'X' };
+  EXPECT_TRUE(s.concat(chunk, 2));
+  EXPECT_STREQ("abcd", s.c_str());
+  EXPECT_EQ(4U, s.length());
+
+  // Past the SSO buffer
+  String grown("0123456789");
+  const char digits[] = "0123456789abcdef";
+  EXPECT_TRUE(grown.concat(digits, 10));
+  EXPECT_TRUE(grown.concat(digits + 10, 6));
+  EXPECT_STREQ("01234567890123456789abcdef", grown.c_str());
+  EXPECT_EQ(26U, grown.length());
+
+  EXPECT_TRUE(s.concat(digits, 0));
+  EXPECT_FALSE(s.concat(NULL, 3));
+  EXPECT_STREQ("abcd", s.c_str());
+}
+
+TEST(String, usesContextAllocator) {
+  ScopedMockContext context;
+  PoolStringAllocator pool;
+  setStringAllocator(&pool);
+  {
+    String s("short");
+    EXPECT_EQ(0U, pool.getAllocations());  // SSO
+    s += " and now too long for SSO";
+    EXPECT_EQ(1U, pool.getAllocations());
+    EXPECT_GT(pool.getBytesInUse(), s.length());
+
+    String copy = s;
+    EXPECT_EQ(2U, pool.getAllocations());
+    String moved(std::move(copy));
+    EXPECT_EQ(2U, pool.getAllocations());
+    EXPECT_STREQ("short and now too long for SSO", moved.c_str());
+  }
+  EXPECT_EQ(2U, pool.getReleases());
+  EXPECT_EQ(0U, pool.getBytesInUse());
+  setStringAllocator(NULL);
+}
+
+TEST(String, crossesThreadsWithSharedAllocator) {
+  PoolStringAllocator pool;
+  String* s = NULL;
+  std::thread producer([&]() {
+    ScopedMockContext context;
+    setStringAllocator(&pool);
+    s = new String("built on the producer thread");
+  });
+  producer.join();
+
+  ScopedMockContext context;
+  setStringAllocator(&pool);
+  EXPECT_EQ(1U, pool.getAllocations());
+  delete s;
+  EXPECT_EQ(1U, pool.getReleases());
+  EXPECT_EQ(0U, pool.getBytesInUse());
+  setStringAllocator(NULL);
+}
+
+// Leftmost, non-overlapping, left to right, like String::replace()
+static std::string referenceReplace(const std::string& text, const std::string& find,
+                                    const std::string& replace) {
+  std::string result;
+  size_t from = 0;
+  size_t at;
+  while ((at = text.find(find, from)) != std::string::npos) {
+    result += text.substr(from, at - from) + replace;
+    from = at + find.size();
+  }
+  return result + text.substr(from);
+}
+
+TEST(String, replaceSweeps) {
+  String s("a-b-c");
+  s.replace("-", "--+");  // growing
+  EXPECT_STREQ("a--+b--+c", s.c_str());
+  s.replace("--+", ", ");  // shrinking
+  EXPECT_STREQ("a, b, c", s.c_str());
+  s.replace(", ", "; ");  // equal length
+  EXPECT_STREQ("a; b; c", s.c_str());
+  EXPECT_EQ(7U, s.length());
+
+  // Adjacent matches, growing past SSO
+  String x("xxxxxxxx");
+  x.replace("x", "<yz>");
+  EXPECT_STREQ("<yz><yz><yz><yz><yz><yz><yz><yz>", x.c_str());
+  x.replace("<yz>", "");
+  EXPECT_STREQ("", x.c_str());
+
+  // Overlapping candidates: the leftmost match wins, the rest is scanned
+  // after it
+  String a("aaaaa");
+  a.replace("aa", "b");
+  EXPECT_STREQ("bba", a.c_str());
+  String ab("ababab");
+  ab.replace("abab", "XYZ!");
+  EXPECT_STREQ("XYZ!ab", ab.c_str());
+  // A replacement containing the find string is not searched again
+  String again("a.b");
+  again.replace(".", "..");
+  EXPECT_STREQ("a..b", again.c_str());
+}
+
+TEST(String, replaceAgainstReference) {
+  unsigned int seed = 7;
+  for (int i = 0; i < 500; i++) {
+    std::string text(i % 60, 'a');
+    for (size_t j = 0; j < text.size(); j++) {
+      seed = seed * 1103515245 + 12345;
+      text[j] = "ab-"[(seed >> 16) % 3];
+    }
+    const std::string find = std::string("ab-a").substr(i % 3, 1 + i % 2);
+    const std::string replace = std::string("XYZW").substr(0, i % 5);
+    String s(text.c_str());
+    s.replace(find.c_str(), replace.c_str());
+    const std::string expected = referenceReplace(text, find, replace);
+    EXPECT_EQ(expected, s.c_str()) << text << " / " << find << " -> " << replace;
+    EXPECT_EQ(expected.size(), s.length());
+  }
+}
+
+// At each position the first pair whose find string starts there, like
+// String::replaceAll()
+static std::string referenceReplaceAll(const std::string& text,
+                                       const std::vector<std::pair<std::string, std::string> >& pairs) {
+  std::string result;
+  for (size_t i = 0; i < text.size(); ) {
+    size_t k = 0;
+    while (k < pairs.size() && text.compare(i, pairs[k].first.size(), pairs[k].first) != 0) {
+      k++;
+    }
+    if (k == pairs.size()) {
+      result += text[i++];
+    } else {
+      result += pairs[k].second;
+      i += pairs[k].first.size();
+    }
+  }
+  return result;
+}
+
+TEST(String, replaceAllAgainstReference) {
+  unsigned int seed = 11;
+  const char* const finds[] = { "a", "ab", "b-", "--" };
+  const char* const replaces[] = { "", "Q", "QR", "QRST" };
+  for (int i = 0; i < 500; i++) {
+    std::string text(i % 50, 'a');
+    for (size_t j = 0; j < text.size(); j++) {
+      seed = seed * 1103515245 + 12345;
+      text[j] = "ab-"[(seed >> 16) % 3];
+    }
+    StringReplacement pairs[2] = {
+      { finds[i % 4], replaces[(i / 4) % 4] },
+      { finds[(i / 16) % 4], replaces[(i / 64) % 4] },
+    };
+    std::vector<std::pair<std::string, std::string> > reference;
+    for (int k = 0; k < 2; k++) {
+      reference.push_back(std::make_pair(std::string(pairs[k].find),
+                                         std::string(pairs[k].replace)));
+    }
+    String s(text.c_str());
+    s.replaceAll(pairs, 2);
+    const std::string expected = referenceReplaceAll(text, reference);
+    EXPECT_EQ(expected, s.c_str()) << text;
+    EXPECT_EQ(expected.size(), s.length());
+  }
+}
+
+TEST(String, replaceAll) {
+  String page("<b>%NAME%</b> at %IP%%IP%, %NAME%");
+  page.replaceAll({ { "%NAME%", "sensor-01" }, { "%IP%", "10.0.0.1" } });
+  EXPECT_STREQ("<b>sensor-01</b> at 10.0.0.110.0.0.1, sensor-01", page.c_str());
+
+  // Shrinking first lets the growing ones after it write in place; growing
+  // first makes the sweep start ahead of the text
+  String s("<<<<x");
+  s.replaceAll({ { "<<", "" }, { "x", "xxx" } });
+  EXPECT_STREQ("xxx", s.c_str());
+  s = "x<<<<x";
+  s.replaceAll({ { "<<", "" }, { "x", "xxx" } });
+  EXPECT_STREQ("xxxxxx", s.c_str());
+  s = "x<<x<<";
+  s.replaceAll({ { "<<", "-" }, { "x", "[x]" } });
+  EXPECT_STREQ("[x]-[x]-", s.c_str());
+
+  // The first listed pair wins where several match, a NULL replace deletes
+  s = "abc abd";
+  s.replaceAll({ { "ab", "1" }, { "abc", "2" }, { "d", NULL } });
+  EXPECT_STREQ("1c 1", s.c_str());
+  EXPECT_EQ(4U, s.length());
+
+  s = "unchanged";
+  s.replaceAll({ { "zz", "y" } });
+  EXPECT_STREQ("unchanged", s.c_str());
+}
+
+TEST(String, sumOperands) {
+  String topic("sensors/");
+  const char* name = "kitchen";
+  String s = topic + name + '/' + (unsigned char)7 + ':' + -12 + 34u + ' ' +
+             -5L + 6UL + ' ' + 1.5f + ' ' + -2.25 + F("!");
+  EXPECT_STREQ("sensors/kitchen/7:-1234 -56 1.50 -2.25!", s.c_str());
+  EXPECT_EQ(strlen(s.c_str()), s.length());
+
+  String extremes = String() + LONG_MIN + ' ' + ULONG_MAX;
+  EXPECT_EQ(std::to_string(LONG_MIN) + " " + std::to_string(ULONG_MAX),
+            extremes.c_str());
+
+  // An operand that cannot be appended empties the sum, as on the ESP
+  String invalid = String("a") + (const char*)NULL + "b";
+  EXPECT_STREQ("b", invalid.c_str());
+}
+
+TEST(String, sumAllocations) {
+  ScopedMockContext context;
+  const String part("0123456789abcdef0123456789abcdef");  // past SSO
+  PoolStringAllocator pool;
+  setStringAllocator(&pool);
+  {
+    String sum = part + part + part + part + part + part + part + part +
+                 part + part + part + part + part + part + part + part;
+    EXPECT_EQ(16 * part.length(), sum.length());
+    // The copy of the first operand, then one exact growth per operand as
+    // on the ESP core. The chain yields a StringSumHelper&, so sum copies
+    // the result.
+    EXPECT_EQ(17U, pool.getAllocations());
+
+    String assigned;
+    assigned = part + "/" + sum;
+    EXPECT_EQ(20U, pool.getAllocations());
+  }
+  {
+    // Only a StringSumHelper&& gives up its buffer
+    StringSumHelper named(part);
+    String copied = named + "!";
+    String assigned;
+    assigned = named;
+    EXPECT_EQ(part.length() + 1, copied.length());
+    EXPECT_EQ(part.length() + 1, named.length());
+    EXPECT_STREQ(copied.c_str(), assigned.c_str());
+    String moved = StringSumHelper(part);
+    EXPECT_STREQ(part.c_str(), moved.c_str());
+  }
+  pool.resetCounters();
+  {
+    String built;
+    EXPECT_TRUE(built.concatAll(part, '/', 42, '/', part, "/", 1.25));
+    EXPECT_STREQ("0123456789abcdef0123456789abcdef/42/"
+                 "0123456789abcdef0123456789abcdef/1.25", built.c_str());
+    EXPECT_EQ(1U, pool.getAllocations());
+    // The string itself may be an operand
+    EXPECT_TRUE(built.concatAll('|', built));
+    EXPECT_EQ(2 * 73U + 1, built.length());
+  }
+  setStringAllocator(NULL);
+}
+
+TEST(String, sumFitsSmallEspHeap) {
+  // A sum takes no more heap than appending the operands one by one
+  ScopedMockContext context;
+  const String part(std::string(100, 'x').c_str());
+  EspHeap heap(8192);
+  setEspHeap(&heap);
+  {
+    const String operand(part);
+    String appended;
+    for (int i = 0; i < 40; i++) {
+      appended.concat(operand);
+    }
+    EXPECT_EQ(4000U, appended.length());
+  }
+  const size_t concatPeak = heap.getPeakUsedBytes();
+  {
+    const String operand(part);
+    const String& o = operand;
+    String sum = o + o + o + o + o + o + o + o + o + o +
+                 o + o + o + o + o + o + o + o + o + o +
+                 o + o + o + o + o + o + o + o + o + o +
+                 o + o + o + o + o + o + o + o + o + o;
+    EXPECT_EQ(4000U, sum.length());
+  }
+  EXPECT_EQ(0U, heap.getFailedAllocations());
+  // The one extra buffer is the copy of the result into sum, as on the ESP
+  EXPECT_LE(heap.getPeakUsedBytes(), concatPeak + 4000 + 32);
+  EXPECT_EQ(0U, heap.getLiveAllocations());
+  setEspHeap(NULL);
+}
+
+TEST(String, sumDoubleFitsBound) {
+  // The reserved length is an upper bound of what dtostrf() writes,
+  // including rounding up to the next power of ten
+  const double values[] = {
+    0.0, -0.0, 0.004, -0.005, 9.995, -9.999, 99.996, 1e15, -123456789.125,
+    DBL_MAX, -DBL_MAX, DBL_MIN, HUGE_VAL, -HUGE_VAL, NAN
+  };
+  for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+    char expected[400];
+    snprintf(expected, sizeof(expected), "%4.2f", values[i]);
+    String s("=");
+    EXPECT_TRUE(s.concatAll(values[i]));
+    EXPECT_EQ(std::string("=") + expected, s.c_str());
+    EXPECT_EQ(String(values[i]), String(s.c_str() + 1));
+  }
+}
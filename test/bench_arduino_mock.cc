@@ -0,0 +1,260 @@
+// Per-call cost of the mock layer, in gmock mode (an expectation matched on
+// every call) and in fake mode (no gmock dispatch at all), and of the ESP
+// String and Stream code the mocks build. Wire and SPI have no fake backend
+// and millis() always goes through ArduinoMock, so those paths, and
+// Stream::parseInt() which times out on millis(), are benched as mocks only.
+// String involves no mock; its pair compares operator+ with concatAll().
+//
+// Results go to stdout as JSON unless another --benchmark_format is given,
+// e.g.  bench_arduino_mock --benchmark_out=baseline.json
+
+#include <benchmark/benchmark.h>
+#include "arduino-mock/Arduino.h"
+#include "arduino-mock/Serial.h"
+#include "arduino-mock/SerialCapture.h"
+#include "arduino-mock/Wire.h"
+#include "arduino-mock/SPI.h"
+#include "include/WString.h"
+#include "Stream.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+using ::testing::Return;
+
+static void BM_SerialPrintString_Mock(benchmark::State& state) {
+  SerialMock* serialMock = serialMockInstance();
+  EXPECT_CALL(*serialMock, print(::testing::Matcher<const char*>(_)))
+    .WillRepeatedly(Return(5));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Serial.print("hello"));
+  }
+  releaseSerialMock();
+}
+BENCHMARK(BM_SerialPrintString_Mock);
+
+static void BM_SerialPrintInt_Mock(benchmark::State& state) {
+  SerialMock* serialMock = serialMockInstance();
+  EXPECT_CALL(*serialMock, print(::testing::Matcher<int>(_), _))
+    .WillRepeatedly(Return(4));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Serial.print(1234, DEC));
+  }
+  releaseSerialMock();
+}
+BENCHMARK(BM_SerialPrintInt_Mock);
+
+static void BM_SerialPrintDouble_Mock(benchmark::State& state) {
+  SerialMock* serialMock = serialMockInstance();
+  EXPECT_CALL(*serialMock, print(::testing::Matcher<double>(_), _))
+    .WillRepeatedly(Return(4));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Serial.print(3.14159, 2));
+  }
+  releaseSerialMock();
+}
+BENCHMARK(BM_SerialPrintDouble_Mock);
+
+static void BM_SerialPrintString_Fake(benchmark::State& state) {
+  SerialCapture* capture = serialCaptureInstance();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Serial.print("hello"));
+    capture->clear();
+  }
+  releaseSerialCapture();
+}
+BENCHMARK(BM_SerialPrintString_Fake);
+
+static void BM_SerialPrintInt_Fake(benchmark::State& state) {
+  SerialCapture* capture = serialCaptureInstance();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Serial.print(1234, DEC));
+    capture->clear();
+  }
+  releaseSerialCapture();
+}
+BENCHMARK(BM_SerialPrintInt_Fake);
+
+static void BM_SerialPrintDouble_Fake(benchmark::State& state) {
+  SerialCapture* capture = serialCaptureInstance();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Serial.print(3.14159, 2));
+    capture->clear();
+  }
+  releaseSerialCapture();
+}
+BENCHMARK(BM_SerialPrintDouble_Fake);
+
+static void BM_WireWrite_Mock(benchmark::State& state) {
+  WireMock* wireMock = WireMockInstance();
+  EXPECT_CALL(*wireMock, write(::testing::Matcher<uint8_t>(_)))
+    .WillRepeatedly(Return(1));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Wire.write((uint8_t)0x42));
+  }
+  releaseWireMock();
+}
+BENCHMARK(BM_WireWrite_Mock);
+
+static void BM_SPITransfer_Mock(benchmark::State& state) {
+  SPIMock* spiMock = SPIMockInstance();
+  EXPECT_CALL(*spiMock, transfer(_))
+    .WillRepeatedly(Return(0xa5));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(SPI.transfer(0x5a));
+  }
+  releaseSPIMock();
+}
+BENCHMARK(BM_SPITransfer_Mock);
+
+static void BM_SPITransferBuffer_Mock(benchmark::State& state) {
+  SPIMock* spiMock = SPIMockInstance();
+  EXPECT_CALL(*spiMock, transfer(_, _))
+    .WillRepeatedly(Return());
+  std::vector<uint8_t> buffer(state.range(0));
+  for (auto _ : state) {
+    SPI.transfer(buffer.data(), buffer.size());
+  }
+  state.SetBytesProcessed(state.iterations() * buffer.size());
+  releaseSPIMock();
+}
+BENCHMARK(BM_SPITransferBuffer_Mock)->Arg(16)->Arg(1024);
+
+static void BM_DigitalWrite_Mock(benchmark::State& state) {
+  ArduinoMock* arduinoMock = arduinoMockInstance();
+  EXPECT_CALL(*arduinoMock, digitalWrite(13, _))
+    .WillRepeatedly(Return());
+  uint8_t level = LOW;
+  for (auto _ : state) {
+    digitalWrite(13, level);
+    level = !level;
+  }
+  releaseArduinoMock();
+}
+BENCHMARK(BM_DigitalWrite_Mock);
+
+static void BM_DigitalWrite_Fake(benchmark::State& state) {
+  ArduinoFake* fake = arduinoFakeInstance();
+  pinMode(13, OUTPUT);
+  uint8_t level = LOW;
+  for (auto _ : state) {
+    digitalWrite(13, level);
+    level = !level;
+  }
+  benchmark::DoNotOptimize(fake->getWriteCount(13));
+  releaseArduinoFake();
+}
+BENCHMARK(BM_DigitalWrite_Fake);
+
+static void BM_DigitalRead_Mock(benchmark::State& state) {
+  ArduinoMock* arduinoMock = arduinoMockInstance();
+  EXPECT_CALL(*arduinoMock, digitalRead(4))
+    .WillRepeatedly(Return(HIGH));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(digitalRead(4));
+  }
+  releaseArduinoMock();
+}
+BENCHMARK(BM_DigitalRead_Mock);
+
+static void BM_DigitalRead_Fake(benchmark::State& state) {
+  ArduinoFake* fake = arduinoFakeInstance();
+  pinMode(4, INPUT);
+  fake->setDigitalInput(4, HIGH);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(digitalRead(4));
+  }
+  releaseArduinoFake();
+}
+BENCHMARK(BM_DigitalRead_Fake);
+
+static void BM_StringConcat_Operator(benchmark::State& state) {
+  const String topic("sensors/kitchen");
+  for (auto _ : state) {
+    String message = topic + '/' + 42 + F("/temperature=") + 21.5f;
+    benchmark::DoNotOptimize(message.c_str());
+  }
+}
+BENCHMARK(BM_StringConcat_Operator);
+
+static void BM_StringConcat_ConcatAll(benchmark::State& state) {
+  const String topic("sensors/kitchen");
+  for (auto _ : state) {
+    String message;
+    message.concatAll(topic, '/', 42, F("/temperature="), 21.5f);
+    benchmark::DoNotOptimize(message.c_str());
+  }
+}
+BENCHMARK(BM_StringConcat_ConcatAll);
+
+// Reads the same CSV line over and over; the peek buffer is off, so
+// parseInt() goes through peek() and read() one byte at a time.
+class RepeatingStream : public Stream {
+
+  public:
+    explicit RepeatingStream(const std::string& line)
+      : line(line), position(0) {
+    }
+
+    void rewind() {
+      position = 0;
+    }
+
+    int available() {
+      return line.size() - position;
+    }
+    int read() {
+      return position < line.size() ? (uint8_t)line[position++] : -1;
+    }
+    int peek() {
+      return position < line.size() ? (uint8_t)line[position] : -1;
+    }
+    void flush() {}
+    size_t write(const uint8_t* buffer, size_t size) {
+      (void)buffer;
+      return size;
+    }
+
+  private:
+    const std::string line;
+    size_t position;
+};
+
+// millis() goes through the mock, as in a test of a sketch
+static void BM_StreamParseInt_Mock(benchmark::State& state) {
+  ArduinoMock* arduinoMock = arduinoMockInstance();
+  EXPECT_CALL(*arduinoMock, millis())
+    .WillRepeatedly(Return(0));
+  RepeatingStream stream("1234,-56789,2147483647,0\r\n");
+  for (auto _ : state) {
+    stream.rewind();
+    for (int i = 0; i < 4; i++) {
+      benchmark::DoNotOptimize(stream.parseInt());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * 4);
+  releaseArduinoMock();
+}
+BENCHMARK(BM_StreamParseInt_Mock);
+
+int main(int argc, char* argv[]) {
+  ::testing::InitGoogleMock(&argc, argv);
+
+  std::vector<char*> args(argv, argv + argc);
+  bool formatGiven = false;
+  for (int i = 1; i < argc; i++) {
+    formatGiven |= strncmp(argv[i], "--benchmark_format", 18) == 0;
+  }
+  char jsonFormat[] = "--benchmark_format=json";
+  if (!formatGiven) {
+    args.push_back(jsonFormat);
+  }
+  int benchArgc = (int)args.size();
+  benchmark::Initialize(&benchArgc, args.data());
+  if (benchmark::ReportUnrecognizedArguments(benchArgc, args.data())) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -6,6 +6,23 @@
 #include "WiFi_unittest.cc"
 #include "Wire_unittest.cc"
 #include "SPI_unittest.cc"
+#include "Scheduler_unittest.cc"
+#include "MockContext_unittest.cc"
+#include "SketchRunner_unittest.cc"
+#include "Interrupts_unittest.cc"
+#include "PinTrace_unittest.cc"
+#include "AnalogSource_unittest.cc"
+#include "RingBuffer_unittest.cc"
+#include "SerialCapture_unittest.cc"
+#include "PrintFormat_unittest.cc"
+#include "SerialPty_unittest.cc"
+#include "SerialReplay_unittest.cc"
+#include "SoftwareSerial_unittest.cc"
+#include "StringAllocator_unittest.cc"
+#include "StringSearch_unittest.cc"
+#include "EspHeap_unittest.cc"
+#include "WString_unittest.cc"
+#include "Stream_unittest.cc"
 int main(int argc, char* argv[]) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();